@@ -225,6 +225,69 @@ level1:
 	return 0;
 }
 
+// Reserve all free IDs of a random 64 IDs slab at once.
+//
+// Returns the first ID of the slab and stores the reserved IDs in *ids where
+// bit N set means that ID (first + N) is now owned by the caller. Returns 0 if
+// the pool is full. Reserved IDs must be released individually with id_pool_put.
+static inline uint32_t id_pool_get_block_random(struct id_pool *p, uint64_t *ids) {
+	uint16_t level0_bit, l0, l1;
+	uint64_t level0, rand;
+
+	// Grab a random starting level0 slab.
+	rand = rte_rand();
+	l0 = rand % p->level0_len;
+	// Use another random bit offset to be checked first in level0 to increase entropy.
+	rand = (rand >> 32) % __ID_POOL_SLAB_SIZE;
+
+	// Ensure we only inspect each level0 slab at most once.
+	for (uint16_t _ = 0; _ < p->level0_len; _++) {
+level0:
+		level0 = atomic_load_explicit(&p->level0[l0], memory_order_acquire);
+		if (level0 == 0) {
+			// Current level0 slab is full.
+			// Go to previous one, wrapping to the last one if necessary.
+			l0 = l0 > 0 ? l0 - 1 : p->level0_len - 1;
+			continue;
+		}
+
+		if (level0 & GR_BIT64(rand)) {
+			// If possible, select a random slab in this level0 to increase entropy.
+			level0_bit = rand;
+		} else {
+			// Otherwise, use the first "available" one.
+			level0_bit = rte_ctz64(level0);
+		}
+		l1 = (l0 * __ID_POOL_SLAB_SIZE) + level0_bit;
+
+		// Take all free bits of the level1 slab.
+		*ids = atomic_exchange_explicit(&p->level1[l1], 0, memory_order_acq_rel);
+
+		// The level1 slab is now full. Clear the corresponding bit in level0.
+		atomic_fetch_and_explicit(
+			&p->level0[l0], ~GR_BIT64(level0_bit), memory_order_acq_rel
+		);
+		// IDs may have been put back in the meantime, restore the level0 bit.
+		if (atomic_load_explicit(&p->level1[l1], memory_order_acquire) != 0)
+			atomic_fetch_or_explicit(
+				&p->level0[l0], GR_BIT64(level0_bit), memory_order_acq_rel
+			);
+
+		if (*ids == 0) {
+			// Another thread reserved the last IDs after we read level0.
+			// Find another slab from the same level0.
+			goto level0;
+		}
+
+		atomic_fetch_add_explicit(&p->used, rte_popcount64(*ids), memory_order_relaxed);
+
+		return p->min_id + (l1 * __ID_POOL_SLAB_SIZE);
+	}
+
+	// Pool entirely full.
+	return 0;
+}
+
 // Reserve a user‑chosen ID. Returns 0 on success, <0 on error
 static inline int id_pool_book(struct id_pool *p, uint32_t id) {
 	uint16_t level1_bit, l1, offset;
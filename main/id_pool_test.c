@@ -185,6 +185,41 @@ static void id_random(void **) {
 	id_pool_destroy(p);
 }
 
+static void id_block(void **) {
+	struct id_pool *p = id_pool_create(1, 100);
+	uint32_t first, id;
+	uint64_t ids;
+
+	assert_non_null(p);
+	assert_int_equal(id_pool_book(p, 70), 0);
+
+	// Exhaust the pool: 64 IDs in the first slab, 35 in the second one.
+	for (unsigned n = 0; n < 2; n++) {
+		first = id_pool_get_block_random(p, &ids);
+		assert_int_not_equal(first, 0);
+		assert_int_equal((first - 1) % 64, 0);
+		for (unsigned bit = 0; bit < 64; bit++) {
+			id = first + bit;
+			if (id > 100 || id == 70)
+				assert_false(ids & GR_BIT64(bit));
+			else
+				assert_true(ids & GR_BIT64(bit));
+		}
+	}
+	assert_int_equal(id_pool_used(p), 100);
+	assert_int_equal(id_pool_get_block_random(p, &ids), 0);
+	assert_int_equal(id_pool_get(p), 0);
+
+	// Released IDs can be reserved again as a block.
+	assert_return_code(id_pool_put(p, 42), errno);
+	assert_return_code(id_pool_put(p, 43), errno);
+	assert_int_equal(id_pool_get_block_random(p, &ids), 1);
+	assert_int_equal(ids, GR_BIT64(41) | GR_BIT64(42));
+	assert_int_equal(id_pool_used(p), 100);
+
+	id_pool_destroy(p);
+}
+
 static void *id_random_thread(void *arg) {
 	struct id_pool_bench *bench = arg;
 	uint64_t tsc;
@@ -258,6 +293,7 @@ int main(void) {
 		cmocka_unit_test(id_sequence_bench),
 		cmocka_unit_test(id_random),
 		cmocka_unit_test(id_random_bench),
+		cmocka_unit_test(id_block),
 	};
 	return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -102,6 +102,7 @@ struct gr_iface {
 #define GR_PORT_SET_N_TXQS GR_BIT64(33)
 #define GR_PORT_SET_Q_SIZE GR_BIT64(34)
 #define GR_PORT_SET_MAC GR_BIT64(35)
+#define GR_PORT_SET_RSS GR_BIT64(36)
 
 // Base info structure for GR_IFACE_TYPE_PORT interfaces.
 struct __gr_iface_info_port_base {
@@ -110,6 +111,8 @@ struct __gr_iface_info_port_base {
 	uint16_t rxq_size;
 	uint16_t txq_size;
 	struct rte_ether_addr mac;
+	// Hash both directions of a flow to the same RX queue.
+	bool symmetric_rss;
 };
 
 // Complete port info structure including device arguments and driver name.
@@ -401,9 +404,18 @@ struct gr_graph_dump_resp {
 
 GR_REQ(GR_GRAPH_DUMP, struct gr_graph_dump_req, struct gr_graph_dump_resp);
 
+typedef enum : uint8_t {
+	GR_GRAPH_FASTPATH_UNCHANGED = 0, // Only valid in GR_GRAPH_CONF_SET requests.
+	GR_GRAPH_FASTPATH_OFF,
+	GR_GRAPH_FASTPATH_ON,
+} gr_graph_fastpath_t;
+
 struct gr_graph_conf {
 	uint16_t rx_burst_max; // default 64, max 256
 	uint16_t vector_max; // default 64, max 256
+	// Send common case packets to fused nodes (e.g. ip4_fastpath) that bypass
+	// intermediate nodes. Anything unusual falls back to the regular nodes.
+	gr_graph_fastpath_t fastpath; // default off
 };
 
 GR_REQ(GR_GRAPH_CONF_GET, struct gr_empty, struct gr_graph_conf);
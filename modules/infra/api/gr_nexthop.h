@@ -36,6 +36,7 @@ typedef enum : uint8_t {
 	GR_NH_T_BLACKHOLE, // Drop packets silently.
 	GR_NH_T_REJECT, // Drop packets with ICMP error.
 	GR_NH_T_GROUP, // ECMP for multipath routing.
+	GR_NH_T_RECURSIVE, // Indirection shared by routes with the same BGP nexthop.
 #define GR_NH_T_ALL UINT8_C(0xff) // Match all types in list operations.
 } gr_nh_type_t;
 
@@ -101,6 +102,7 @@ struct gr_nexthop_info_l3 {
 		struct rte_ipv6_addr ipv6;
 	};
 	struct rte_ether_addr mac; // Auto-sets GR_NH_F_STATIC and GR_NH_S_REACHABLE.
+	uint32_t backup_nh_id; // L3 nexthop used while iface_id is down (0 = none).
 };
 
 // Info for GR_NH_T_GROUP nexthops
@@ -111,9 +113,19 @@ struct gr_nexthop_group_member {
 
 struct gr_nexthop_info_group {
 	uint32_t n_members;
+	uint32_t backup_nh_id; // L3 nexthop used when no member can forward (0 = none).
 	struct gr_nexthop_group_member members[];
 };
 
+// Info for GR_NH_T_RECURSIVE nexthops.
+//
+// A recursive nexthop resolves to another nexthop (usually an IGP nexthop or
+// group). Routes that point to it follow any change of resolution without
+// being reinstalled.
+struct gr_nexthop_info_recursive {
+	uint32_t nh_id; // Resolved nexthop (GR_NH_ID_UNSET = unresolved, drop).
+};
+
 // Nexthop structure exposed to the API.
 struct gr_nexthop {
 	BASE(gr_nexthop_base);
@@ -197,6 +209,8 @@ static inline const char *gr_nh_type_name(const gr_nh_type_t type) {
 		return "reject";
 	case GR_NH_T_GROUP:
 		return "group";
+	case GR_NH_T_RECURSIVE:
+		return "recursive";
 	}
 	return "?";
 }
@@ -31,7 +31,8 @@ static struct api_out nh_add(const void *request, struct api_ctx *) {
 	struct nexthop *nh;
 	int ret = 0;
 
-	if (req->nh.base.type != GR_NH_T_GROUP && req->nh.base.vrf_id == GR_VRF_ID_UNDEF
+	if (req->nh.base.type != GR_NH_T_GROUP && req->nh.base.type != GR_NH_T_RECURSIVE
+	    && req->nh.base.vrf_id == GR_VRF_ID_UNDEF
 	    && req->nh.base.iface_id == GR_IFACE_ID_UNDEF)
 		return api_out(EINVAL, 0, NULL);
 
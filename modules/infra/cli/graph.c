@@ -11,15 +11,23 @@
 #include <ecoli.h>
 
 #include <stdio.h>
+#include <string.h>
 
 static cmd_status_t graph_conf_set(struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_graph_conf req = {0};
+	const char *fastpath;
 
 	if (arg_u16(p, "VECTOR", &req.vector_max) < 0 && errno != ENOENT)
 		return CMD_ERROR;
 	if (arg_u16(p, "BURST", &req.rx_burst_max) < 0 && errno != ENOENT)
 		return CMD_ERROR;
 
+	fastpath = arg_str(p, "FASTPATH");
+	if (fastpath != NULL && strcmp(fastpath, "on") == 0)
+		req.fastpath = GR_GRAPH_FASTPATH_ON;
+	else if (fastpath != NULL && strcmp(fastpath, "off") == 0)
+		req.fastpath = GR_GRAPH_FASTPATH_OFF;
+
 	if (gr_api_client_send_recv(c, GR_GRAPH_CONF_SET, sizeof(req), &req, NULL) < 0)
 		return CMD_ERROR;
 
@@ -38,6 +46,9 @@ static cmd_status_t graph_conf_show(struct gr_api_client *c, const struct ec_pno
 	struct gr_object *o = gr_object_new(NULL);
 	gr_object_field(o, "vector_max", GR_DISP_INT, "%u", sizes->vector_max);
 	gr_object_field(o, "rx_burst_max", GR_DISP_INT, "%u", sizes->rx_burst_max);
+	gr_object_field(
+		o, "fastpath", 0, "%s", sizes->fastpath == GR_GRAPH_FASTPATH_ON ? "on" : "off"
+	);
 	gr_object_free(o);
 
 	free(resp_ptr);
@@ -76,14 +87,18 @@ static int ctx_init(struct ec_node *root) {
 
 	ret = CLI_COMMAND(
 		CONF_CTX(root),
-		"set (vector-max VECTOR),(rx-burst-max BURST)",
+		"set (vector-max VECTOR),(rx-burst-max BURST),(fastpath FASTPATH)",
 		graph_conf_set,
-		"Configure maximum burst sizes of the packet processing graph.",
+		"Configure the packet processing graph.",
 		with_help(
 			"Maximum size of graph vectors.", ec_node_uint("VECTOR", 1, UINT16_MAX, 10)
 		),
 		with_help(
 			"Maximum size of RX queue burst.", ec_node_uint("BURST", 1, UINT16_MAX, 10)
+		),
+		with_help(
+			"Use fused nodes for common case packets.",
+			EC_NODE_OR("FASTPATH", ec_node_str("", "on"), ec_node_str("", "off"))
 		)
 	);
 	if (ret < 0)
@@ -93,7 +108,7 @@ static int ctx_init(struct ec_node *root) {
 		CONF_CTX(root),
 		"[show]",
 		graph_conf_show,
-		"Show the current maximum burst sizes of the packet processing graph."
+		"Show the current packet processing graph configuration."
 	);
 	if (ret < 0)
 		return ret;
@@ -119,6 +119,7 @@ static void add_columns_l3(struct gr_table *table) {
 	gr_table_column(table, "STATE", GR_DISP_LEFT);
 	gr_table_column(table, "MAC", GR_DISP_LEFT);
 	gr_table_column(table, "FLAGS", GR_DISP_STR_ARRAY);
+	gr_table_column(table, "BACKUP", GR_DISP_RIGHT | GR_DISP_INT);
 }
 
 static void format_nh_flags(char *buf, size_t len, gr_nh_flags_t flags) {
@@ -158,6 +159,8 @@ static void fill_table_l3(struct gr_table *table, unsigned start_col, const void
 	format_nh_flags(flags, sizeof(flags), l3->flags);
 	if (flags[0] != 0)
 		gr_table_cell(table, start_col + 4, "%s", flags);
+	if (l3->backup_nh_id != GR_NH_ID_UNSET)
+		gr_table_cell(table, start_col + 5, "%u", l3->backup_nh_id);
 }
 
 static void fill_object_l3(struct gr_object *o, const void *info) {
@@ -186,6 +189,8 @@ static void fill_object_l3(struct gr_object *o, const void *info) {
 	format_nh_flags(flags, sizeof(flags), l3->flags);
 	if (flags[0] != 0)
 		gr_object_field(o, "flags", GR_DISP_STR_ARRAY, "%s", flags);
+	if (l3->backup_nh_id != GR_NH_ID_UNSET)
+		gr_object_field(o, "backup", GR_DISP_INT, "%u", l3->backup_nh_id);
 }
 
 static struct cli_nexthop_formatter l3_formatter = {
@@ -214,6 +219,8 @@ static ssize_t format_nexthop_info_group(char *buf, size_t len, const void *info
 		SAFE_BUF(
 			snprintf, len, "id(%u/%u) ", grp->members[i].nh_id, grp->members[i].weight
 		);
+	if (grp->backup_nh_id != GR_NH_ID_UNSET)
+		SAFE_BUF(snprintf, len, "backup id(%u) ", grp->backup_nh_id);
 	return n;
 err:
 	return -errno;
@@ -221,6 +228,7 @@ err:
 
 static void add_columns_group(struct gr_table *table) {
 	gr_table_column(table, "MEMBERS", GR_DISP_LEFT);
+	gr_table_column(table, "BACKUP", GR_DISP_RIGHT | GR_DISP_INT);
 }
 
 static void fill_table_group(struct gr_table *table, unsigned start_col, const void *info) {
@@ -240,6 +248,8 @@ static void fill_table_group(struct gr_table *table, unsigned start_col, const v
 err:
 	if (n > 0)
 		gr_table_cell(table, start_col, "%s", buf);
+	if (grp->backup_nh_id != GR_NH_ID_UNSET)
+		gr_table_cell(table, start_col + 1, "%u", grp->backup_nh_id);
 }
 
 static void fill_object_group(struct gr_object *o, const void *info) {
@@ -253,6 +263,8 @@ static void fill_object_group(struct gr_object *o, const void *info) {
 		gr_object_close(o);
 	}
 	gr_object_array_close(o);
+	if (grp->backup_nh_id != GR_NH_ID_UNSET)
+		gr_object_field(o, "backup", GR_DISP_INT, "%u", grp->backup_nh_id);
 }
 
 static struct cli_nexthop_formatter group_formatter = {
@@ -264,6 +276,41 @@ static struct cli_nexthop_formatter group_formatter = {
 	.fill_object = fill_object_group,
 };
 
+static ssize_t format_nexthop_info_recursive(char *buf, size_t len, const void *info) {
+	const struct gr_nexthop_info_recursive *rec = info;
+
+	if (rec->nh_id == GR_NH_ID_UNSET)
+		return snprintf(buf, len, "unresolved");
+	return snprintf(buf, len, "via id(%u)", rec->nh_id);
+}
+
+static void add_columns_recursive(struct gr_table *table) {
+	gr_table_column(table, "VIA", GR_DISP_LEFT);
+}
+
+static void fill_table_recursive(struct gr_table *table, unsigned start_col, const void *info) {
+	const struct gr_nexthop_info_recursive *rec = info;
+
+	if (rec->nh_id != GR_NH_ID_UNSET)
+		gr_table_cell(table, start_col, "%u", rec->nh_id);
+}
+
+static void fill_object_recursive(struct gr_object *o, const void *info) {
+	const struct gr_nexthop_info_recursive *rec = info;
+
+	if (rec->nh_id != GR_NH_ID_UNSET)
+		gr_object_field(o, "via", GR_DISP_INT, "%u", rec->nh_id);
+}
+
+static struct cli_nexthop_formatter recursive_formatter = {
+	.name = "recursive",
+	.type = GR_NH_T_RECURSIVE,
+	.format = format_nexthop_info_recursive,
+	.add_columns = add_columns_recursive,
+	.fill_table = fill_table_recursive,
+	.fill_object = fill_object_recursive,
+};
+
 static int complete_nh_types(
 	struct gr_api_client *,
 	const struct ec_node *node,
@@ -383,6 +430,8 @@ static cmd_status_t nh_l3_add(struct gr_api_client *c, const struct ec_pnode *p)
 		goto out;
 	if (arg_eth_addr(p, "MAC", &l3->mac) < 0 && errno != ENOENT)
 		goto out;
+	if (arg_u32(p, "BACKUP", &l3->backup_nh_id) < 0 && errno != ENOENT)
+		goto out;
 
 	if (gr_api_client_send_recv(c, GR_NH_ADD, len, req, NULL) < 0)
 		goto out;
@@ -455,6 +504,8 @@ static cmd_status_t nh_group_add(struct gr_api_client *c, const struct ec_pnode
 		goto out;
 
 	group = (struct gr_nexthop_info_group *)req->nh.info;
+	if (arg_u32(p, "BACKUP", &group->backup_nh_id) < 0 && errno != ENOENT)
+		goto out;
 
 	while ((n = ec_pnode_find_next(p, n, "MEMBER", false)) != NULL) {
 		if (arg_u32(n, "NHID", &group->members[group->n_members].nh_id) < 0)
@@ -476,6 +527,37 @@ out:
 	return ret;
 }
 
+static cmd_status_t nh_recursive_add(struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_nexthop_info_recursive *rec;
+	struct gr_nh_add_req *req = NULL;
+	cmd_status_t ret = CMD_ERROR;
+	size_t len;
+
+	len = sizeof(*req) + sizeof(*rec);
+	if ((req = calloc(1, len)) == NULL) {
+		errno = ENOMEM;
+		goto out;
+	}
+
+	req->exist_ok = true;
+	req->nh.type = GR_NH_T_RECURSIVE;
+	req->nh.origin = GR_NH_ORIGIN_STATIC;
+
+	if (arg_u32(p, "ID", &req->nh.nh_id) < 0 && errno != ENOENT)
+		goto out;
+
+	rec = (struct gr_nexthop_info_recursive *)req->nh.info;
+	if (arg_u32(p, "NHID", &rec->nh_id) < 0 && errno != ENOENT)
+		goto out;
+
+	if (gr_api_client_send_recv(c, GR_NH_ADD, len, req, NULL) < 0)
+		goto out;
+	ret = CMD_SUCCESS;
+out:
+	free(req);
+	return ret;
+}
+
 static cmd_status_t nh_show_id(struct gr_api_client *c, const struct ec_pnode *p) {
 	struct gr_nh_get_req req = {0};
 	void *resp_ptr = NULL;
@@ -623,12 +705,16 @@ static int ctx_init(struct ec_node *root) {
 
 	ret = CLI_COMMAND(
 		NEXTHOP_ADD_CTX(root),
-		"l3 iface IFACE [(id ID),(address IP),(mac MAC)]",
+		"l3 iface IFACE [(id ID),(address IP),(mac MAC),(backup BACKUP)]",
 		nh_l3_add,
 		"Add a new L3 nexthop.",
 		with_help("IPv4/6 address.", ec_node_re("IP", IP_ANY_RE)),
 		with_help("Ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),
 		with_help("Nexthop ID.", ec_node_uint("ID", 1, UINT32_MAX - 1, 10)),
+		with_help(
+			"L3 nexthop ID used while the output interface is down.",
+			ec_node_uint("BACKUP", 1, UINT32_MAX - 1, 10)
+		),
 		with_help("Output interface.", ec_node_dyn("IFACE", complete_iface_names, NULL))
 	);
 	if (ret < 0)
@@ -647,10 +733,14 @@ static int ctx_init(struct ec_node *root) {
 		return ret;
 	ret = CLI_COMMAND(
 		NEXTHOP_ADD_CTX(root),
-		"group [(id ID)] (member MEMBER)*",
+		"group [(id ID),(backup BACKUP)] (member MEMBER)*",
 		nh_group_add,
 		"Add a new nexthop group.",
 		with_help("Nexthop ID.", ec_node_uint("ID", 1, UINT32_MAX - 1, 10)),
+		with_help(
+			"L3 nexthop ID used when no member can forward.",
+			ec_node_uint("BACKUP", 1, UINT32_MAX - 1, 10)
+		),
 		with_help(
 			"Nexthop member ID with relative weight.",
 			EC_NODE_CMD(
@@ -661,6 +751,19 @@ static int ctx_init(struct ec_node *root) {
 			)
 		)
 	);
+	if (ret < 0)
+		return ret;
+	ret = CLI_COMMAND(
+		NEXTHOP_ADD_CTX(root),
+		"recursive [(id ID)] [(via NHID)]",
+		nh_recursive_add,
+		"Add or update a recursive nexthop shared by routes.",
+		with_help("Nexthop ID.", ec_node_uint("ID", 1, UINT32_MAX - 1, 10)),
+		with_help(
+			"Nexthop ID to resolve to (unresolved if omitted).",
+			ec_node_uint("NHID", 1, UINT32_MAX - 1, 10)
+		)
+	);
 	if (ret < 0)
 		return ret;
 	ret = CLI_COMMAND(
@@ -741,4 +844,5 @@ static void __attribute__((constructor, used)) init(void) {
 	cli_nexthop_formatter_register(&blackhole_formatter);
 	cli_nexthop_formatter_register(&reject_formatter);
 	cli_nexthop_formatter_register(&group_formatter);
+	cli_nexthop_formatter_register(&recursive_formatter);
 }
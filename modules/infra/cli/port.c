@@ -13,6 +13,7 @@
 #include <ecoli.h>
 
 #include <errno.h>
+#include <string.h>
 #include <sys/queue.h>
 
 static void port_show(struct gr_api_client *, const struct gr_iface *iface, struct gr_object *o) {
@@ -25,6 +26,9 @@ static void port_show(struct gr_api_client *, const struct gr_iface *iface, stru
 	gr_object_field(o, "n_txq", GR_DISP_INT, "%u", port->n_txq);
 	gr_object_field(o, "rxq_size", GR_DISP_INT, "%u", port->rxq_size);
 	gr_object_field(o, "txq_size", GR_DISP_INT, "%u", port->txq_size);
+	gr_object_field(
+		o, "symmetric_rss", GR_DISP_BOOL, "%s", port->symmetric_rss ? "true" : "false"
+	);
 }
 
 static void
@@ -46,7 +50,7 @@ static uint64_t parse_port_args(
 	bool update
 ) {
 	struct gr_iface_info_port *port;
-	const char *devargs;
+	const char *devargs, *rss;
 	uint64_t set_attrs;
 
 	set_attrs = parse_iface_args(c, p, iface, sizeof(*port), update);
@@ -67,6 +71,12 @@ static uint64_t parse_port_args(
 		set_attrs |= GR_PORT_SET_Q_SIZE;
 	}
 
+	rss = arg_str(p, "SYM_RSS");
+	if (rss != NULL) {
+		port->symmetric_rss = strcmp(rss, "on") == 0;
+		set_attrs |= GR_PORT_SET_RSS;
+	}
+
 	if (set_attrs == 0)
 		errno = EINVAL;
 	return set_attrs;
@@ -124,12 +134,17 @@ out:
 	return ret;
 }
 
-#define PORT_ATTRS_CMD IFACE_ATTRS_CMD ",(mac MAC),(rxqs N_RXQ),(qsize Q_SIZE)"
+#define PORT_ATTRS_CMD                                                                             \
+	IFACE_ATTRS_CMD ",(mac MAC),(rxqs N_RXQ),(qsize Q_SIZE),(symmetric-rss SYM_RSS)"
 
 #define PORT_ATTRS_ARGS                                                                            \
 	IFACE_ATTRS_ARGS, with_help("Set the ethernet address.", ec_node_re("MAC", ETH_ADDR_RE)),  \
 		with_help("Number of Rx queues.", ec_node_uint("N_RXQ", 0, UINT16_MAX - 1, 10)),   \
-		with_help("Rx/Tx queues size.", ec_node_uint("Q_SIZE", 0, UINT16_MAX - 1, 10))
+		with_help("Rx/Tx queues size.", ec_node_uint("Q_SIZE", 0, UINT16_MAX - 1, 10)),    \
+		with_help(                                                                         \
+			"Hash both directions of a flow to the same Rx queue.",                    \
+			EC_NODE_OR("SYM_RSS", ec_node_str("", "on"), ec_node_str("", "off"))       \
+		)
 
 static int ctx_init(struct ec_node *root) {
 	int ret;
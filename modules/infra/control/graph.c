@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2024 Robin Jarry
 
+#include "eth.h"
 #include "graph.h"
 #include "log.h"
 #include "module.h"
@@ -88,6 +89,7 @@ static struct iface_info_port *find_port(vec struct iface_info_port **ports, uin
 static struct gr_graph_conf graph_conf = {
 	.rx_burst_max = 64,
 	.vector_max = 64,
+	.fastpath = GR_GRAPH_FASTPATH_OFF,
 };
 
 static int
@@ -618,6 +620,19 @@ static struct api_out graph_conf_set(const void *request, struct api_ctx *) {
 
 	if (req->rx_burst_max > RTE_GRAPH_BURST_SIZE || req->vector_max > RTE_GRAPH_BURST_SIZE)
 		return api_out(EOVERFLOW, 0, NULL);
+	if (req->fastpath > GR_GRAPH_FASTPATH_ON)
+		return api_out(EINVAL, 0, NULL);
+
+	if (req->fastpath != GR_GRAPH_FASTPATH_UNCHANGED && req->fastpath != graph_conf.fastpath) {
+		// Switching edges does not require a graph reload and is not
+		// subject to the rollback below.
+		graph_conf.fastpath = req->fastpath;
+		prev.fastpath = req->fastpath;
+		eth_input_fastpath_enable(graph_conf.fastpath == GR_GRAPH_FASTPATH_ON);
+		LOG(NOTICE,
+		    "fastpath=%s",
+		    graph_conf.fastpath == GR_GRAPH_FASTPATH_ON ? "on" : "off");
+	}
 
 	if (req->rx_burst_max > 0)
 		graph_conf.rx_burst_max = req->rx_burst_max;
@@ -9,9 +9,16 @@
 #include <rte_graph.h>
 
 #include <assert.h>
+#include <string.h>
 #include <sys/queue.h>
 
-#ifdef __GROUT_UNIT_TEST__
+// Node unit tests mock rte_node_enqueue_x1() and do not set up next node
+// streams. The batch helpers themselves are tested in graph_test.c.
+#if defined(__GROUT_UNIT_TEST__) && !defined(__GROUT_GRAPH_TEST__)
+#define __GR_NODE_ENQUEUE_MOCK
+#endif
+
+#ifdef __GR_NODE_ENQUEUE_MOCK
 #include "_cmocka.h"
 
 // The function is defined as static inline in the original code, so it cannot be wrapped directly
@@ -28,6 +35,115 @@ rte_node_enqueue_x1(struct rte_graph *, struct rte_node *, rte_edge_t next, void
 #include <rte_graph_worker.h>
 #endif
 
+// Speculative enqueue of objects to next nodes.
+//
+// Most of the time, all objects of a burst are sent to the same next edge.
+// Instead of copying them one by one with rte_node_enqueue_x1(), speculate that
+// all objects go to the same edge as the first one and copy consecutive runs in
+// bulk into the next node stream. Only the objects that diverge from the
+// speculated edge are enqueued individually. When all objects follow the
+// speculated edge, the whole stream is handed over to the next node without
+// any copy.
+//
+// Usage in a node process callback:
+//
+//	struct gr_node_batch batch;
+//	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+//	for (uint16_t i = 0; i < nb_objs; i++) {
+//		...
+//		gr_node_batch_enqueue(&batch, edge, objs[i]);
+//	}
+//	gr_node_batch_flush(&batch);
+//
+// Each object of objs must be enqueued exactly once and in order. The node
+// must not enqueue objects to the speculated edge by other means before
+// gr_node_batch_flush() has been called.
+struct gr_node_batch {
+	struct rte_graph *graph;
+	struct rte_node *node;
+	void **objs;
+	void **to_next; // stream of the speculated edge
+	uint16_t nb_objs;
+	uint16_t pos; // index in objs of the next object to enqueue
+	uint16_t run; // index in objs of the first object of the pending run
+	uint16_t held; // number of objects already written in to_next
+	rte_edge_t edge; // speculated edge
+};
+
+static inline void gr_node_batch_init(
+	struct gr_node_batch *b,
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	b->graph = graph;
+	b->node = node;
+	b->objs = objs;
+	b->to_next = NULL;
+	b->nb_objs = nb_objs;
+	b->pos = 0;
+	b->run = 0;
+	b->held = 0;
+	b->edge = RTE_EDGE_ID_INVALID;
+}
+
+// Copy the pending run of speculated objects into the next node stream.
+static inline void __gr_node_batch_copy_run(struct gr_node_batch *b) {
+	uint16_t n = b->pos - b->run;
+	if (n > 0) {
+		memcpy(&b->to_next[b->held], &b->objs[b->run], n * sizeof(void *));
+		b->held += n;
+	}
+}
+
+static inline void gr_node_batch_enqueue(struct gr_node_batch *b, rte_edge_t edge, void *obj) {
+#ifdef __GR_NODE_ENQUEUE_MOCK
+	rte_node_enqueue_x1(b->graph, b->node, edge, obj);
+#else
+	assert(b->pos < b->nb_objs);
+
+	if (unlikely(b->edge == RTE_EDGE_ID_INVALID)) {
+		// Speculate that all objects go to the same edge as the first one.
+		b->edge = edge;
+		b->to_next = rte_node_next_stream_get(b->graph, b->node, edge, b->nb_objs);
+	}
+
+	if (likely(edge == b->edge)) {
+		if (likely(obj == b->objs[b->pos])) {
+			b->pos++;
+			return;
+		}
+		// The object was replaced by the node, it cannot be part of a run.
+		__gr_node_batch_copy_run(b);
+		b->to_next[b->held++] = obj;
+	} else {
+		__gr_node_batch_copy_run(b);
+		rte_node_enqueue_x1(b->graph, b->node, edge, obj);
+	}
+
+	b->pos++;
+	b->run = b->pos;
+#endif
+}
+
+static inline void gr_node_batch_flush(struct gr_node_batch *b) {
+#ifndef __GR_NODE_ENQUEUE_MOCK
+	if (unlikely(b->edge == RTE_EDGE_ID_INVALID))
+		return;
+
+	if (likely(b->run == 0 && b->pos == b->node->idx && b->objs == b->node->objs)) {
+		// Home run: all objects of the node stream went to the speculated edge.
+		rte_node_next_stream_move(b->graph, b->node, b->edge);
+	} else {
+		__gr_node_batch_copy_run(b);
+		rte_node_next_stream_put(b->graph, b->node, b->edge, b->held);
+	}
+
+	b->edge = RTE_EDGE_ID_INVALID;
+#endif
+}
+
 #define GR_NODE_CTX_TYPE(type_name, fields)                                                        \
 	struct type_name fields;                                                                   \
 	static inline struct type_name *type_name(struct rte_node *node) {                         \
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+// Use the real rte_node_enqueue_x1() and batch helpers.
+#define __GROUT_GRAPH_TEST__
+
+#include "_cmocka.h"
+#include "graph.h"
+
+#include <gr_macro.h>
+
+#include <stdlib.h>
+
+#define N_EDGES 2
+#define STREAM_SIZE 8
+#define MAX_OBJS (4 * STREAM_SIZE)
+
+// The next node streams are grown with rte_realloc() which requires EAL.
+void __wrap___rte_node_stream_alloc(struct rte_graph *, struct rte_node *);
+void __wrap___rte_node_stream_alloc_size(struct rte_graph *, struct rte_node *, uint16_t);
+
+void __wrap___rte_node_stream_alloc_size(struct rte_graph *, struct rte_node *node, uint16_t size) {
+	node->objs = realloc(node->objs, size * sizeof(void *));
+	assert_non_null(node->objs);
+	node->size = size;
+}
+
+void __wrap___rte_node_stream_alloc(struct rte_graph *graph, struct rte_node *node) {
+	__wrap___rte_node_stream_alloc_size(graph, node, node->size * 2);
+}
+
+static rte_graph_off_t pending[64];
+static struct rte_graph *graph;
+static struct rte_node *src;
+static struct rte_node *next[N_EDGES];
+static int pkts[MAX_OBJS];
+
+static void *zalloc_aligned(size_t size) {
+	size = RTE_ALIGN_CEIL(size, RTE_CACHE_LINE_SIZE);
+	void *p = aligned_alloc(RTE_CACHE_LINE_SIZE, size);
+	assert_non_null(p);
+	memset(p, 0, size);
+	return p;
+}
+
+static struct rte_node *node_alloc(uint16_t size) {
+	struct rte_node *node = zalloc_aligned(sizeof(*node) + N_EDGES * sizeof(node->nodes[0]));
+	node->size = size;
+	node->objs = calloc(size, sizeof(void *));
+	assert_non_null(node->objs);
+	return node;
+}
+
+static void node_free(struct rte_node *node) {
+	free(node->objs);
+	free(node);
+}
+
+static int setup(void **) {
+	graph = zalloc_aligned(sizeof(*graph));
+	graph->cir_start = pending;
+	graph->cir_mask = ARRAY_DIM(pending) - 1;
+
+	src = node_alloc(MAX_OBJS);
+	for (unsigned e = 0; e < N_EDGES; e++) {
+		next[e] = node_alloc(STREAM_SIZE);
+		next[e]->off = e + 1;
+		src->nodes[e] = next[e];
+	}
+	for (unsigned i = 0; i < MAX_OBJS; i++)
+		src->objs[i] = &pkts[i];
+
+	return 0;
+}
+
+static int teardown(void **) {
+	for (unsigned e = 0; e < N_EDGES; e++)
+		node_free(next[e]);
+	node_free(src);
+	free(graph);
+	return 0;
+}
+
+// Simulate a node process callback that sends objs[i] to edges[i].
+static void process(const rte_edge_t *edges, uint16_t n) {
+	struct gr_node_batch batch;
+
+	src->idx = n;
+	gr_node_batch_init(&batch, graph, src, src->objs, n);
+	for (uint16_t i = 0; i < n; i++)
+		gr_node_batch_enqueue(&batch, edges[i], src->objs[i]);
+	gr_node_batch_flush(&batch);
+}
+
+static void assert_stream(rte_edge_t edge, void *const *expected, uint16_t n) {
+	assert_int_equal(next[edge]->idx, n);
+	for (uint16_t i = 0; i < n; i++)
+		assert_ptr_equal(next[edge]->objs[i], expected[i]);
+}
+
+static void all_same_edge(void **) {
+	const rte_edge_t edges[] = {0, 0, 0, 0, 0};
+	void *expected[] = {&pkts[0], &pkts[1], &pkts[2], &pkts[3], &pkts[4]};
+	void **objs = src->objs;
+
+	process(edges, ARRAY_DIM(edges));
+
+	// The whole stream was handed over without any copy.
+	assert_ptr_equal(next[0]->objs, objs);
+	assert_stream(0, expected, ARRAY_DIM(expected));
+	assert_stream(1, NULL, 0);
+	assert_int_equal(graph->tail, 1);
+	assert_int_equal(pending[0], next[0]->off);
+}
+
+static void all_same_edge_not_empty(void **) {
+	const rte_edge_t edges[] = {0, 0, 0};
+	int other[2];
+	void *expected[] = {&other[0], &other[1], &pkts[0], &pkts[1], &pkts[2]};
+
+	next[0]->objs[0] = &other[0];
+	next[0]->objs[1] = &other[1];
+	next[0]->idx = 2;
+
+	process(edges, ARRAY_DIM(edges));
+
+	assert_stream(0, expected, ARRAY_DIM(expected));
+	assert_stream(1, NULL, 0);
+}
+
+static void diverge_first(void **) {
+	const rte_edge_t edges[] = {1, 0, 0, 0};
+	void *expected0[] = {&pkts[1], &pkts[2], &pkts[3]};
+	void *expected1[] = {&pkts[0]};
+
+	process(edges, ARRAY_DIM(edges));
+
+	assert_stream(0, expected0, ARRAY_DIM(expected0));
+	assert_stream(1, expected1, ARRAY_DIM(expected1));
+	assert_int_equal(graph->tail, 2);
+}
+
+static void diverge_mid(void **) {
+	const rte_edge_t edges[] = {0, 0, 1, 0, 0};
+	void *expected0[] = {&pkts[0], &pkts[1], &pkts[3], &pkts[4]};
+	void *expected1[] = {&pkts[2]};
+
+	process(edges, ARRAY_DIM(edges));
+
+	assert_stream(0, expected0, ARRAY_DIM(expected0));
+	assert_stream(1, expected1, ARRAY_DIM(expected1));
+}
+
+static void diverge_last(void **) {
+	const rte_edge_t edges[] = {0, 0, 0, 1};
+	void *expected0[] = {&pkts[0], &pkts[1], &pkts[2]};
+	void *expected1[] = {&pkts[3]};
+
+	process(edges, ARRAY_DIM(edges));
+
+	assert_stream(0, expected0, ARRAY_DIM(expected0));
+	assert_stream(1, expected1, ARRAY_DIM(expected1));
+}
+
+static void replaced_object(void **) {
+	void *expected[] = {&pkts[0], &pkts[1], &pkts[MAX_OBJS - 1], &pkts[3]};
+	struct gr_node_batch batch;
+
+	src->idx = 4;
+	gr_node_batch_init(&batch, graph, src, src->objs, 4);
+	gr_node_batch_enqueue(&batch, 0, src->objs[0]);
+	gr_node_batch_enqueue(&batch, 0, src->objs[1]);
+	// e.g. a node that replaced the mbuf by a copy
+	gr_node_batch_enqueue(&batch, 0, &pkts[MAX_OBJS - 1]);
+	gr_node_batch_enqueue(&batch, 0, src->objs[3]);
+	gr_node_batch_flush(&batch);
+
+	assert_stream(0, expected, ARRAY_DIM(expected));
+	assert_stream(1, NULL, 0);
+}
+
+static void burst_larger_than_stream(void **) {
+	void *expected0[MAX_OBJS], *expected1[MAX_OBJS];
+	uint16_t n0 = 0, n1 = 0;
+	rte_edge_t edges[MAX_OBJS];
+
+	// Both next streams must grow: the speculated one when it is fetched
+	// and the other one while objects are enqueued individually.
+	for (unsigned i = 0; i < MAX_OBJS; i++) {
+		edges[i] = i % 3 == 2 ? 1 : 0;
+		if (edges[i] == 0)
+			expected0[n0++] = &pkts[i];
+		else
+			expected1[n1++] = &pkts[i];
+	}
+	assert_true(n0 > STREAM_SIZE);
+	assert_true(n1 > STREAM_SIZE);
+
+	process(edges, MAX_OBJS);
+
+	assert_stream(0, expected0, n0);
+	assert_stream(1, expected1, n1);
+	assert_true(next[0]->size >= n0);
+	assert_true(next[1]->size >= n1);
+}
+
+static void empty(void **) {
+	process(NULL, 0);
+
+	assert_stream(0, NULL, 0);
+	assert_stream(1, NULL, 0);
+	assert_int_equal(graph->tail, 0);
+}
+
+int main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(all_same_edge, setup, teardown),
+		cmocka_unit_test_setup_teardown(all_same_edge_not_empty, setup, teardown),
+		cmocka_unit_test_setup_teardown(diverge_first, setup, teardown),
+		cmocka_unit_test_setup_teardown(diverge_mid, setup, teardown),
+		cmocka_unit_test_setup_teardown(diverge_last, setup, teardown),
+		cmocka_unit_test_setup_teardown(replaced_object, setup, teardown),
+		cmocka_unit_test_setup_teardown(burst_larger_than_stream, setup, teardown),
+		cmocka_unit_test_setup_teardown(empty, setup, teardown),
+	};
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -15,7 +15,7 @@ static bool group_equal(const struct nexthop *a, const struct nexthop *b) {
 	const struct nexthop_info_group *da = nexthop_info_group(a);
 	const struct nexthop_info_group *db = nexthop_info_group(b);
 
-	if (da->n_members != db->n_members)
+	if (da->n_members != db->n_members || da->backup != db->backup)
 		return false;
 	for (uint32_t i = 0; i < da->n_members; i++)
 		if (da->members[i].nh != db->members[i].nh
@@ -24,31 +24,34 @@ static bool group_equal(const struct nexthop *a, const struct nexthop *b) {
 	return true;
 }
 
-static void remove_group_member_cb(struct nexthop *nh, void *deleted) {
-	if (nh->type != GR_NH_T_GROUP)
-		return;
-
+static void group_remove_dependency(struct nexthop *nh, const struct nexthop *deleted) {
 	struct nexthop_info_group *g = nexthop_info_group(nh);
-	for (uint32_t i = 0; i < g->n_members; i++) {
+
+	for (uint32_t i = 0; i < g->n_members;) {
 		if (g->members[i].nh == deleted) {
-			g->members[i].nh = g->members[g->n_members - 1].nh;
-			g->members[i].weight = g->members[g->n_members - 1].weight;
+			g->members[i] = g->members[g->n_members - 1];
 			g->n_members--;
+		} else {
+			i++;
 		}
 	}
-}
-
-static void group_remove_references(struct nexthop *nh) {
-	nexthop_iter(remove_group_member_cb, nh);
+	// Spread the buckets of the deleted member over the remaining ones.
+	for (uint32_t i = 0; i < g->reta_size; i++) {
+		if (g->reta[i] == deleted)
+			g->reta[i] = g->n_members > 0 ? g->members[i % g->n_members].nh : NULL;
+	}
+	if (g->backup == deleted)
+		g->backup = NULL;
 }
 
 static void group_free(struct nexthop *nh) {
 	struct nexthop_info_group *pvt = nexthop_info_group(nh);
 
 	for (uint32_t i = 0; i < pvt->n_members; i++)
-		nexthop_decref(pvt->members[i].nh);
+		nexthop_decref_dep(pvt->members[i].nh, nh);
 	rte_free(pvt->members);
 	rte_free(pvt->reta);
+	nexthop_backup_set(nh, &pvt->backup, NULL);
 }
 
 static int order_by_weight_desc(const void *a, const void *b) {
@@ -65,9 +68,14 @@ static int group_import_info(struct nexthop *nh, const void *info) {
 	struct nexthop **old_reta = NULL;
 	uint32_t min_weight, max_weight;
 	struct nexthop **reta = NULL;
+	struct nexthop *backup;
 	uint32_t reta_size = 0;
 	uint32_t n_tmp = 0;
 
+	// Groups have no VRF, the backup is checked against each member below.
+	if (nexthop_backup_lookup(nh, GR_AF_UNSPEC, group->backup_nh_id, &backup) < 0)
+		return -errno;
+
 	members = rte_zmalloc(
 		__func__, group->n_members * sizeof(pvt->members[0]), RTE_CACHE_LINE_SIZE
 	);
@@ -78,13 +86,22 @@ static int group_import_info(struct nexthop *nh, const void *info) {
 
 	for (uint16_t i = 0; i < group->n_members; i++) {
 		struct nexthop *nh = nexthop_lookup_id(group->members[i].nh_id);
-		if (nh) {
-			members[i].nh = nh;
-			members[i].weight = group->members[i].weight;
-		} else {
+		if (nh == NULL) {
 			errno = ENOENT;
 			goto cleanup;
 		}
+		// Load balancing nodes do not follow recursive nexthops.
+		if (nh->type == GR_NH_T_RECURSIVE) {
+			errno = EINVAL;
+			goto cleanup;
+		}
+		if (backup != NULL && nh->type == GR_NH_T_L3
+		    && !nexthop_backup_valid(backup, nh->vrf_id, nexthop_info_l3(nh)->af)) {
+			errno = EINVAL;
+			goto cleanup;
+		}
+		members[i].nh = nh;
+		members[i].weight = group->members[i].weight;
 	}
 
 	if (group->n_members > 0) {
@@ -115,7 +132,7 @@ static int group_import_info(struct nexthop *nh, const void *info) {
 		}
 
 		for (uint16_t i = 0; i < group->n_members; i++)
-			nexthop_incref(members[i].nh);
+			nexthop_incref_dep(members[i].nh, nh);
 
 		// Fill the reta table with weighted distribution
 		uint32_t total_weight = 0;
@@ -150,14 +167,18 @@ static int group_import_info(struct nexthop *nh, const void *info) {
 	pvt->members = members;
 	pvt->reta_size = reta_size;
 	pvt->reta = reta;
+	nexthop_backup_set(nh, &pvt->backup, backup);
 
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-
+	// Like backups, previous members that are released here are only
+	// reclaimed by nexthop_destroy() after the datapath stopped using them.
 	for (uint32_t i = 0; i < n_tmp; i++)
-		nexthop_decref(tmp[i].nh);
+		nexthop_decref_dep(tmp[i].nh, nh);
 
-	rte_free(old_reta);
-	rte_free(tmp);
+	// The datapath may still be reading the previous arrays.
+	if (old_reta != NULL)
+		gr_rcu_defer(rte_free, old_reta);
+	if (tmp != NULL)
+		gr_rcu_defer(rte_free, tmp);
 	return 0;
 
 cleanup:
@@ -184,6 +205,7 @@ static struct gr_nexthop *group_to_api(const struct nexthop *nh, size_t *len) {
 	group_pub = (struct gr_nexthop_info_group *)pub->info;
 
 	group_pub->n_members = group_priv->n_members;
+	group_pub->backup_nh_id = group_priv->backup ? group_priv->backup->nh_id : GR_NH_ID_UNSET;
 	for (uint32_t i = 0; i < group_pub->n_members; i++) {
 		group_pub->members[i].nh_id = group_priv->members[i].nh->nh_id;
 		group_pub->members[i].weight = group_priv->members[i].weight;
@@ -194,7 +216,7 @@ static struct gr_nexthop *group_to_api(const struct nexthop *nh, size_t *len) {
 
 static struct nexthop_type_ops group_nh_ops = {
 	.equal = group_equal,
-	.remove_references = group_remove_references,
+	.remove_dependency = group_remove_dependency,
 	.free = group_free,
 	.import_info = group_import_info,
 	.to_api = group_to_api,
@@ -127,18 +127,14 @@ static int l3_reconfig(const struct gr_nexthop_config *c) {
 	if (h == NULL)
 		return errno_log(rte_errno, "rte_hash_create");
 
-	struct rte_hash_rcu_config conf = {
-		.v = gr_datapath_rcu(),
-		.mode = RTE_HASH_QSBR_MODE_SYNC,
-	};
-	if (rte_hash_rcu_qsbr_add(h, &conf) < 0) {
+	if (gr_rcu_hash_attach(h, NULL, NULL) < 0) {
 		rte_hash_free(h);
-		return errno_log(rte_errno, "rte_hash_rcu_qsbr_add");
+		return errno_log(errno, "gr_rcu_hash_attach");
 	}
 
 	struct rte_hash *tmp = l3_hash;
 	l3_hash = h;
-	rte_hash_free(tmp);
+	gr_rcu_hash_free(tmp);
 
 	return 0;
 }
@@ -164,6 +160,13 @@ static void l3_remove_references(struct nexthop *nh) {
 	}
 }
 
+static void l3_remove_dependency(struct nexthop *nh, const struct nexthop *deleted) {
+	struct nexthop_info_l3 *l3 = nexthop_info_l3(nh);
+
+	if (l3->backup == deleted)
+		l3->backup = NULL;
+}
+
 static void l3_free(struct nexthop *nh) {
 	struct nexthop_info_l3 *l3 = nexthop_info_l3(nh);
 
@@ -174,6 +177,8 @@ static void l3_free(struct nexthop *nh) {
 		rte_pktmbuf_free(m);
 		m = next;
 	}
+
+	nexthop_backup_set(nh, &l3->backup, NULL);
 }
 
 static bool l3_equal(const struct nexthop *a, const struct nexthop *b) {
@@ -199,8 +204,12 @@ static int l3_import_info(struct nexthop *nh, const void *info) {
 	const struct gr_nexthop_info_l3 *pub = info;
 	struct nexthop_key old_key, key;
 	bool has_old_addr, has_new_addr;
+	struct nexthop *backup;
 	int ret;
 
+	if ((ret = nexthop_backup_lookup(nh, pub->af, pub->backup_nh_id, &backup)) < 0)
+		return ret;
+
 	priv.flags = pub->flags;
 
 	switch (pub->af) {
@@ -261,6 +270,7 @@ static int l3_import_info(struct nexthop *nh, const void *info) {
 		rte_hash_del_key(l3_hash, &old_key);
 
 	*nexthop_info_l3(nh) = priv;
+	nexthop_backup_set(nh, &nexthop_info_l3(nh)->backup, backup);
 
 	return 0;
 }
@@ -277,6 +287,7 @@ static struct gr_nexthop *l3_to_api(const struct nexthop *nh, size_t *len) {
 	pub->base = nh->base;
 	l3_pub = (struct gr_nexthop_info_l3 *)pub->info;
 	*l3_pub = l3_priv->base;
+	l3_pub->backup_nh_id = l3_priv->backup ? l3_priv->backup->nh_id : GR_NH_ID_UNSET;
 
 	*len = sizeof(*pub) + sizeof(*l3_pub);
 
@@ -287,6 +298,7 @@ static struct nexthop_type_ops l3_nh_ops = {
 	.reconfig = l3_reconfig,
 	.lookup = l3_lookup,
 	.remove_references = l3_remove_references,
+	.remove_dependency = l3_remove_dependency,
 	.free = l3_free,
 	.equal = l3_equal,
 	.import_info = l3_import_info,
@@ -366,7 +378,7 @@ static void l3_init(struct event_base *ev_base) {
 }
 
 static void l3_fini(struct event_base *) {
-	rte_hash_free(l3_hash);
+	gr_rcu_hash_free(l3_hash);
 	if (ageing_timer)
 		event_free(ageing_timer);
 }
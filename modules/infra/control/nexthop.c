@@ -5,6 +5,7 @@
 #include "event.h"
 #include "id_pool.h"
 #include "iface.h"
+#include "l3.h"
 #include "log.h"
 #include "metrics.h"
 #include "module.h"
@@ -12,9 +13,11 @@
 #include "rcu.h"
 
 #include <rte_hash.h>
+#include <rte_malloc.h>
 #include <rte_mempool.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 
 LOG_TYPE("nexthop");
 
@@ -26,6 +29,20 @@ LOG_TYPE("nexthop");
 #define DEFAULT_BCAST_PROBES 3
 
 static struct rte_mempool *pool;
+struct nexthop **nexthop_table;
+// Reverse indexes, also indexed by nexthop->idx.
+struct nexthop_refs {
+	// Nexthops that reference this one as group member, backup or recursive
+	// target. An entry is recorded for each reference.
+	struct hoplist deps;
+	// Routes that point to this nexthop.
+	vec struct nexthop_route **routes;
+	// Position in iface_nexthops[nexthop->iface_id].
+	uint32_t iface_pos;
+};
+static struct nexthop_refs *refs;
+// Nexthops attached to each interface.
+static vec struct nexthop **iface_nexthops[GR_MAX_IFACES];
 static struct id_pool *pool_id;
 static struct rte_hash *hash_by_id;
 static const struct nexthop_type_ops *type_ops[256];
@@ -50,7 +67,54 @@ unsigned nexthop_used_count(void) {
 	return count;
 }
 
-static struct rte_mempool *create_mempool(const struct gr_nexthop_config *c) {
+static inline unsigned mempool_size(const struct gr_nexthop_config *c) {
+	return rte_align32pow2(c->max_count) - 1;
+}
+
+static void nh_obj_init(struct rte_mempool *, void *table, void *obj, unsigned obj_idx) {
+	struct nexthop **nexthops = table;
+	struct nexthop *nh = obj;
+
+	// Index 0 is reserved for the FIB default value.
+	nh->idx = obj_idx + 1;
+	nexthops[nh->idx] = nh;
+}
+
+static struct nexthop **create_table(const struct gr_nexthop_config *c) {
+	struct nexthop **table;
+
+	// One extra slot for the unused index 0.
+	table = rte_zmalloc(
+		"nexthop_table", (mempool_size(c) + 1) * sizeof(*table), RTE_CACHE_LINE_SIZE
+	);
+	if (table == NULL)
+		return errno_log_null(ENOMEM, "rte_zmalloc(nexthop_table)");
+
+	return table;
+}
+
+static struct nexthop_refs *create_refs(const struct gr_nexthop_config *c) {
+	struct nexthop_refs *r;
+
+	r = rte_calloc(__func__, mempool_size(c) + 1, sizeof(*r), RTE_CACHE_LINE_SIZE);
+	if (r == NULL)
+		return errno_log_null(ENOMEM, "rte_calloc(nexthop_refs)");
+
+	return r;
+}
+
+static void free_refs(struct nexthop_refs *r) {
+	if (r == NULL)
+		return;
+	for (unsigned i = 0; i <= mempool_size(&nh_conf); i++) {
+		vec_free(r[i].deps.nh);
+		vec_free(r[i].routes);
+	}
+	rte_free(r);
+}
+
+static struct rte_mempool *
+create_mempool(const struct gr_nexthop_config *c, struct nexthop **table) {
 	if (pool != NULL && nexthop_used_count() > 0)
 		return errno_set_null(EBUSY);
 
@@ -58,14 +122,14 @@ static struct rte_mempool *create_mempool(const struct gr_nexthop_config *c) {
 	snprintf(name, sizeof(name), "nexthops-%u", c->max_count);
 	struct rte_mempool *p = rte_mempool_create(
 		name,
-		rte_align32pow2(c->max_count) - 1,
+		mempool_size(c),
 		sizeof(struct nexthop),
 		0, // cache size
 		0, // priv size
 		NULL, // mp_init
 		NULL, // mp_init_arg
-		NULL, // obj_init
-		NULL, // obj_init_arg
+		nh_obj_init, // obj_init
+		table, // obj_init_arg
 		SOCKET_ID_ANY,
 		0 // flags
 	);
@@ -143,19 +207,17 @@ static struct rte_hash *create_hash_by_id(const struct gr_nexthop_config *c) {
 	if (h == NULL)
 		return errno_log_null(rte_errno, "rte_hash_create");
 
-	struct rte_hash_rcu_config conf = {
-		.v = gr_datapath_rcu(),
-		.mode = RTE_HASH_QSBR_MODE_SYNC,
-	};
-	if (rte_hash_rcu_qsbr_add(h, &conf)) {
+	if (gr_rcu_hash_attach(h, NULL, NULL) < 0) {
 		rte_hash_free(h);
-		return errno_log_null(rte_errno, "rte_hash_rcu_qsbr_add");
+		return errno_log_null(errno, "gr_rcu_hash_attach");
 	}
 
 	return h;
 }
 
 static int nexthop_config_allocate(const struct gr_nexthop_config *c) {
+	struct nexthop_refs *r = NULL;
+	struct nexthop **table = NULL;
 	struct rte_mempool *p = NULL;
 	struct rte_hash *hid = NULL;
 	struct id_pool *pid = NULL;
@@ -163,11 +225,22 @@ static int nexthop_config_allocate(const struct gr_nexthop_config *c) {
 	if (pool != NULL && (c->max_count == 0 || c->max_count == nh_conf.max_count))
 		return 0;
 
+	// Destroyed nexthops must be back in the pool before it is replaced.
+	gr_rcu_defer_flush();
+
 	LOG(INFO, "%u nexthops", c->max_count);
-	p = create_mempool(c);
+	table = create_table(c);
+	if (table == NULL)
+		goto fail;
+
+	p = create_mempool(c, table);
 	if (p == NULL)
 		goto fail;
 
+	r = create_refs(c);
+	if (r == NULL)
+		goto fail;
+
 	hid = create_hash_by_id(c);
 	if (hid == NULL)
 		goto fail;
@@ -187,7 +260,17 @@ static int nexthop_config_allocate(const struct gr_nexthop_config *c) {
 
 	rte_mempool_free(pool);
 	pool = p;
-	rte_hash_free(hash_by_id);
+	if (nexthop_table != NULL) {
+		// No nexthop is in use but the datapath may still read index 0.
+		struct nexthop **old = nexthop_table;
+		nexthop_table = table;
+		gr_rcu_defer(rte_free, old);
+	} else {
+		nexthop_table = table;
+	}
+	free_refs(refs);
+	refs = r;
+	gr_rcu_hash_free(hash_by_id);
 	hash_by_id = hid;
 	id_pool_destroy(pool_id);
 	pool_id = pid;
@@ -198,8 +281,10 @@ static int nexthop_config_allocate(const struct gr_nexthop_config *c) {
 fail:
 	if (p)
 		rte_mempool_free(p);
+	rte_free(table);
+	rte_free(r);
 	if (hid)
-		rte_hash_free(hid);
+		gr_rcu_hash_free(hid);
 	if (pid)
 		id_pool_destroy(pid);
 
@@ -233,6 +318,7 @@ bool nexthop_type_valid(gr_nh_type_t type) {
 	case GR_NH_T_BLACKHOLE:
 	case GR_NH_T_REJECT:
 	case GR_NH_T_GROUP:
+	case GR_NH_T_RECURSIVE:
 		return true;
 	}
 	return false;
@@ -306,6 +392,7 @@ struct nexthop *nexthop_lookup(const struct gr_nexthop_base *base, const void *i
 
 struct nexthop *nexthop_new(const struct gr_nexthop_base *base, const void *info) {
 	struct nexthop *nh;
+	uint32_t idx;
 	void *data;
 	int ret;
 
@@ -315,11 +402,17 @@ struct nexthop *nexthop_new(const struct gr_nexthop_base *base, const void *info
 	if (rte_lcore_has_role(rte_lcore_id(), ROLE_NON_EAL))
 		ABORT("nexthop created from datapath thread");
 
-	if ((ret = rte_mempool_get(pool, &data)) < 0)
-		return errno_set_null(-ret);
+	if ((ret = rte_mempool_get(pool, &data)) < 0) {
+		// Destroyed nexthops may still be waiting for a grace period.
+		gr_rcu_defer_flush();
+		if ((ret = rte_mempool_get(pool, &data)) < 0)
+			return errno_set_null(-ret);
+	}
 
 	nh = data;
+	idx = nh->idx;
 	memset(nh, 0, sizeof(*nh));
+	nh->idx = idx;
 
 	if ((ret = nexthop_update(nh, base, info)) < 0) {
 		rte_mempool_put(pool, nh);
@@ -334,6 +427,26 @@ struct nexthop *nexthop_new(const struct gr_nexthop_base *base, const void *info
 	return nh;
 }
 
+static void iface_index_add(struct nexthop *nh) {
+	if (nh->iface_id == GR_IFACE_ID_UNDEF)
+		return;
+	refs[nh->idx].iface_pos = vec_len(iface_nexthops[nh->iface_id]);
+	vec_add(iface_nexthops[nh->iface_id], nh);
+}
+
+static void iface_index_del(struct nexthop *nh, uint16_t iface_id) {
+	uint32_t pos = refs[nh->idx].iface_pos;
+
+	if (iface_id == GR_IFACE_ID_UNDEF)
+		return;
+
+	assert(pos < vec_len(iface_nexthops[iface_id]));
+	assert(iface_nexthops[iface_id][pos] == nh);
+	vec_del_swap(iface_nexthops[iface_id], pos);
+	if (pos < vec_len(iface_nexthops[iface_id]))
+		refs[iface_nexthops[iface_id][pos]->idx].iface_pos = pos;
+}
+
 int nexthop_update(struct nexthop *nh, const struct gr_nexthop_base *base, const void *info) {
 	const struct nexthop_type_ops *ops = type_ops[base->type];
 	struct gr_nexthop_base backup = nh->base;
@@ -352,7 +465,7 @@ int nexthop_update(struct nexthop *nh, const struct gr_nexthop_base *base, const
 	if ((ret = nexthop_id_get(nh)) < 0)
 		return ret;
 
-	if (nh->type == GR_NH_T_GROUP) {
+	if (nh->type == GR_NH_T_GROUP || nh->type == GR_NH_T_RECURSIVE) {
 		nh->vrf_id = GR_VRF_ID_UNDEF;
 	} else if (nh->iface_id != GR_IFACE_ID_UNDEF) {
 		const struct iface *iface = iface_from_id(nh->iface_id);
@@ -372,6 +485,14 @@ int nexthop_update(struct nexthop *nh, const struct gr_nexthop_base *base, const
 			goto err;
 	}
 
+	// Nexthops being created have a zero refcount and are not indexed yet.
+	if (nh->ref_count == 0) {
+		iface_index_add(nh);
+	} else if (nh->iface_id != backup.iface_id) {
+		iface_index_del(nh, backup.iface_id);
+		iface_index_add(nh);
+	}
+
 	if (nh->ref_count > 0 && nh->origin != GR_NH_ORIGIN_INTERNAL)
 		event_push(GR_EVENT_NEXTHOP_UPDATE, nh);
 
@@ -462,50 +583,132 @@ struct nexthop *nexthop_lookup_id(uint32_t nh_id) {
 	return data;
 }
 
-static void nh_cleanup_interface_cb(struct nexthop *nh, void *priv) {
-	if (nh->iface_id == (uintptr_t)priv) {
+static void nexthop_iface_cleanup(uint32_t /*ev_type*/, const void *data) {
+	const struct iface *iface = data;
+	vec struct nexthop **nhs = NULL;
+	struct nexthop *nh;
+
+	vec_foreach (nh, iface_nexthops[iface->id]) {
 		if (nh->type == GR_NH_T_L3) {
 			struct nexthop_info_l3 *l3 = nexthop_info_l3(nh);
 			if ((l3->flags & NH_LOCAL_ADDR_FLAGS) == NH_LOCAL_ADDR_FLAGS)
-				return; // addresses are cleaned per address family
+				continue; // addresses are cleaned per address family
 		}
+		// Destroying a nexthop may release the last reference of
+		// another one in the list. Hold them until they are visited.
+		nexthop_incref(nh);
+		vec_add(nhs, nh);
+	}
+
+	vec_foreach (nh, nhs) {
 		nexthop_routes_cleanup(nh);
-		while (nh->ref_count)
+		while (nh->ref_count > 1)
 			nexthop_decref(nh);
+		nexthop_decref(nh);
 	}
+	vec_free(nhs);
 }
 
-static void nexthop_iface_cleanup(uint32_t /*ev_type*/, const void *data) {
-	const struct iface *iface = data;
-	nexthop_iter(nh_cleanup_interface_cb, (void *)(uintptr_t)iface->id);
+bool nexthop_backup_valid(const struct nexthop *backup, uint16_t vrf_id, addr_family_t af) {
+	return backup->vrf_id == vrf_id && nexthop_info_l3(backup)->af == af;
+}
+
+int nexthop_backup_lookup(
+	const struct nexthop *nh,
+	addr_family_t af,
+	uint32_t backup_nh_id,
+	struct nexthop **backup
+) {
+	*backup = NULL;
+
+	if (backup_nh_id == GR_NH_ID_UNSET)
+		return 0;
+
+	if ((*backup = nexthop_lookup_id(backup_nh_id)) == NULL)
+		return errno_set(ENOENT);
+	// The datapath only redirects packets to backups of type L3. Packets are
+	// not looked up again, the backup must be usable in place of nh.
+	if (*backup == nh || (*backup)->type != GR_NH_T_L3
+	    || (nh->vrf_id != GR_VRF_ID_UNDEF && !nexthop_backup_valid(*backup, nh->vrf_id, af))) {
+		*backup = NULL;
+		return errno_set(EINVAL);
+	}
+
+	return 0;
+}
+
+void nexthop_backup_set(struct nexthop *nh, struct nexthop **slot, struct nexthop *backup) {
+	struct nexthop *old = *slot;
+
+	if (backup == old)
+		return;
+	if (backup != NULL)
+		nexthop_incref_dep(backup, nh);
+	*slot = backup;
+	// If this was the last reference, nexthop_destroy() waits for the
+	// datapath to stop using the old backup before freeing it.
+	if (old != NULL)
+		nexthop_decref_dep(old, nh);
+}
+
+static void nexthop_put(void *obj) {
+	rte_mempool_put(pool, obj);
+}
+
+// Called once all datapath workers have gone through a quiescent state.
+static void nexthop_reclaim(void *obj) {
+	const struct nexthop_type_ops *ops;
+	struct nexthop *nh = obj;
+
+	// Drain the control queue after the grace period to ensure all
+	// datapath threads have seen that this nexthop is gone. At this point,
+	// only packets already in the control queue may still reference it.
+	control_queue_drain(GR_EVENT_NEXTHOP_DELETE, nh);
+
+	ops = type_ops[nh->type];
+	if (ops != NULL && ops->free != NULL)
+		ops->free(nh);
+
+	// Hold queue entries created during the grace period may still point
+	// to this nexthop. Invalidate them again and wait for the datapath
+	// to drop them before the memory can be reused by another nexthop.
+	nh_hold_invalidate(nh);
+	gr_rcu_defer(nexthop_put, nh);
 }
 
 void nexthop_destroy(struct nexthop *nh) {
 	const struct nexthop_type_ops *ops;
+	struct hoplist *deps;
+	struct nexthop *dep;
 
 	assert(nh->ref_count == 0);
+	// Routes hold references, they must have been deleted.
+	assert(vec_len(refs[nh->idx].routes) == 0);
 
-	for (gr_nh_type_t t = 0; nexthop_type_valid(t); t++) {
-		ops = type_ops[t];
-		if (ops != NULL && ops->remove_references != NULL)
-			ops->remove_references(nh);
+	ops = type_ops[nh->type];
+	if (ops != NULL && ops->remove_references != NULL)
+		ops->remove_references(nh);
+
+	// Only visit the nexthops that still reference this one. The list is
+	// empty unless the nexthop is being forcibly destroyed.
+	deps = &refs[nh->idx].deps;
+	vec_foreach (dep, deps->nh) {
+		ops = type_ops[dep->type];
+		if (ops != NULL && ops->remove_dependency != NULL)
+			ops->remove_dependency(dep, nh);
 	}
-	nexthop_id_put(nh);
+	vec_free(deps->nh);
+	vec_free(refs[nh->idx].routes);
+	iface_index_del(nh, nh->iface_id);
 
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-
-	// Drain the control queue after RCU sync to ensure all datapath
-	// threads have seen that this nexthop is gone. At this point, only
-	// packets already in the control queue may still reference it.
-	control_queue_drain(GR_EVENT_NEXTHOP_DELETE, nh);
+	nexthop_id_put(nh);
 
 	if (nh->origin != GR_NH_ORIGIN_INTERNAL)
 		event_push(GR_EVENT_NEXTHOP_DELETE, nh);
 
-	ops = type_ops[nh->type];
-	if (ops != NULL && ops->free != NULL)
-		ops->free(nh);
-	rte_mempool_put(pool, nh);
+	// Datapath hold queues keep nexthop references across graph walks.
+	nh_hold_invalidate(nh);
+	gr_rcu_defer(nexthop_reclaim, nh);
 }
 
 void nexthop_decref(struct nexthop *nh) {
@@ -519,14 +722,69 @@ void nexthop_incref(struct nexthop *nh) {
 	nh->ref_count++;
 }
 
+void nexthop_incref_dep(struct nexthop *nh, struct nexthop *dep) {
+	vec_add(refs[nh->idx].deps.nh, dep);
+	nexthop_incref(nh);
+}
+
+void nexthop_decref_dep(struct nexthop *nh, struct nexthop *dep) {
+	struct hoplist *deps = &refs[nh->idx].deps;
+
+	for (uint32_t i = 0; i < vec_len(deps->nh); i++) {
+		if (deps->nh[i] == dep) {
+			vec_del_swap(deps->nh, i);
+			break;
+		}
+	}
+	// The entry must be removed first, nh may be destroyed here.
+	nexthop_decref(nh);
+}
+
+struct nexthop_route *nexthop_route_add(struct nexthop *nh, const struct nexthop_route *route) {
+	struct nexthop_refs *r = &refs[nh->idx];
+	struct nexthop_route *copy;
+
+	if ((copy = malloc(sizeof(*copy))) == NULL)
+		return errno_set_null(ENOMEM);
+
+	*copy = *route;
+	copy->pos = vec_len(r->routes);
+	vec_add(r->routes, copy);
+
+	return copy;
+}
+
+void nexthop_route_del(struct nexthop *nh, struct nexthop_route *route) {
+	struct nexthop_refs *r = &refs[nh->idx];
+	uint32_t pos = route->pos;
+
+	assert(pos < vec_len(r->routes));
+	assert(r->routes[pos] == route);
+	vec_del_swap(r->routes, pos);
+	if (pos < vec_len(r->routes))
+		r->routes[pos]->pos = pos;
+	free(route);
+}
+
+vec struct nexthop_route *const *nexthop_routes(const struct nexthop *nh) {
+	return refs[nh->idx].routes;
+}
+
 static void nh_init(struct event_base *) {
 	if (nexthop_config_allocate(&nh_conf) < 0)
 		ABORT("nexthop_config_allocate failed: %s", strerror(errno));
 }
 
 static void nh_fini(struct event_base *) {
-	rte_hash_free(hash_by_id);
+	gr_rcu_hash_free(hash_by_id);
+	gr_rcu_defer_flush();
 	rte_mempool_free(pool);
+	rte_free(nexthop_table);
+	nexthop_table = NULL;
+	free_refs(refs);
+	refs = NULL;
+	for (unsigned i = 0; i < ARRAY_DIM(iface_nexthops); i++)
+		vec_free(iface_nexthops[i]);
 }
 
 int nexthop_serialize(const void *obj, void **buf) {
@@ -544,7 +802,7 @@ int nexthop_serialize(const void *obj, void **buf) {
 
 static struct module module = {
 	.name = "nexthop",
-	.depends_on = "rcu,control_queue",
+	.depends_on = "rcu_defer,control_queue",
 	.init = nh_init,
 	.fini = nh_fini,
 };
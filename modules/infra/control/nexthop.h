@@ -13,23 +13,38 @@
 #include <rte_mbuf.h>
 
 #include <assert.h>
+#include <errno.h>
 
 extern struct gr_nexthop_config nh_conf;
 
 int nexthop_config_set(const struct gr_nexthop_config *);
 unsigned nexthop_used_count(void);
 
+#define NEXTHOP_INFO_OFFSET                                                                        \
+	RTE_ALIGN_CEIL(sizeof(struct gr_nexthop_base) + 2 * sizeof(uint32_t), alignof(void *))
+
 struct __rte_cache_aligned nexthop {
 	BASE(gr_nexthop_base);
 
 	uint32_t ref_count; // number of routes referencing this nexthop
+	uint32_t idx; // position in nexthop_table, stored as value in FIBs (never changes)
 
-	uint8_t info
-		[RTE_CACHE_LINE_MIN_SIZE * 2 - sizeof(struct gr_nexthop_base)
-		 - sizeof(uint32_t)] __rte_aligned(alignof(void *));
+	uint8_t info[RTE_CACHE_LINE_MIN_SIZE * 2 - NEXTHOP_INFO_OFFSET]
+		__rte_aligned(alignof(void *));
 };
 static_assert(sizeof(struct nexthop) <= (RTE_CACHE_LINE_MIN_SIZE * 2));
 
+// Dense table of all nexthop objects of the global pool, indexed by nexthop->idx.
+// Index 0 is never used and always resolves to NULL.
+//
+// FIBs store these 32-bit indexes instead of 64-bit pointers which halves the
+// size of their lookup tables.
+extern struct nexthop **nexthop_table;
+
+static inline struct nexthop *nexthop_from_idx(uint32_t idx) {
+	return nexthop_table[idx];
+}
+
 #define GR_NH_TYPE_INFO(type_id, type_name, fields)                                                \
 	struct type_name fields __attribute__((__may_alias__, aligned(alignof(void *))));          \
 	static inline struct type_name *type_name(const struct nexthop *nh) {                      \
@@ -51,6 +66,8 @@ GR_NH_TYPE_INFO(GR_NH_T_L3, nexthop_info_l3, {
 	uint16_t held_pkts;
 	struct rte_mbuf *held_pkts_head;
 	struct rte_mbuf *held_pkts_tail;
+
+	struct nexthop *backup; //!< used by the datapath while iface_id is down
 });
 
 struct hoplist {
@@ -68,6 +85,7 @@ GR_NH_TYPE_INFO(GR_NH_T_GROUP, nexthop_info_group, {
 	uint16_t reta_size; // MUST BE A POWER OF TWO
 	struct nh_group_member *members;
 	struct nexthop **reta;
+	struct nexthop *backup; // used by the datapath when no member can forward
 });
 
 static inline struct nexthop *
@@ -77,6 +95,40 @@ nexthop_group_get_nh(struct nexthop_info_group *nhg, uint32_t flow_id) {
 	return nhg->reta[flow_id & (nhg->reta_size - 1)];
 }
 
+GR_NH_TYPE_INFO(GR_NH_T_RECURSIVE, nexthop_info_recursive, {
+	// Never a recursive nexthop. NULL when unresolved.
+	struct nexthop *nh;
+});
+
+// Follow a recursive nexthop to the nexthop it currently resolves to.
+// Other nexthops are returned as is. Sets errno if the result is NULL.
+static inline struct nexthop *nexthop_resolve(struct nexthop *nh) {
+	if (unlikely(nh != NULL && nh->type == GR_NH_T_RECURSIVE)) {
+		nh = nexthop_info_recursive(nh)->nh;
+		if (nh == NULL)
+			errno = EHOSTUNREACH;
+	}
+	return nh;
+}
+
+// Lookup a fast reroute backup nexthop from its user provided ID. Only L3
+// nexthops other than nh itself can be used. When nh has a VRF, the backup must
+// be in the same VRF and have the same address family af. *backup is set to
+// NULL when backup_nh_id is GR_NH_ID_UNSET.
+int nexthop_backup_lookup(
+	const struct nexthop *nh,
+	addr_family_t af,
+	uint32_t backup_nh_id,
+	struct nexthop **backup
+);
+
+// Check that backup can replace an L3 nexthop of the given VRF and address family.
+bool nexthop_backup_valid(const struct nexthop *backup, uint16_t vrf_id, addr_family_t af);
+
+// Replace the backup nexthop of nh referenced by *slot, updating reference
+// counts and reverse dependencies.
+void nexthop_backup_set(struct nexthop *nh, struct nexthop **slot, struct nexthop *backup);
+
 // Lookup an L3 nexthop that matches the specified criteria.
 struct nexthop *
 nexthop_lookup_l3(addr_family_t af, uint16_t vrf_id, uint16_t iface_id, const void *addr);
@@ -112,6 +164,30 @@ int nexthop_serialize(const void *obj, void **buf);
 // Clean all routes that reference a given nexthop.
 void nexthop_routes_cleanup(struct nexthop *);
 
+// Route recorded in the reverse index of the nexthop it points to. RIBs keep a
+// pointer to it in their node extension so that it can be removed in constant
+// time.
+struct nexthop_route {
+	uint32_t pos; // position in the routes of the nexthop, managed by nexthop.c
+	uint16_t vrf_id;
+	uint16_t iface_id; // scope of IPv6 link-local destinations
+	addr_family_t af;
+	uint8_t prefixlen;
+	union {
+		ip4_addr_t ipv4;
+		struct rte_ipv6_addr ipv6;
+	};
+};
+
+// Record a route that references nh. Returns a copy owned by the index.
+struct nexthop_route *nexthop_route_add(struct nexthop *nh, const struct nexthop_route *);
+
+// Remove a route returned by nexthop_route_add() from the index of nh and free it.
+void nexthop_route_del(struct nexthop *nh, struct nexthop_route *);
+
+// Routes that reference nh. The vector is modified when routes are deleted.
+vec struct nexthop_route *const *nexthop_routes(const struct nexthop *nh);
+
 // Increment the reference counter of a nexthop.
 void nexthop_incref(struct nexthop *);
 
@@ -119,6 +195,14 @@ void nexthop_incref(struct nexthop *);
 // When the counter drops to 0, the nexthop is destroyed and returned to the global pool.
 void nexthop_decref(struct nexthop *);
 
+// Same as nexthop_incref() when the reference is held by another nexthop (group
+// member, backup, recursive target). The dependent nexthop is recorded so that
+// its remove_dependency callback is invoked if nh is forcibly destroyed.
+void nexthop_incref_dep(struct nexthop *nh, struct nexthop *dep);
+
+// Release a reference taken with nexthop_incref_dep().
+void nexthop_decref_dep(struct nexthop *nh, struct nexthop *dep);
+
 // Return the nexthop to the global pool regardless of its refcount.
 void nexthop_destroy(struct nexthop *);
 
@@ -151,8 +235,12 @@ const struct nexthop_af_ops *nexthop_af_ops_from_mbuf(const struct rte_mbuf *);
 struct nexthop_type_ops {
 	int (*reconfig)(const struct gr_nexthop_config *);
 	struct nexthop *(*lookup)(const struct gr_nexthop_base *, const void *info);
-	// Callback that will be invoked the nexthop refcount reaches zero.
+	// Callback that will be invoked on a nexthop of this type when its refcount
+	// reaches zero.
 	void (*remove_references)(struct nexthop *);
+	// Drop all pointers to a destroyed nexthop from a nexthop of this type.
+	// Only invoked for nexthops that referenced it with nexthop_incref_dep().
+	void (*remove_dependency)(struct nexthop *, const struct nexthop *deleted);
 	void (*free)(struct nexthop *);
 	bool (*equal)(const struct nexthop *, const struct nexthop *);
 	// Copy public info structure to internal info structure.
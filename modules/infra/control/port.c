@@ -83,10 +83,42 @@ static struct rte_eth_conf default_port_config = {
 		.offloads = RTE_ETH_RX_OFFLOAD_CHECKSUM | RTE_ETH_RX_OFFLOAD_VLAN_STRIP,
 	},
 	.txmode = {
-		.offloads = 0,
+		.offloads = RTE_ETH_TX_OFFLOAD_MULTI_SEGS,
 	},
 };
 
+// Toeplitz key made of a repeated 16-bit pattern. The hash of a flow is the same
+// when its source and destination addresses and ports are swapped.
+static uint8_t symmetric_rss_key[64] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+static void port_rss_symmetric(
+	const struct iface_info_port *p,
+	const struct rte_eth_dev_info *info,
+	struct rte_eth_rss_conf *rss
+) {
+	if (info->rss_algo_capa & RTE_ETH_HASH_ALGO_CAPA_MASK(SYMMETRIC_TOEPLITZ)) {
+		// Hardware symmetric hashing, independent of the key.
+		rss->algorithm = RTE_ETH_HASH_FUNCTION_SYMMETRIC_TOEPLITZ;
+	} else if (info->hash_key_size > 0 && info->hash_key_size <= sizeof(symmetric_rss_key)
+		   && info->rss_algo_capa & RTE_ETH_HASH_ALGO_CAPA_MASK(TOEPLITZ)) {
+		// Regular Toeplitz with a key that makes it symmetric.
+		rss->algorithm = RTE_ETH_HASH_FUNCTION_TOEPLITZ;
+		rss->rss_key = symmetric_rss_key;
+		rss->rss_key_len = info->hash_key_size;
+	} else {
+		LOG(NOTICE,
+		    "port %s: driver %s does not support symmetric RSS",
+		    p->devargs,
+		    info->driver_name);
+	}
+}
+
 int port_configure(struct iface_info_port *p, uint16_t n_txq_min) {
 	struct rte_eth_conf conf = default_port_config;
 	int socket_id = SOCKET_ID_ANY;
@@ -146,6 +178,8 @@ int port_configure(struct iface_info_port *p, uint16_t n_txq_min) {
 		conf.rxmode.mq_mode = RTE_ETH_MQ_RX_NONE;
 	else
 		conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+	if (p->symmetric_rss && conf.rxmode.mq_mode == RTE_ETH_MQ_RX_RSS)
+		port_rss_symmetric(p, &info, &conf.rx_adv_conf.rss_conf);
 	conf.rxmode.offloads &= info.rx_offload_capa;
 	conf.txmode.offloads &= info.tx_offload_capa;
 	if (info.dev_flags != NULL && *info.dev_flags & RTE_ETH_DEV_INTR_LSC) {
@@ -156,6 +190,7 @@ int port_configure(struct iface_info_port *p, uint16_t n_txq_min) {
 		return errno_log(-ret, "rte_eth_dev_configure");
 
 	p->rx_offloads = conf.rxmode.offloads;
+	p->tx_offloads = conf.txmode.offloads;
 
 	// initialize rx/tx queues
 	for (size_t q = 0; q < p->n_rxq; q++) {
@@ -288,7 +323,8 @@ static int iface_port_reconfig(
 	int ret;
 
 	if (!(set_attrs
-	      & (GR_PORT_SET_N_RXQS | GR_PORT_SET_N_TXQS | GR_PORT_SET_Q_SIZE | GR_PORT_SET_MAC)))
+	      & (GR_PORT_SET_N_RXQS | GR_PORT_SET_N_TXQS | GR_PORT_SET_Q_SIZE | GR_PORT_SET_MAC
+		 | GR_PORT_SET_RSS)))
 		return 0;
 
 	if (set_attrs & GR_PORT_SET_N_RXQS) {
@@ -304,6 +340,10 @@ static int iface_port_reconfig(
 		p->txq_size = api->txq_size;
 		needs_configure = true;
 	}
+	if (set_attrs & GR_PORT_SET_RSS) {
+		p->symmetric_rss = api->symmetric_rss;
+		needs_configure = true;
+	}
 
 	if (p->started && (needs_configure || p->needs_reset)) {
 		p->started = false;
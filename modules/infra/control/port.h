@@ -36,6 +36,7 @@ GR_IFACE_INFO(GR_IFACE_TYPE_PORT, iface_info_port, {
 	uint32_t pool_size;
 	bool virtio_offloads;
 	uint64_t rx_offloads;
+	uint64_t tx_offloads;
 	rte_spinlock_t txq_locks[RTE_MAX_QUEUES_PER_PORT];
 	struct {
 		mac_filter_flags_t flags;
@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "log.h"
+#include "metrics.h"
+#include "module.h"
+#include "rcu.h"
+#include "vec.h"
+
+#include <gr_clock.h>
+#include <gr_macro.h>
+
+#include <event2/event.h>
+#include <rte_hash.h>
+#include <rte_rcu_qsbr.h>
+
+#include <stdint.h>
+
+LOG_TYPE("rcu");
+
+// Datapath workers only report a quiescent state every few hundred graph
+// walks. Waiting for them with rte_rcu_qsbr_synchronize() on every deletion
+// stalls the control plane thread for a full grace period each time.
+//
+// Instead, objects that are no longer reachable by the datapath are queued
+// with a grace period token and freed later by a periodic timer, once all
+// workers have moved past that token. Hash tables that have an RCU defer queue
+// of their own are reclaimed from the same timer.
+
+#define DEFER_QUEUE_SIZE (1 << 16)
+#define RECLAIM_INTERVAL_US 10000
+#define RECLAIM_LATENCY_SLOTS 128 // milliseconds
+
+struct rcu_defer_entry {
+	gr_rcu_free_cb_t free_cb;
+	void *obj;
+	clock_t enqueued;
+};
+
+static struct rte_rcu_qsbr_dq *defer_queue;
+static vec struct rcu_defer_entry *reclaimed;
+static vec struct rte_hash **hashes;
+static struct event *reclaim_timer;
+
+static struct {
+	uint64_t pending;
+	uint64_t hash_pending;
+	uint64_t reclaimed;
+	uint64_t latency[RECLAIM_LATENCY_SLOTS];
+} defer_stats;
+
+static void defer_queue_free(void *, void *e, unsigned n) {
+	struct rcu_defer_entry *entries = e;
+	clock_t now = gr_clock_us();
+	uint64_t latency;
+
+	for (unsigned i = 0; i < n; i++) {
+		latency = (now - entries[i].enqueued) / (CLOCKS_PER_SEC / 1000);
+		if (latency >= RECLAIM_LATENCY_SLOTS)
+			latency = RECLAIM_LATENCY_SLOTS - 1;
+		defer_stats.latency[latency]++;
+		// Callbacks may defer more objects. Do not call them while the
+		// queue is being reclaimed.
+		vec_add(reclaimed, entries[i]);
+	}
+}
+
+static void run_reclaimed(void) {
+	struct rcu_defer_entry e;
+
+	while (vec_len(reclaimed) > 0) {
+		vec struct rcu_defer_entry *entries = reclaimed;
+		reclaimed = NULL;
+		vec_foreach (e, entries) {
+			e.free_cb(e.obj);
+			defer_stats.pending--;
+			defer_stats.reclaimed++;
+		}
+		vec_free(entries);
+	}
+}
+
+void gr_rcu_defer(gr_rcu_free_cb_t free_cb, void *obj) {
+	struct rcu_defer_entry e = {
+		.free_cb = free_cb,
+		.obj = obj,
+		.enqueued = gr_clock_us(),
+	};
+
+	if (defer_queue == NULL) {
+		rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
+		free_cb(obj);
+		return;
+	}
+
+	defer_stats.pending++;
+
+	if (rte_rcu_qsbr_dq_enqueue(defer_queue, &e) != 0) {
+		// Nothing could be reclaimed to make room, fall back to waiting.
+		// The object will be freed on the next timer run.
+		LOG(NOTICE, "defer queue full, waiting for datapath workers");
+		rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
+		defer_queue_free(NULL, &e, 1);
+	}
+}
+
+void gr_rcu_defer_flush(void) {
+	if (defer_queue == NULL)
+		return;
+
+	while (defer_stats.pending > 0) {
+		rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
+		rte_rcu_qsbr_dq_reclaim(defer_queue, UINT32_MAX, NULL, NULL, NULL);
+		run_reclaimed();
+	}
+}
+
+int gr_rcu_hash_attach(struct rte_hash *h, rte_hash_free_key_data free_cb, void *priv) {
+	struct rte_hash_rcu_config conf = {
+		.v = gr_datapath_rcu(),
+		.mode = RTE_HASH_QSBR_MODE_DQ,
+		.free_key_data_func = free_cb,
+		.key_data_ptr = priv,
+	};
+
+	if (rte_hash_rcu_qsbr_add(h, &conf) < 0)
+		return errno_set(rte_errno);
+
+	vec_add(hashes, h);
+
+	return 0;
+}
+
+static void hash_free(void *h) {
+	rte_hash_free(h);
+}
+
+static void hash_detach(struct rte_hash *h) {
+	for (unsigned i = 0; i < vec_len(hashes); i++) {
+		if (hashes[i] == h) {
+			vec_del_swap(hashes, i);
+			break;
+		}
+	}
+}
+
+void gr_rcu_hash_free(struct rte_hash *h) {
+	if (h == NULL)
+		return;
+
+	hash_detach(h);
+	// Once the grace period has elapsed, rte_hash_free() can reclaim all
+	// the deleted entries that are still in the hash defer queue.
+	gr_rcu_defer(hash_free, h);
+}
+
+static void do_reclaim(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	unsigned pending, total = 0;
+	struct rte_hash *h;
+
+	if (defer_stats.pending > 0) {
+		rte_rcu_qsbr_dq_reclaim(defer_queue, UINT32_MAX, NULL, NULL, NULL);
+		run_reclaimed();
+	}
+
+	vec_foreach (h, hashes) {
+		pending = 0;
+		rte_hash_rcu_qsbr_dq_reclaim(h, NULL, &pending, NULL);
+		total += pending;
+	}
+	defer_stats.hash_pending = total;
+}
+
+static void rcu_defer_init(struct event_base *ev_base) {
+	struct rte_rcu_qsbr_dq_parameters params = {
+		.name = "rcu_defer",
+		.size = DEFER_QUEUE_SIZE,
+		.esize = sizeof(struct rcu_defer_entry),
+		.trigger_reclaim_limit = DEFER_QUEUE_SIZE / 2,
+		.max_reclaim_size = DEFER_QUEUE_SIZE,
+		.free_fn = defer_queue_free,
+		.v = gr_datapath_rcu(),
+	};
+
+	defer_queue = rte_rcu_qsbr_dq_create(&params);
+	if (defer_queue == NULL)
+		ABORT("rte_rcu_qsbr_dq_create: %s", rte_strerror(rte_errno));
+
+	reclaim_timer = event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, do_reclaim, NULL);
+	if (reclaim_timer == NULL)
+		ABORT("event_new() failed");
+
+	if (event_add(reclaim_timer, &(struct timeval) {.tv_usec = RECLAIM_INTERVAL_US}) < 0)
+		ABORT("event_add() failed");
+}
+
+static void rcu_defer_fini(struct event_base *) {
+	if (reclaim_timer)
+		event_free(reclaim_timer);
+	reclaim_timer = NULL;
+	gr_rcu_defer_flush();
+	rte_rcu_qsbr_dq_delete(defer_queue);
+	defer_queue = NULL;
+	vec_free(reclaimed);
+	vec_free(hashes);
+}
+
+static struct module module = {
+	.name = "rcu_defer",
+	.depends_on = "rcu",
+	.init = rcu_defer_init,
+	.fini = rcu_defer_fini,
+};
+
+METRIC_GAUGE(m_pending, "rcu_defer_pending", "Objects waiting for an RCU grace period.");
+METRIC_COUNTER(m_reclaimed, "rcu_defer_reclaimed", "Objects freed after an RCU grace period.");
+METRIC_HISTOGRAM(
+	m_latency,
+	"rcu_defer_reclaim_latency_milliseconds",
+	"Delay between the release of an object and its reclamation."
+);
+
+static const unsigned reclaim_latency_buckets[] = {0, 1, 2, 5, 10, 20, 50, 100};
+
+static void rcu_metrics_collect(struct metrics_writer *w) {
+	struct metrics_ctx ctx;
+
+	metrics_ctx_init(&ctx, w, "queue", "objects", NULL);
+	metric_emit(&ctx, &m_pending, defer_stats.pending);
+	metrics_ctx_init(&ctx, w, "queue", "hash", NULL);
+	metric_emit(&ctx, &m_pending, defer_stats.hash_pending);
+
+	metrics_ctx_init(&ctx, w, NULL);
+	metric_emit(&ctx, &m_reclaimed, defer_stats.reclaimed);
+	metric_emit_histogram(
+		&ctx,
+		&m_latency,
+		defer_stats.latency,
+		RECLAIM_LATENCY_SLOTS,
+		reclaim_latency_buckets,
+		ARRAY_DIM(reclaim_latency_buckets)
+	);
+}
+
+static struct metrics_collector rcu_collector = {
+	.name = "rcu",
+	.collect = rcu_metrics_collect,
+};
+
+RTE_INIT(init) {
+	module_register(&module);
+	metrics_register(&rcu_collector);
+}
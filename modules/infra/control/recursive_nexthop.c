@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "log.h"
+#include "nexthop.h"
+
+#include <stdint.h>
+
+LOG_TYPE("nexthop");
+
+// Recursive nexthops are shared by all routes that have the same BGP nexthop.
+// FIBs store the recursive nexthop itself and the datapath follows it on each
+// lookup. When the IGP path to the BGP nexthop changes, only the recursive
+// nexthop is updated, regardless of the number of dependent prefixes.
+
+static bool recursive_equal(const struct nexthop *a, const struct nexthop *b) {
+	return nexthop_info_recursive(a)->nh == nexthop_info_recursive(b)->nh;
+}
+
+static void recursive_remove_dependency(struct nexthop *nh, const struct nexthop *deleted) {
+	struct nexthop_info_recursive *r = nexthop_info_recursive(nh);
+
+	if (r->nh == deleted)
+		r->nh = NULL;
+}
+
+static void recursive_free(struct nexthop *nh) {
+	struct nexthop_info_recursive *r = nexthop_info_recursive(nh);
+
+	if (r->nh != NULL)
+		nexthop_decref_dep(r->nh, nh);
+	r->nh = NULL;
+}
+
+static int recursive_import_info(struct nexthop *nh, const void *info) {
+	struct nexthop_info_recursive *r = nexthop_info_recursive(nh);
+	const struct gr_nexthop_info_recursive *pub = info;
+	struct nexthop *old = r->nh;
+	struct nexthop *target = NULL;
+
+	if (pub->nh_id != GR_NH_ID_UNSET) {
+		if ((target = nexthop_lookup_id(pub->nh_id)) == NULL)
+			return errno_set(ENOENT);
+		// Only one level of indirection is followed by the datapath.
+		if (target->type == GR_NH_T_RECURSIVE)
+			return errno_set(ELOOP);
+	}
+
+	if (target == old)
+		return 0;
+
+	if (target != NULL)
+		nexthop_incref_dep(target, nh);
+
+	// Single pointer update, all dependent routes follow it at once.
+	r->nh = target;
+
+	// If this was the last reference, nexthop_destroy() waits for the
+	// datapath to stop using the old target before freeing it.
+	if (old != NULL)
+		nexthop_decref_dep(old, nh);
+
+	LOG(DEBUG,
+	    "recursive nh(%u) resolved to nh(%u)",
+	    nh->nh_id,
+	    target ? target->nh_id : GR_NH_ID_UNSET);
+
+	return 0;
+}
+
+static struct gr_nexthop *recursive_to_api(const struct nexthop *nh, size_t *len) {
+	const struct nexthop_info_recursive *r = nexthop_info_recursive(nh);
+	struct gr_nexthop_info_recursive *pub_info;
+	struct gr_nexthop *pub;
+
+	*len = sizeof(*pub) + sizeof(*pub_info);
+	pub = malloc(*len);
+	if (pub == NULL) {
+		*len = 0;
+		return errno_set_null(ENOMEM);
+	}
+
+	pub->base = nh->base;
+	pub_info = (struct gr_nexthop_info_recursive *)pub->info;
+	pub_info->nh_id = r->nh ? r->nh->nh_id : GR_NH_ID_UNSET;
+
+	return pub;
+}
+
+static struct nexthop_type_ops recursive_nh_ops = {
+	.equal = recursive_equal,
+	.remove_dependency = recursive_remove_dependency,
+	.free = recursive_free,
+	.import_info = recursive_import_info,
+	.to_api = recursive_to_api,
+};
+
+RTE_INIT(init) {
+	nexthop_type_ops_register(GR_NH_T_RECURSIVE, &recursive_nh_ops);
+}
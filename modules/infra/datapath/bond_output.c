@@ -2,17 +2,14 @@
 // Copyright (c) 2025 Robin Jarry
 
 #include "bond.h"
+#include "flow_hash.h"
 #include "graph.h"
 #include "iface.h"
 #include "mbuf.h"
 #include "rxtx.h"
 
 #include <rte_ether.h>
-#include <rte_ip4.h>
-#include <rte_ip6.h>
-#include <rte_tcp.h>
-#include <rte_thash.h>
-#include <rte_udp.h>
+#include <rte_hash_crc.h>
 
 #include <stdint.h>
 
@@ -22,6 +19,18 @@ enum {
 	NB_EDGES,
 };
 
+enum {
+	XSTAT_SW_HASH = 0,
+	XSTAT_COUNT,
+};
+
+static struct rte_node_xstats bond_xstats = {
+	.nb_xstats = XSTAT_COUNT,
+	.xstat_desc = {
+		[XSTAT_SW_HASH] = "sw_flow_hash",
+	},
+};
+
 struct bond_trace_data {
 	uint16_t member_iface_id;
 };
@@ -33,33 +42,11 @@ static int bond_trace_format(char *buf, size_t len, const void *data, size_t /*d
 }
 
 static inline const struct iface *
-hash_tx_member(const struct rte_mbuf *m, const struct iface_info_bond *bond) {
-	static const uint8_t rss_key[] = {
-		0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
-		0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
-		0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
-	};
-	union {
-		uint32_t u32;
-		struct {
-			struct rte_ether_addr mac;
-			rte_be16_t vlan_id;
-		} l2;
-		struct rte_ipv4_tuple v4;
-		struct rte_ipv6_tuple v6;
-	} tuple;
-	union {
-		const struct rte_ipv4_hdr *ip4;
-		const struct rte_ipv6_hdr *ip6;
-	} l3;
-	union {
-		const struct rte_udp_hdr *udp;
-		const struct rte_tcp_hdr *tcp;
-	} l4;
+hash_tx_member(struct rte_mbuf *m, const struct iface_info_bond *bond, uint16_t *sw_hash) {
 	const struct rte_ether_hdr *eth;
 	const struct rte_vlan_hdr *vlan;
-	uint32_t l3_offset, len, hash;
-	rte_be16_t eth_type;
+	rte_be16_t vlan_tci;
+	uint32_t hash;
 	uint8_t member;
 
 	if (bond->n_members == 0)
@@ -67,115 +54,31 @@ hash_tx_member(const struct rte_mbuf *m, const struct iface_info_bond *bond) {
 
 	switch (bond->algo) {
 	case GR_BOND_ALGO_L2:
-		eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-		tuple.l2.mac = eth->dst_addr;
+		eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
 		if (eth->ether_type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
 			vlan = PAYLOAD(eth);
-			tuple.l2.vlan_id = vlan->vlan_tci;
+			vlan_tci = vlan->vlan_tci;
 		} else {
-			tuple.l2.vlan_id = 0;
+			vlan_tci = 0;
 		}
-		len = sizeof(tuple.l2);
+		hash = rte_hash_crc(&eth->dst_addr, sizeof(eth->dst_addr), 0);
+		hash = rte_hash_crc_2byte(vlan_tci, hash);
 		break;
 	case GR_BOND_ALGO_RSS:
-		if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH) {
-			hash = m->hash.rss;
-			goto out;
-		}
-		// fallthrough
+		// Fall back to a software hash of the L2/L3/L4 headers.
+		if (gr_mbuf_flow_hash_eth(m))
+			(*sw_hash)++;
+		hash = m->hash.rss;
+		break;
 	case GR_BOND_ALGO_L3_L4:
-		eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-		tuple.l2.mac = eth->dst_addr;
-		if (eth->ether_type == RTE_BE16(RTE_ETHER_TYPE_VLAN)) {
-			vlan = PAYLOAD(eth);
-			tuple.l2.vlan_id = vlan->vlan_tci;
-			eth_type = vlan->eth_proto;
-			l3_offset = sizeof(*eth) + sizeof(*vlan);
-		} else {
-			tuple.l2.vlan_id = 0;
-			eth_type = eth->ether_type;
-			l3_offset = sizeof(*eth);
-		}
-		switch (eth_type) {
-		case RTE_BE16(RTE_ETHER_TYPE_IPV4): {
-			l3.ip4 = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *, l3_offset);
-			tuple.v4.src_addr = l3.ip4->src_addr;
-			tuple.v4.dst_addr = l3.ip4->dst_addr;
-			switch (l3.ip4->next_proto_id) {
-			case IPPROTO_UDP:
-				if (l3.ip4->fragment_offset == 0) {
-					l4.udp = rte_pktmbuf_mtod_offset(
-						m,
-						struct rte_udp_hdr *,
-						l3_offset + rte_ipv4_hdr_len(l3.ip4)
-					);
-					tuple.v4.sport = l4.udp->src_port;
-					tuple.v4.dport = l4.udp->dst_port;
-				} else {
-					// ignore UDP header for IP fragments
-					tuple.v4.sport = 0;
-					tuple.v4.dport = 0;
-				}
-				break;
-			case IPPROTO_TCP:
-				if (l3.ip4->fragment_offset == 0) {
-					l4.tcp = rte_pktmbuf_mtod_offset(
-						m,
-						struct rte_tcp_hdr *,
-						l3_offset + rte_ipv4_hdr_len(l3.ip4)
-					);
-					tuple.v4.sport = l4.tcp->src_port;
-					tuple.v4.dport = l4.tcp->dst_port;
-				} else {
-					// ignore TCP header for IP fragments
-					tuple.v4.sport = 0;
-					tuple.v4.dport = 0;
-				}
-				break;
-			default:
-				tuple.v4.sport = 0;
-				tuple.v4.dport = 0;
-			}
-			len = sizeof(tuple.v4);
-			break;
-		}
-		case RTE_BE16(RTE_ETHER_TYPE_IPV6): {
-			l3.ip6 = rte_pktmbuf_mtod_offset(m, const struct rte_ipv6_hdr *, l3_offset);
-			tuple.v6.src_addr = l3.ip6->src_addr;
-			tuple.v6.dst_addr = l3.ip6->dst_addr;
-			switch (l3.ip6->proto) {
-			case IPPROTO_UDP:
-				l4.udp = rte_pktmbuf_mtod_offset(
-					m, struct rte_udp_hdr *, l3_offset + sizeof(*l3.ip6)
-				);
-				tuple.v6.sport = l4.udp->src_port;
-				tuple.v6.dport = l4.udp->dst_port;
-				break;
-			case IPPROTO_TCP:
-				l4.tcp = rte_pktmbuf_mtod_offset(
-					m, struct rte_tcp_hdr *, l3_offset + sizeof(*l3.ip6)
-				);
-				tuple.v6.sport = l4.tcp->src_port;
-				tuple.v6.dport = l4.tcp->dst_port;
-				break;
-			default:
-				tuple.v6.sport = 0;
-				tuple.v6.dport = 0;
-			}
-			len = sizeof(tuple.v6);
-			break;
-		}
-		default:
-			len = sizeof(tuple.l2);
-			break;
-		}
+		// Ethernet addresses are left out so that all flows to the same
+		// gateway are not sent over the same member.
+		hash = gr_flow_hash_eth_l3(m, 0);
 		break;
 	default:
 		return NULL;
 	}
 
-	hash = rte_softrss_be(&tuple.u32, len / sizeof(uint32_t), rss_key);
-out:
 	member = bond->redirection_table[hash % ARRAY_DIM(bond->redirection_table)];
 	if (member < bond->n_members)
 		return bond->members[member].iface;
@@ -183,7 +86,7 @@ out:
 }
 
 static inline const struct iface *
-bond_select_tx_member(const struct rte_mbuf *m, const struct iface_info_bond *bond) {
+bond_select_tx_member(struct rte_mbuf *m, const struct iface_info_bond *bond, uint16_t *sw_hash) {
 	switch (bond->mode) {
 	case GR_BOND_MODE_ACTIVE_BACKUP: {
 		uint8_t active = bond->active_member;
@@ -191,7 +94,7 @@ bond_select_tx_member(const struct rte_mbuf *m, const struct iface_info_bond *bo
 			return bond->members[active].iface;
 		break;
 	case GR_BOND_MODE_LACP:
-		return hash_tx_member(m, bond);
+		return hash_tx_member(m, bond, sw_hash);
 	}
 	}
 
@@ -202,6 +105,7 @@ static uint16_t
 bond_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	const struct iface_info_bond *bond;
 	const struct iface *member;
+	uint16_t sw_hash = 0;
 	rte_edge_t edge;
 
 	IFACE_STATS_VARS(tx);
@@ -211,7 +115,7 @@ bond_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 		bond = iface_info_bond(mbuf_data(mbuf)->iface);
 
 		// Select output member port
-		member = bond_select_tx_member(mbuf, bond);
+		member = bond_select_tx_member(mbuf, bond, &sw_hash);
 		if (member == NULL) {
 			edge = NO_MEMBER;
 			goto next;
@@ -233,6 +137,9 @@ next:
 
 	IFACE_STATS_FLUSH(tx);
 
+	if (sw_hash > 0)
+		rte_node_xstat_increment(node, XSTAT_SW_HASH, sw_hash);
+
 	return nb_objs;
 }
 
@@ -240,6 +147,7 @@ static struct rte_node_register bond_output_node = {
 	.name = "bond_output",
 	.process = bond_output_process,
 	.nb_edges = NB_EDGES,
+	.xstats = &bond_xstats,
 	.next_nodes = {
 		"port_output",
 		"bond_no_member",
@@ -8,6 +8,8 @@
 #include <rte_byteorder.h>
 #include <rte_ether.h>
 
+#include <stdbool.h>
+
 typedef enum {
 	ETH_DOMAIN_UNKNOWN = 0,
 	ETH_DOMAIN_LOOPBACK, // packet comes from a local loopback interface
@@ -26,6 +28,13 @@ GR_MBUF_PRIV_DATA_TYPE(eth_output_mbuf_data, {
 
 void gr_eth_input_add_type(rte_be16_t eth_type, const char *node_name);
 
+// Register an alternate next node for an ether type. When the graph fastpath
+// is enabled, eth_input sends packets to that node instead of the one
+// registered with gr_eth_input_add_type. The fastpath node must hand anything
+// it does not handle to the regular node with eth_input_mbuf_data untouched.
+void gr_eth_input_add_fastpath(rte_be16_t eth_type, const char *node_name);
+void eth_input_fastpath_enable(bool enable);
+
 int eth_trace_format(char *buf, size_t len, const void *data, size_t /*data_len*/);
 
 #define GR_IPPROTO_EIGRP 88
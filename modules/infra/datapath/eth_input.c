@@ -7,6 +7,7 @@
 #include "rxtx.h"
 #include "snap.h"
 #include "trace.h"
+#include "vec.h"
 
 #include <rte_byteorder.h>
 #include <rte_ether.h>
@@ -31,10 +32,50 @@ void gr_eth_input_add_type(rte_be16_t eth_type, const char *next_node) {
 	l2l3_edges[eth_type] = gr_node_attach_parent("eth_input", next_node);
 }
 
+struct eth_fastpath {
+	rte_be16_t eth_type;
+	rte_edge_t regular;
+	rte_edge_t fast;
+};
+
+static vec struct eth_fastpath *fastpaths;
+static bool fastpath_enabled;
+
+void gr_eth_input_add_fastpath(rte_be16_t eth_type, const char *next_node) {
+	struct eth_fastpath fp = {.eth_type = eth_type};
+
+	LOG(DEBUG, "eth_input: type=0x%04x fastpath -> %s", rte_be_to_cpu_16(eth_type), next_node);
+	vec_foreach_ref (struct eth_fastpath *f, fastpaths) {
+		if (f->eth_type == eth_type)
+			ABORT("fastpath node already registered for ether type=0x%04x",
+			      rte_be_to_cpu_16(eth_type));
+	}
+	fp.fast = gr_node_attach_parent("eth_input", next_node);
+	vec_add(fastpaths, fp);
+}
+
+void eth_input_fastpath_enable(bool enable) {
+	if (enable == fastpath_enabled)
+		return;
+
+	// Both edges exist in all graphs. Workers pick the new edge on their
+	// next burst, no graph reload is required.
+	vec_foreach_ref (struct eth_fastpath *f, fastpaths) {
+		if (enable) {
+			f->regular = l2l3_edges[f->eth_type];
+			l2l3_edges[f->eth_type] = f->fast;
+		} else {
+			l2l3_edges[f->eth_type] = f->regular;
+		}
+	}
+	fastpath_enabled = enable;
+}
+
 static uint16_t
 eth_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct rte_ether_addr iface_mac;
 	struct eth_input_mbuf_data *d;
+	struct gr_node_batch batch;
 	struct rte_ether_hdr *eth;
 	uint16_t last_iface_id;
 	struct rte_mbuf *m;
@@ -42,6 +83,7 @@ eth_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 
 	last_iface_id = GR_IFACE_ID_UNDEF;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		m = objs[i];
 
@@ -77,9 +119,11 @@ eth_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 			edge = l2l3_edges[eth->ether_type];
 		}
 next:
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
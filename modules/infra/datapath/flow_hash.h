@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#pragma once
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_hash_crc.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Software flow hashing for packets that were not hashed by the NIC.
+//
+// Hashes are computed with the CRC32 instructions of the CPU (SSE4.2 on x86,
+// CRC extension on ARMv8). They are cached in mbuf->hash.rss along with the
+// RTE_MBUF_F_RX_RSS_HASH flag so that subsequent nodes do not recompute them.
+
+// Hash the IPv4/IPv6 addresses and the L4 ports of the L3 header located at
+// offset off. Other protocols leave the seed unchanged.
+static inline uint32_t
+gr_flow_hash_l3(const struct rte_mbuf *m, rte_be16_t eth_type, uint32_t off, uint32_t hash) {
+	uint32_t len = rte_pktmbuf_data_len(m);
+	const unaligned_uint32_t *ports;
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_ipv4_hdr *ip;
+	uint32_t l4_off;
+	uint8_t proto;
+
+	switch (eth_type) {
+	case RTE_BE16(RTE_ETHER_TYPE_IPV4):
+		if (len < off + sizeof(*ip))
+			return hash;
+		ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, off);
+		// Source and destination addresses are contiguous.
+		hash = rte_hash_crc_8byte(*(const unaligned_uint64_t *)&ip->src_addr, hash);
+		// Only the first fragment has the L4 header.
+		if (ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK))
+			return hash;
+		proto = ip->next_proto_id;
+		l4_off = off + rte_ipv4_hdr_len(ip);
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_IPV6):
+		if (len < off + sizeof(*ip6))
+			return hash;
+		ip6 = rte_pktmbuf_mtod_offset(m, const struct rte_ipv6_hdr *, off);
+		hash = rte_hash_crc(&ip6->src_addr, 2 * sizeof(ip6->src_addr), hash);
+		proto = ip6->proto;
+		l4_off = off + sizeof(*ip6);
+		break;
+	default:
+		return hash;
+	}
+
+	switch (proto) {
+	case IPPROTO_TCP:
+	case IPPROTO_UDP:
+	case IPPROTO_SCTP:
+		// Source and destination ports are the first 4 bytes of the L4 header.
+		if (len >= l4_off + sizeof(*ports)) {
+			ports = rte_pktmbuf_mtod_offset(m, const unaligned_uint32_t *, l4_off);
+			hash = rte_hash_crc_4byte(*ports, hash);
+		}
+		break;
+	}
+
+	return hash;
+}
+
+// Hash the L3 addresses and L4 ports of an Ethernet frame, ignoring the
+// Ethernet addresses. A single VLAN tag is skipped.
+static inline uint32_t gr_flow_hash_eth_l3(const struct rte_mbuf *m, uint32_t hash) {
+	uint32_t len = rte_pktmbuf_data_len(m);
+	const struct rte_ether_hdr *eth;
+	const struct rte_vlan_hdr *vlan;
+	rte_be16_t eth_type;
+	uint32_t off;
+
+	if (len < sizeof(*eth))
+		return hash;
+
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	eth_type = eth->ether_type;
+	off = sizeof(*eth);
+	if (eth_type == RTE_BE16(RTE_ETHER_TYPE_VLAN) && len >= off + sizeof(*vlan)) {
+		vlan = rte_pktmbuf_mtod_offset(m, const struct rte_vlan_hdr *, off);
+		eth_type = vlan->eth_proto;
+		off += sizeof(*vlan);
+	}
+
+	return gr_flow_hash_l3(m, eth_type, off, hash);
+}
+
+// Hash the Ethernet addresses, L3 addresses and L4 ports of an Ethernet frame.
+// A single VLAN tag is skipped.
+static inline uint32_t gr_flow_hash_eth(const struct rte_mbuf *m) {
+	const struct rte_ether_hdr *eth;
+	uint32_t hash;
+
+	if (rte_pktmbuf_data_len(m) < sizeof(*eth))
+		return 0;
+
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	// Destination and source addresses are contiguous.
+	hash = rte_hash_crc(eth, 2 * sizeof(eth->dst_addr), 0);
+
+	return gr_flow_hash_eth_l3(m, hash);
+}
+
+static inline void gr_mbuf_set_flow_hash(struct rte_mbuf *m, uint32_t hash) {
+	m->hash.rss = hash;
+	m->ol_flags |= RTE_MBUF_F_RX_RSS_HASH;
+}
+
+// Make sure m->hash.rss holds a flow hash for an L3 packet starting at the
+// current data offset. Returns true if it had to be computed in software.
+static inline bool gr_mbuf_flow_hash_l3(struct rte_mbuf *m, rte_be16_t eth_type) {
+	if (likely(m->ol_flags & RTE_MBUF_F_RX_RSS_HASH))
+		return false;
+	gr_mbuf_set_flow_hash(m, gr_flow_hash_l3(m, eth_type, 0, 0));
+	return true;
+}
+
+// Make sure m->hash.rss holds a flow hash for an Ethernet frame starting at the
+// current data offset. Returns true if it had to be computed in software.
+static inline bool gr_mbuf_flow_hash_eth(struct rte_mbuf *m) {
+	if (likely(m->ol_flags & RTE_MBUF_F_RX_RSS_HASH))
+		return false;
+	gr_mbuf_set_flow_hash(m, gr_flow_hash_eth(m));
+	return true;
+}
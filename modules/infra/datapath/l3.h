@@ -3,7 +3,134 @@
 
 #pragma once
 
+#include "iface.h"
 #include "mbuf.h"
 #include "nexthop.h"
 
+#include <gr_net_types.h>
+
+#include <rte_graph.h>
+#include <rte_ip6.h>
+
+#include <stdint.h>
+#include <string.h>
+
 GR_MBUF_PRIV_DATA_TYPE(l3_mbuf_data, { const struct nexthop *nh; });
+
+// Fast reroute. The GR_IFACE_S_RUNNING state bit is cleared by the control
+// plane as soon as a link down event is received. Until routing protocols
+// reconverge, packets are redirected to pre-installed backup nexthops.
+
+// Return the backup of an L3 nexthop if its output interface is down.
+// Return NULL if the interface is up or if the nexthop has no backup.
+static inline const struct nexthop *
+nh_fast_reroute(const struct nexthop *nh, const struct iface *iface) {
+	if (likely(iface == NULL || iface->state & GR_IFACE_S_RUNNING))
+		return NULL;
+	if (nh->type != GR_NH_T_L3)
+		return NULL;
+	return nexthop_info_l3(nh)->backup;
+}
+
+// Check if a group member selected by a load balancing node can forward
+// packets, either through its output interface or through its own backup.
+static inline bool nh_group_member_usable(const struct nexthop *nh) {
+	const struct iface *iface;
+
+	if (nh == NULL)
+		return false;
+	if (nh->type != GR_NH_T_L3 || nexthop_info_l3(nh)->backup != NULL)
+		return true;
+	iface = iface_from_id(nh->iface_id);
+	return iface == NULL || iface->state & GR_IFACE_S_RUNNING;
+}
+
+// Lookup n destination addresses in the same FIB scope at once.
+typedef void (*fib_lookup_bulk_t)(
+	uint16_t vrf_id,
+	uint16_t scope_id,
+	const void *dsts,
+	const struct nexthop **nhs,
+	unsigned n
+);
+
+static inline bool
+fib_same_scope(const uint16_t *vrf_ids, const uint16_t *scope_ids, uint16_t i, uint16_t j) {
+	return vrf_ids[i] == vrf_ids[j] && (scope_ids == NULL || scope_ids[i] == scope_ids[j]);
+}
+
+// Resolve a burst of destination addresses which may belong to different VRFs.
+//
+// Destinations are grouped by VRF and scope so that each FIB is queried with
+// a single lookup() call per group. In the common case, all addresses belong
+// to the same group and the whole burst is resolved at once. scope_ids may be
+// NULL if the address family has no scoped addresses. Each destination is
+// dst_len bytes long, at most the size of an IPv6 address. At most
+// RTE_GRAPH_BURST_SIZE addresses are supported.
+static inline void fib_lookup_burst(
+	uint16_t n,
+	const uint16_t *vrf_ids,
+	const uint16_t *scope_ids,
+	const void *dsts,
+	size_t dst_len,
+	const struct nexthop **nhs,
+	fib_lookup_bulk_t lookup
+) {
+	struct rte_ipv6_addr batch_dsts[RTE_GRAPH_BURST_SIZE];
+	const struct nexthop *batch_nhs[RTE_GRAPH_BURST_SIZE];
+	uint16_t batch_idx[RTE_GRAPH_BURST_SIZE];
+	uint16_t todo[RTE_GRAPH_BURST_SIZE];
+	uint16_t i, j, ref, n_todo, n_batch, n_next;
+
+	for (i = 1; i < n && fib_same_scope(vrf_ids, scope_ids, i, 0); i++)
+		;
+	if (likely(i == n)) {
+		lookup(vrf_ids[0], scope_ids ? scope_ids[0] : 0, dsts, nhs, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		todo[i] = i;
+	n_todo = n;
+
+	while (n_todo > 0) {
+		ref = todo[0];
+		n_batch = 0;
+		n_next = 0;
+		for (i = 0; i < n_todo; i++) {
+			j = todo[i];
+			if (fib_same_scope(vrf_ids, scope_ids, j, ref)) {
+				batch_idx[n_batch] = j;
+				memcpy((uint8_t *)batch_dsts + n_batch * dst_len,
+				       (const uint8_t *)dsts + j * dst_len,
+				       dst_len);
+				n_batch++;
+			} else {
+				todo[n_next++] = j;
+			}
+		}
+		lookup(vrf_ids[ref], scope_ids ? scope_ids[ref] : 0, batch_dsts, batch_nhs, n_batch);
+		for (i = 0; i < n_batch; i++)
+			nhs[batch_idx[i]] = batch_nhs[i];
+		n_todo = n_next;
+	}
+}
+
+typedef enum {
+	NH_HOLD_QUEUED, // packet is held in the datapath until the nexthop is resolved
+	NH_HOLD_PUNT, // packet must be sent to the control plane to trigger resolution
+	NH_HOLD_DROP, // hold queue is full
+} nh_hold_verdict_t;
+
+// Hold a packet waiting for resolution of an L3 nexthop in a per-lcore queue.
+// The packet is owned by the hold queue only when NH_HOLD_QUEUED is returned.
+nh_hold_verdict_t nh_hold_enqueue(const struct nexthop *, addr_family_t, struct rte_mbuf *);
+
+// Register the node where held packets of an address family are sent when
+// their nexthop is resolved.
+void nh_hold_register_output(addr_family_t af, const char *next_node);
+
+// Drop the packets held for a nexthop on all lcores. Must be called when the
+// nexthop is destroyed, and again after the RCU grace period, before its
+// memory is reused.
+void nh_hold_invalidate(const struct nexthop *);
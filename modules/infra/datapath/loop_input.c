@@ -37,9 +37,11 @@ static uint16_t loopback_input_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
+	struct gr_node_batch batch;
 	struct rte_mbuf *mbuf;
 	rte_edge_t edge;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
@@ -59,9 +61,11 @@ static uint16_t loopback_input_process(
 			edge = UNKNOWN_PROTO;
 			break;
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
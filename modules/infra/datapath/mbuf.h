@@ -84,6 +84,80 @@ static inline struct rte_mbuf *gr_mbuf_copy(struct rte_mbuf *m, size_t data_len)
 #undef rte_pktmbuf_copy
 #define rte_pktmbuf_copy GR_SYMBOL_FORBIDDEN(rte_pktmbuf_copy, gr_mbuf_copy)
 
+// Shallow copy of an mbuf: only the first hdr_len bytes are duplicated into a
+// new direct mbuf which has the full headroom available for encapsulation. The
+// rest of the data is chained as indirect mbufs referencing the original data
+// which must not be modified until all copies have been freed.
+// Also copies mbuf priv data and traces.
+static inline struct rte_mbuf *gr_mbuf_share(struct rte_mbuf *m, uint16_t hdr_len) {
+	struct rte_mbuf *hdr, *payload;
+
+	// Not worth sharing.
+	if (hdr_len >= rte_pktmbuf_data_len(m))
+		return gr_mbuf_copy(m, UINT32_MAX);
+
+	hdr = rte_pktmbuf_alloc(m->pool);
+	if (hdr == NULL)
+		return NULL;
+
+	payload = rte_pktmbuf_clone(m, m->pool);
+	if (payload == NULL) {
+		rte_pktmbuf_free(hdr);
+		return NULL;
+	}
+	rte_pktmbuf_adj(payload, hdr_len);
+
+	memcpy(rte_pktmbuf_append(hdr, hdr_len), rte_pktmbuf_mtod(m, void *), hdr_len);
+	hdr->port = m->port;
+	// The header is a direct mbuf, even if the original was not.
+	hdr->ol_flags = m->ol_flags & ~(RTE_MBUF_F_INDIRECT | RTE_MBUF_F_EXTERNAL);
+	hdr->packet_type = m->packet_type;
+	hdr->vlan_tci = m->vlan_tci;
+	hdr->hash = m->hash;
+	hdr->tx_offload = m->tx_offload;
+
+	if (rte_pktmbuf_chain(hdr, payload) < 0) {
+		rte_pktmbuf_free(payload);
+		rte_pktmbuf_free(hdr);
+		return NULL;
+	}
+
+	memcpy(mbuf_data(hdr), mbuf_data(m), GR_MBUF_PRIV_MAX_SIZE);
+	if (gr_mbuf_is_traced(m))
+		gr_mbuf_trace_copy(hdr, m);
+
+	return hdr;
+}
+
+// Make the data of a chained mbuf contiguous. When the first segment cannot
+// be extended (not enough tailroom or its buffer is shared with other mbufs),
+// the packet is copied into a new mbuf, the original is freed and its traces
+// are moved to the copy. Returns NULL if the packet does not fit in a single
+// mbuf, the original is left untouched.
+static inline struct rte_mbuf *gr_mbuf_linearize(struct rte_mbuf *m) {
+	struct gr_trace_head traces;
+	struct rte_mbuf *copy;
+
+	if (RTE_MBUF_DIRECT(m) && rte_mbuf_refcnt_read(m) == 1 && rte_pktmbuf_linearize(m) == 0)
+		return m;
+
+	STAILQ_INIT(&traces);
+	STAILQ_CONCAT(&traces, gr_mbuf_traces(m));
+
+	copy = gr_mbuf_copy(m, UINT32_MAX);
+	if (copy == NULL || copy->nb_segs > 1) {
+		rte_pktmbuf_free(copy);
+		STAILQ_CONCAT(gr_mbuf_traces(m), &traces);
+		return NULL;
+	}
+
+	STAILQ_INIT(gr_mbuf_traces(copy));
+	STAILQ_CONCAT(gr_mbuf_traces(copy), &traces);
+	rte_pktmbuf_free(m);
+
+	return copy;
+}
+
 // Prepend data when possible, and when not, move the entire data forward
 // Slow, but this doesn't require to manage indirect mbufs.
 static inline void *__gr_mbuf_prepend(struct rte_mbuf *m, uint16_t len) {
@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "_cmocka.h"
+#include "mbuf.h"
+
+#include <gr_macro.h>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+#define N_MBUFS 16
+#define DATA_LEN 384
+#define DATA_ROOM (RTE_PKTMBUF_HEADROOM + DATA_LEN)
+#define ELT_SIZE (sizeof(struct rte_mbuf) + GR_MBUF_PRIV_MAX_SIZE + DATA_ROOM)
+// Each object is preceded by its mempool header, rte_pktmbuf_detach() reads it.
+#define ELT_STRIDE RTE_ALIGN_CEIL(RTE_CACHE_LINE_SIZE + ELT_SIZE, RTE_CACHE_LINE_SIZE)
+
+void gr_mbuf_trace_copy(struct rte_mbuf *, struct rte_mbuf *) {
+	fail_msg("traces must be moved, not copied");
+}
+
+// Fake mbuf pool that does not require EAL.
+static struct {
+	struct rte_mempool mp;
+	struct rte_pktmbuf_pool_private priv; // must follow mp
+} pool;
+static alignas(RTE_CACHE_LINE_SIZE) uint8_t pool_mem[N_MBUFS * ELT_STRIDE];
+static void *free_objs[N_MBUFS];
+static unsigned n_free;
+
+static int pool_alloc(struct rte_mempool *) {
+	return 0;
+}
+
+static void pool_free(struct rte_mempool *) { }
+
+static int pool_enqueue(struct rte_mempool *, void *const *objs, unsigned n) {
+	assert_true(n_free + n <= N_MBUFS);
+	for (unsigned i = 0; i < n; i++)
+		free_objs[n_free++] = objs[i];
+	return 0;
+}
+
+static int pool_dequeue(struct rte_mempool *, void **objs, unsigned n) {
+	if (n > n_free)
+		return -ENOBUFS;
+	for (unsigned i = 0; i < n; i++)
+		objs[i] = free_objs[--n_free];
+	return 0;
+}
+
+static unsigned pool_get_count(const struct rte_mempool *) {
+	return n_free;
+}
+
+static const struct rte_mempool_ops pool_ops = {
+	.name = "gr_mbuf_test",
+	.alloc = pool_alloc,
+	.free = pool_free,
+	.enqueue = pool_enqueue,
+	.dequeue = pool_dequeue,
+	.get_count = pool_get_count,
+};
+
+static int group_setup(void **) {
+	int ops_index = rte_mempool_register_ops(&pool_ops);
+	assert_true(ops_index >= 0);
+
+	pool.mp.ops_index = ops_index;
+	pool.mp.cache_size = 0;
+	pool.mp.size = N_MBUFS;
+	pool.mp.elt_size = ELT_SIZE;
+	pool.priv.mbuf_data_room_size = DATA_ROOM;
+	pool.priv.mbuf_priv_size = GR_MBUF_PRIV_MAX_SIZE;
+
+	for (unsigned i = 0; i < N_MBUFS; i++) {
+		void *obj = &pool_mem[i * ELT_STRIDE + RTE_CACHE_LINE_SIZE];
+		struct rte_mempool_objhdr *hdr = RTE_PTR_SUB(obj, sizeof(*hdr));
+		hdr->mp = &pool.mp;
+		rte_pktmbuf_init(&pool.mp, NULL, obj, i);
+		free_objs[n_free++] = obj;
+	}
+
+	return 0;
+}
+
+static int teardown(void **) {
+	// All mbufs, including the indirect ones, must have been freed.
+	assert_int_equal(n_free, N_MBUFS);
+	return 0;
+}
+
+static struct rte_mbuf *pkt_alloc(uint16_t len, uint8_t seed) {
+	struct rte_mbuf *m = rte_pktmbuf_alloc(&pool.mp);
+	uint8_t *data;
+
+	assert_non_null(m);
+	memset(mbuf_data(m), 0, GR_MBUF_PRIV_MAX_SIZE);
+	data = (uint8_t *)rte_pktmbuf_append(m, len);
+	assert_non_null(data);
+	for (uint16_t i = 0; i < len; i++)
+		data[i] = seed + i;
+
+	return m;
+}
+
+static struct rte_mbuf *pkt_clone(struct rte_mbuf *m) {
+	struct rte_mbuf *c = rte_pktmbuf_clone(m, &pool.mp);
+
+	assert_non_null(c);
+	memset(mbuf_data(c), 0, GR_MBUF_PRIV_MAX_SIZE);
+
+	return c;
+}
+
+static void assert_pkt(struct rte_mbuf *m, uint16_t len, uint8_t seed) {
+	uint8_t buf[3 * DATA_LEN];
+	const uint8_t *data;
+
+	assert_int_equal(rte_pktmbuf_pkt_len(m), len);
+	data = rte_pktmbuf_read(m, 0, len, buf);
+	assert_non_null(data);
+	for (uint16_t i = 0; i < len; i++)
+		assert_int_equal(data[i], (uint8_t)(seed + i));
+}
+
+static void share_small(void **) {
+	struct rte_mbuf *m = pkt_alloc(64, 1);
+	struct rte_mbuf *s = gr_mbuf_share(m, 128);
+
+	// Not worth sharing, the packet is copied.
+	assert_non_null(s);
+	assert_int_equal(s->nb_segs, 1);
+	assert_true(RTE_MBUF_DIRECT(s));
+	assert_ptr_not_equal(rte_pktmbuf_mtod(s, void *), rte_pktmbuf_mtod(m, void *));
+	assert_int_equal(rte_mbuf_refcnt_read(m), 1);
+	assert_pkt(s, 64, 1);
+
+	rte_pktmbuf_free(s);
+	rte_pktmbuf_free(m);
+}
+
+static void share_split(void **) {
+	struct rte_mbuf *m = pkt_alloc(300, 2);
+	struct rte_mbuf *s = gr_mbuf_share(m, 128);
+
+	assert_non_null(s);
+	assert_int_equal(s->nb_segs, 2);
+	assert_int_equal(rte_pktmbuf_data_len(s), 128);
+	assert_int_equal(rte_pktmbuf_headroom(s), RTE_PKTMBUF_HEADROOM);
+	assert_true(RTE_MBUF_DIRECT(s));
+	assert_true(RTE_MBUF_CLONED(s->next));
+	// The payload references the original buffer.
+	assert_ptr_equal(rte_pktmbuf_mtod(s->next, uint8_t *), rte_pktmbuf_mtod(m, uint8_t *) + 128);
+	assert_int_equal(rte_mbuf_refcnt_read(m), 2);
+	assert_pkt(s, 300, 2);
+
+	rte_pktmbuf_free(s);
+	assert_int_equal(rte_mbuf_refcnt_read(m), 1);
+	assert_pkt(m, 300, 2);
+	rte_pktmbuf_free(m);
+}
+
+static void share_indirect(void **) {
+	struct rte_mbuf *m = pkt_alloc(300, 3);
+	struct rte_mbuf *c = pkt_clone(m);
+	struct rte_mbuf *s;
+
+	assert_true(c->ol_flags & RTE_MBUF_F_INDIRECT);
+	c->ol_flags |= RTE_MBUF_F_TX_IPV4;
+
+	s = gr_mbuf_share(c, 128);
+	assert_non_null(s);
+	// The header is a direct mbuf, other offload flags are preserved.
+	assert_true(RTE_MBUF_DIRECT(s));
+	assert_false(s->ol_flags & (RTE_MBUF_F_INDIRECT | RTE_MBUF_F_EXTERNAL));
+	assert_true(s->ol_flags & RTE_MBUF_F_TX_IPV4);
+	assert_pkt(s, 300, 3);
+
+	rte_pktmbuf_free(s);
+	rte_pktmbuf_free(c);
+	rte_pktmbuf_free(m);
+}
+
+static void linearize_in_place(void **) {
+	struct rte_mbuf *m = pkt_alloc(100, 4);
+	struct rte_mbuf *n = pkt_alloc(100, 4 + 100);
+
+	assert_int_equal(rte_pktmbuf_chain(m, n), 0);
+
+	assert_ptr_equal(gr_mbuf_linearize(m), m);
+	assert_int_equal(m->nb_segs, 1);
+	assert_pkt(m, 200, 4);
+
+	rte_pktmbuf_free(m);
+}
+
+static void linearize_shared(void **) {
+	struct rte_mbuf *m = pkt_alloc(300, 5);
+	struct rte_mbuf *s = gr_mbuf_share(m, 128);
+	struct gr_trace_item trace = {0};
+	struct rte_mbuf *l;
+
+	STAILQ_INIT(gr_mbuf_traces(s));
+	STAILQ_INSERT_HEAD(gr_mbuf_traces(s), &trace, next);
+
+	// The header has enough tailroom for the payload.
+	l = gr_mbuf_linearize(s);
+	assert_ptr_equal(l, s);
+	assert_int_equal(l->nb_segs, 1);
+	assert_pkt(l, 300, 5);
+	assert_ptr_equal(STAILQ_FIRST(gr_mbuf_traces(l)), &trace);
+	// The original packet data was not modified.
+	assert_int_equal(rte_mbuf_refcnt_read(m), 1);
+	assert_pkt(m, 300, 5);
+
+	rte_pktmbuf_free(l);
+	rte_pktmbuf_free(m);
+}
+
+static void linearize_indirect(void **) {
+	struct rte_mbuf *m = pkt_alloc(100, 6);
+	struct rte_mbuf *c = pkt_clone(m);
+	struct rte_mbuf *n = pkt_alloc(100, 6 + 100);
+	struct gr_trace_item trace = {0};
+	struct rte_mbuf *l;
+
+	assert_int_equal(rte_pktmbuf_chain(c, n), 0);
+	STAILQ_INIT(gr_mbuf_traces(c));
+	STAILQ_INSERT_HEAD(gr_mbuf_traces(c), &trace, next);
+
+	// The first segment buffer is shared, it must not be written to.
+	l = gr_mbuf_linearize(c);
+	assert_non_null(l);
+	assert_ptr_not_equal(l, c);
+	assert_true(RTE_MBUF_DIRECT(l));
+	assert_int_equal(l->nb_segs, 1);
+	assert_pkt(l, 200, 6);
+	assert_ptr_equal(STAILQ_FIRST(gr_mbuf_traces(l)), &trace);
+
+	assert_int_equal(rte_mbuf_refcnt_read(m), 1);
+	assert_int_equal(rte_pktmbuf_data_len(m), 100);
+
+	rte_pktmbuf_free(l);
+	rte_pktmbuf_free(m);
+}
+
+static void linearize_too_large(void **) {
+	struct rte_mbuf *m = pkt_alloc(DATA_LEN, 7);
+	struct rte_mbuf *n = pkt_alloc(DATA_LEN, (uint8_t)(7 + DATA_LEN));
+	struct gr_trace_item trace = {0};
+
+	assert_int_equal(rte_pktmbuf_chain(m, n), 0);
+	STAILQ_INIT(gr_mbuf_traces(m));
+	STAILQ_INSERT_HEAD(gr_mbuf_traces(m), &trace, next);
+
+	// The packet is left untouched.
+	assert_null(gr_mbuf_linearize(m));
+	assert_int_equal(m->nb_segs, 2);
+	assert_pkt(m, 2 * DATA_LEN, 7);
+	assert_ptr_equal(STAILQ_FIRST(gr_mbuf_traces(m)), &trace);
+
+	STAILQ_INIT(gr_mbuf_traces(m));
+	rte_pktmbuf_free(m);
+}
+
+int main(void) {
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_teardown(share_small, teardown),
+		cmocka_unit_test_teardown(share_split, teardown),
+		cmocka_unit_test_teardown(share_indirect, teardown),
+		cmocka_unit_test_teardown(linearize_in_place, teardown),
+		cmocka_unit_test_teardown(linearize_shared, teardown),
+		cmocka_unit_test_teardown(linearize_indirect, teardown),
+		cmocka_unit_test_teardown(linearize_too_large, teardown),
+	};
+	return cmocka_run_group_tests(tests, group_setup, NULL);
+}
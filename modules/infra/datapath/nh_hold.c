@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "graph.h"
+#include "l3.h"
+#include "log.h"
+#include "mbuf.h"
+#include "nexthop.h"
+#include "trace.h"
+
+#include <rte_cycles.h>
+#include <rte_graph_worker.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include <stdatomic.h>
+
+LOG_TYPE("graph");
+
+// Per-lcore tables of packets waiting for nexthop resolution.
+// Entries are keyed by nexthop and by packet address family.
+//
+// Only the first packet held for a given nexthop is sent to the control plane
+// to trigger address resolution. Following packets are kept in the datapath
+// until the nexthop becomes reachable. They are then sent back to the address
+// family output node in bulk by the nh_hold_flush source node.
+//
+// Nexthops are referenced across graph walks. Each entry records the
+// invalidation generation of its nexthop index when it is created. When a
+// nexthop is destroyed, nh_hold_invalidate() bumps that generation once before
+// and once after the RCU grace period, and the nexthop memory is reused only
+// after another grace period. Entries with a stale generation are dropped
+// without dereferencing their nexthop. Generations are shared by nexthop
+// indexes that map to the same bucket, a destroy only affects a few entries.
+
+#define NH_HOLD_GENS 1024 // must be a power of two
+#define NH_HOLD_SLOTS 256 // must be a power of two
+#define NH_HOLD_PROBES 4
+#define NH_HOLD_PKTS 16
+#define NH_HOLD_TIMEOUT_SEC 3
+
+struct nh_hold_entry {
+	const struct nexthop *nh;
+	uint32_t nh_idx; // copy of nh->idx, valid after nh is freed
+	unsigned gen;
+	uint64_t since;
+	uint16_t active_idx;
+	uint16_t n_pkts;
+	addr_family_t af;
+	struct rte_mbuf *pkts[NH_HOLD_PKTS];
+};
+
+struct nh_hold_table {
+	uint16_t n_active;
+	uint16_t active[NH_HOLD_SLOTS];
+	struct nh_hold_entry entries[NH_HOLD_SLOTS];
+};
+
+static struct nh_hold_table *tables[RTE_MAX_LCORE];
+static atomic_uint hold_gens[NH_HOLD_GENS];
+
+static inline atomic_uint *hold_gen(uint32_t nh_idx) {
+	return &hold_gens[nh_idx & (NH_HOLD_GENS - 1)];
+}
+
+void nh_hold_invalidate(const struct nexthop *nh) {
+	atomic_fetch_add_explicit(hold_gen(nh->idx), 1, memory_order_release);
+}
+
+static inline bool hold_entry_stale(const struct nh_hold_entry *e) {
+	return e->gen != atomic_load_explicit(hold_gen(e->nh_idx), memory_order_acquire);
+}
+
+static void hold_entry_free(struct nh_hold_table *t, struct nh_hold_entry *e) {
+	struct nh_hold_entry *last;
+
+	t->n_active--;
+	if (e->active_idx != t->n_active) {
+		last = &t->entries[t->active[t->n_active]];
+		last->active_idx = e->active_idx;
+		t->active[e->active_idx] = t->active[t->n_active];
+	}
+	e->nh = NULL;
+	e->n_pkts = 0;
+}
+
+static void hold_table_clear(struct nh_hold_table *t) {
+	struct nh_hold_entry *e;
+
+	while (t->n_active > 0) {
+		e = &t->entries[t->active[t->n_active - 1]];
+		rte_pktmbuf_free_bulk(e->pkts, e->n_pkts);
+		hold_entry_free(t, e);
+	}
+}
+
+nh_hold_verdict_t
+nh_hold_enqueue(const struct nexthop *nh, addr_family_t af, struct rte_mbuf *m) {
+	struct nh_hold_table *t = tables[rte_lcore_id()];
+	struct nh_hold_entry *e, *free_slot;
+	unsigned slot, gen;
+
+	if (unlikely(t == NULL))
+		return NH_HOLD_PUNT;
+
+	gen = atomic_load_explicit(hold_gen(nh->idx), memory_order_acquire);
+	slot = nh->idx * 2 + (af == GR_AF_IP6);
+	free_slot = NULL;
+
+	for (unsigned i = 0; i < NH_HOLD_PROBES; i++) {
+		e = &t->entries[(slot + i) & (NH_HOLD_SLOTS - 1)];
+		// Entries left over by a destroyed nexthop at the same address
+		// have a stale generation. Their packets are dropped by the
+		// nh_hold_flush node, which also releases the slot.
+		if (e->nh == nh && e->af == af && e->gen == gen) {
+			if (e->n_pkts == NH_HOLD_PKTS)
+				return NH_HOLD_DROP;
+			e->pkts[e->n_pkts++] = m;
+			return NH_HOLD_QUEUED;
+		}
+		if (e->nh == NULL && free_slot == NULL)
+			free_slot = e;
+	}
+
+	// First packet for this nexthop: send it to the control plane to trigger
+	// resolution. Reserve a slot so that next ones are held here. If there is
+	// no room left, they will all be sent to the control plane.
+	if (free_slot != NULL) {
+		free_slot->nh = nh;
+		free_slot->nh_idx = nh->idx;
+		free_slot->gen = gen;
+		free_slot->af = af;
+		free_slot->since = rte_rdtsc();
+		free_slot->n_pkts = 0;
+		free_slot->active_idx = t->n_active;
+		t->active[t->n_active++] = free_slot - t->entries;
+	}
+
+	return NH_HOLD_PUNT;
+}
+
+enum {
+	EXPIRED = 0,
+	EDGE_COUNT,
+};
+
+static rte_edge_t af_edges[UINT_NUM_VALUES(addr_family_t)] = {EXPIRED};
+
+void nh_hold_register_output(addr_family_t af, const char *next_node) {
+	if (!gr_af_valid(af))
+		ABORT("invalid address family=%u", af);
+	if (af_edges[af] != EXPIRED)
+		ABORT("next node already registered for af=%s", gr_af_name(af));
+	LOG(DEBUG, "nh_hold_flush: af=%s -> %s", gr_af_name(af), next_node);
+	af_edges[af] = gr_node_attach_parent("nh_hold_flush", next_node);
+}
+
+static uint16_t nh_hold_flush_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void ** /*objs*/,
+	uint16_t /*nb_objs*/
+) {
+	struct nh_hold_table *t = tables[rte_lcore_id()];
+	const struct nexthop_info_l3 *l3;
+	struct nh_hold_entry *e;
+	uint64_t now, timeout;
+	uint16_t sent = 0;
+	rte_edge_t edge;
+
+	if (likely(t == NULL || t->n_active == 0))
+		return 0;
+
+	now = rte_rdtsc();
+	timeout = NH_HOLD_TIMEOUT_SEC * rte_get_tsc_hz();
+
+	for (uint16_t i = 0; i < t->n_active;) {
+		e = &t->entries[t->active[i]];
+
+		if (unlikely(hold_entry_stale(e))) {
+			// The nexthop was destroyed, do not dereference it.
+			for (uint16_t p = 0; p < e->n_pkts; p++) {
+				if (gr_mbuf_is_traced(e->pkts[p]))
+					gr_mbuf_trace_add(e->pkts[p], node, 0);
+			}
+			if (e->n_pkts > 0)
+				rte_node_enqueue(graph, node, EXPIRED, (void **)e->pkts, e->n_pkts);
+			hold_entry_free(t, e);
+			continue;
+		}
+
+		l3 = nexthop_info_l3(e->nh);
+		if (l3->state == GR_NH_S_REACHABLE) {
+			edge = af_edges[e->af];
+		} else if (l3->state == GR_NH_S_FAILED || now - e->since > timeout) {
+			edge = EXPIRED;
+		} else {
+			i++;
+			continue;
+		}
+
+		for (uint16_t p = 0; p < e->n_pkts; p++) {
+			struct rte_mbuf *m = e->pkts[p];
+			l3_mbuf_data(m)->nh = e->nh;
+			if (gr_mbuf_is_traced(m))
+				gr_mbuf_trace_add(m, node, 0);
+		}
+		if (e->n_pkts > 0)
+			rte_node_enqueue(graph, node, edge, (void **)e->pkts, e->n_pkts);
+		if (edge != EXPIRED)
+			sent += e->n_pkts;
+
+		// hold_entry_free moves the last active entry at index i.
+		hold_entry_free(t, e);
+	}
+
+	return sent;
+}
+
+static void *lcore_cb_handle;
+
+static int hold_lcore_init(unsigned lcore_id, void *) {
+	tables[lcore_id] = rte_zmalloc_socket(
+		__func__, sizeof(*tables[lcore_id]), RTE_CACHE_LINE_SIZE, rte_socket_id()
+	);
+	if (tables[lcore_id] == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket(nh_hold_table)");
+	return 0;
+}
+
+static void hold_lcore_fini(unsigned lcore_id, void *) {
+	if (tables[lcore_id] != NULL)
+		hold_table_clear(tables[lcore_id]);
+	rte_free(tables[lcore_id]);
+	tables[lcore_id] = NULL;
+}
+
+static void hold_init(void) {
+	lcore_cb_handle = rte_lcore_callback_register(
+		"nh_hold", hold_lcore_init, hold_lcore_fini, NULL
+	);
+	if (lcore_cb_handle == NULL)
+		ABORT("rte_lcore_callback_register(nh_hold)");
+}
+
+static void hold_fini(void) {
+	rte_lcore_callback_unregister(lcore_cb_handle);
+	lcore_cb_handle = NULL;
+}
+
+static struct rte_node_register node = {
+	.name = "nh_hold_flush",
+	.flags = RTE_NODE_SOURCE_F,
+
+	.process = nh_hold_flush_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[EXPIRED] = "nh_hold_expired",
+		// other edges are updated dynamically with nh_hold_register_output
+	},
+};
+
+static struct gr_node_info info = {
+	.node = &node,
+	.type = GR_NODE_T_CONTROL | GR_NODE_T_L3,
+	.register_callback = hold_init,
+	.unregister_callback = hold_fini,
+};
+
+GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(nh_hold_expired);
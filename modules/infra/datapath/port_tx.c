@@ -18,6 +18,7 @@ enum {
 	TX_ERROR = 0,
 	TX_DOWN,
 	NO_HEADROOM,
+	NO_LINEARIZE,
 	NB_EDGES,
 };
 
@@ -81,22 +82,33 @@ static inline void tx_finish(
 	}
 }
 
-static inline uint16_t tx_add_vlan(
+// Insert VLAN tags and linearize chained mbufs if the port does not support them.
+static inline uint16_t tx_prepare(
 	struct rte_graph *graph,
 	struct rte_node *node,
 	void **objs,
 	uint16_t nb_objs,
 	struct rte_mbuf **mbufs
 ) {
+	const struct iface_info_port *port = iface_info_port(mbuf_data(objs[0])->iface);
 	const struct iface_mbuf_data *d;
 	struct rte_ether_hdr *eth;
 	struct rte_vlan_hdr *vlan;
-	struct rte_mbuf *m;
+	struct rte_mbuf *m, *lin;
 	uint16_t ok = 0;
 	void *data;
 
 	for (unsigned i = 0; i < nb_objs; i++) {
 		m = objs[i];
+		if (unlikely(m->nb_segs > 1)
+		    && !(port->tx_offloads & RTE_ETH_TX_OFFLOAD_MULTI_SEGS)) {
+			lin = gr_mbuf_linearize(m);
+			if (lin == NULL) {
+				rte_node_enqueue_x1(graph, node, NO_LINEARIZE, m);
+				continue;
+			}
+			m = lin;
+		}
 		d = iface_mbuf_data(m);
 		if (d->vlan_id != 0) {
 			eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
@@ -125,7 +137,7 @@ uint16_t tx_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 	if (unlikely(!tx_begin(graph, node, objs, nb_objs, 0)))
 		return 0;
 
-	nb_objs = tx_add_vlan(graph, node, objs, nb_objs, mbufs);
+	nb_objs = tx_prepare(graph, node, objs, nb_objs, mbufs);
 	if (unlikely(nb_objs == 0))
 		return 0;
 
@@ -145,7 +157,7 @@ tx_shared_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 	if (unlikely(!tx_begin(graph, node, objs, nb_objs, RXTX_F_TXQ_SHARED)))
 		return 0;
 
-	nb_objs = tx_add_vlan(graph, node, objs, nb_objs, mbufs);
+	nb_objs = tx_prepare(graph, node, objs, nb_objs, mbufs);
 	if (unlikely(nb_objs == 0))
 		return 0;
 
@@ -168,6 +180,7 @@ static struct rte_node_register node = {
 		[TX_ERROR] = "port_tx_error",
 		[TX_DOWN] = "port_tx_down",
 		[NO_HEADROOM] = "error_no_headroom",
+		[NO_LINEARIZE] = "port_tx_linearize_error",
 	},
 };
 
@@ -181,3 +194,4 @@ GR_NODE_REGISTER(info);
 
 GR_DROP_REGISTER(port_tx_error);
 GR_DROP_REGISTER(port_tx_down);
+GR_DROP_REGISTER(port_tx_linearize_error);
@@ -3,6 +3,27 @@
 
 #pragma once
 
+#include <rte_hash.h>
 #include <rte_rcu_qsbr.h>
 
 struct rte_rcu_qsbr *gr_datapath_rcu(void);
+
+typedef void (*gr_rcu_free_cb_t)(void *obj);
+
+// Call free_cb(obj) once all datapath workers have gone through a quiescent
+// state. The object must already be unreachable from the datapath. This does
+// not block, reclamation happens from an event loop timer.
+//
+// Must be called from the control plane thread.
+void gr_rcu_defer(gr_rcu_free_cb_t free_cb, void *obj);
+
+// Wait for all deferred objects to be freed. Must be called before releasing
+// resources that pending callbacks depend on (e.g. mempools).
+void gr_rcu_defer_flush(void);
+
+// Attach a hash table to the datapath RCU in deferred queue mode. Deleted keys
+// (and their data, if free_cb is not NULL) are reclaimed asynchronously.
+int gr_rcu_hash_attach(struct rte_hash *, rte_hash_free_key_data free_cb, void *priv);
+
+// Free a hash table after a grace period, along with its pending deleted keys.
+void gr_rcu_hash_free(struct rte_hash *);
@@ -26,11 +26,13 @@ static int trace_vrf_format(char *buf, size_t len, const void *data, size_t /*da
 static uint16_t
 xvrf_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct eth_input_mbuf_data *eth_data;
+	struct gr_node_batch batch;
 	struct rte_mbuf *m;
 	rte_edge_t edge;
 
 	IFACE_STATS_VARS(rx);
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		m = objs[i];
 
@@ -50,11 +52,13 @@ xvrf_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16
 			t->vrf_id = eth_data->iface->vrf_id;
 		}
 
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
 	IFACE_STATS_FLUSH(rx);
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -18,6 +18,11 @@
 
 const struct nexthop *fib4_lookup(uint16_t vrf_id, ip4_addr_t ip);
 
+// Lookup n destination addresses in the FIB of the same VRF at once.
+// Unresolved destinations are reported with a NULL nexthop.
+void
+fib4_lookup_bulk(uint16_t vrf_id, const ip4_addr_t *ips, const struct nexthop **nhs, unsigned n);
+
 static inline struct nexthop *nh4_lookup(uint16_t vrf_id, ip4_addr_t ip) {
 	// XXX: should we scope ip4 nh lookup based on rfc3927 ?
 	return nexthop_lookup_l3(GR_AF_IP4, vrf_id, GR_IFACE_ID_UNDEF, &ip);
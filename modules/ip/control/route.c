@@ -31,6 +31,12 @@ static uint64_t route_prefixlens[GR_MAX_IFACES][RTE_FIB_MAXDEPTH + 1];
 
 static uint32_t max_routes_default = 1 << 16;
 
+// Extension stored in each RIB node.
+struct rib4_ext {
+	gr_nh_origin_t origin;
+	struct nexthop_route *route; // entry in the reverse index of the nexthop
+};
+
 // Derive num_tbl8 from max_routes for IPv4 DIR24_8.
 // Only prefixes longer than /24 consume tbl8 groups. In real-world BGP
 // tables, less than 0.1% of prefixes are longer than /24. A ratio of
@@ -65,9 +71,9 @@ static struct rte_fib *create_fib(const struct iface *vrf) {
 		.type = RTE_FIB_DIR24_8,
 		.default_nh = 0,
 		.max_routes = fib4_get_max_routes(vrf),
-		.rib_ext_sz = sizeof(gr_nh_origin_t),
+		.rib_ext_sz = sizeof(struct rib4_ext),
 		.dir24_8 = {
-			.nh_sz = RTE_FIB_DIR24_8_8B,
+			.nh_sz = RTE_FIB_DIR24_8_4B,
 			.num_tbl8 = fib4_get_num_tbl8(vrf),
 		},
 	};
@@ -117,27 +123,15 @@ static int fib4_init(struct iface *vrf) {
 	return 0;
 }
 
+// rte_fib stores 4-byte nexthop values minus one bit which is used to store
+// metadata about the routing table. Store compact nexthop indexes rather than
+// pointers. Index 0 is the default value and resolves to NULL.
 static inline uintptr_t nh_ptr_to_id(const struct nexthop *nh) {
-	uintptr_t id = (uintptr_t)nh;
-
-	// rte_fib stores the nexthop ID on 8 bytes minus one bit which is used
-	// to store metadata about the routing table.
-	//
-	// Address mappings in userspace are guaranteed on x86_64 and aarch64
-	// to use at most 47 bits, leaving at least 17 bits of headroom filled
-	// with zeroes.
-	//
-	// rte_fib_add already checks that the nexthop value does not exceed the
-	// maximum allowed value. For clarity, we explicitly fail if the MSB is
-	// not zero.
-	if (id & GR_BIT64(63))
-		ABORT("MSB is not 0, martian architecture?");
-
-	return id;
+	return nh->idx;
 }
 
 static inline struct nexthop *nh_id_to_ptr(uintptr_t id) {
-	return (struct nexthop *)id;
+	return nexthop_from_idx(id);
 }
 
 const struct nexthop *fib4_lookup(uint16_t vrf_id, ip4_addr_t ip) {
@@ -152,7 +146,35 @@ const struct nexthop *fib4_lookup(uint16_t vrf_id, ip4_addr_t ip) {
 	if (nh_id == 0)
 		return errno_set_null(EHOSTUNREACH);
 
-	return nh_id_to_ptr(nh_id);
+	return nexthop_resolve(nh_id_to_ptr(nh_id));
+}
+
+// Number of addresses converted to host order on the stack per rte_fib_lookup_bulk call.
+#define FIB4_LOOKUP_BULK_MAX 64
+
+void
+fib4_lookup_bulk(uint16_t vrf_id, const ip4_addr_t *ips, const struct nexthop **nhs, unsigned n) {
+	uint32_t host_order_ips[FIB4_LOOKUP_BULK_MAX];
+	uintptr_t nh_ids[FIB4_LOOKUP_BULK_MAX];
+	struct rte_fib *fib = get_fib(vrf_id);
+	unsigned i, j, len;
+
+	if (fib == NULL) {
+		for (i = 0; i < n; i++)
+			nhs[i] = NULL;
+		return;
+	}
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, FIB4_LOOKUP_BULK_MAX);
+		for (j = 0; j < len; j++)
+			host_order_ips[j] = rte_be_to_cpu_32(ips[i + j]);
+		rte_fib_lookup_bulk(fib, host_order_ips, nh_ids, len);
+		// nh_id 0 is the default nexthop value, it is translated to NULL.
+		// Recursive nexthops are followed to what they currently resolve to.
+		for (j = 0; j < len; j++)
+			nhs[i + j] = nexthop_resolve(nh_id_to_ptr(nh_ids[j]));
+	}
 }
 
 struct nexthop *rib4_lookup(uint16_t vrf_id, ip4_addr_t ip) {
@@ -208,9 +230,10 @@ static int rib4_insert_or_replace(
 ) {
 	struct rte_fib *fib = get_fib(vrf_id);
 	struct nexthop *existing = NULL;
+	struct nexthop_route *route;
 	struct rte_rib_node *rn;
+	struct rib4_ext *ext;
 	struct rte_rib *rib;
-	gr_nh_origin_t *o;
 	int ret;
 
 	if (fib == NULL)
@@ -229,18 +252,34 @@ static int rib4_insert_or_replace(
 			return errno_set(nexthop_equal(nh, existing) ? EEXIST : EBUSY);
 	}
 
-	if ((ret = rte_fib_add(fib, rte_be_to_cpu_32(ip), prefixlen, nh_ptr_to_id(nh))) < 0)
+	route = nexthop_route_add(
+		nh,
+		&(struct nexthop_route) {
+			.vrf_id = vrf_id,
+			.af = GR_AF_IP4,
+			.prefixlen = prefixlen,
+			.ipv4 = ip,
+		}
+	);
+	if (route == NULL)
+		return -errno;
+
+	if ((ret = rte_fib_add(fib, rte_be_to_cpu_32(ip), prefixlen, nh_ptr_to_id(nh))) < 0) {
+		nexthop_route_del(nh, route);
 		return errno_set(-ret);
+	}
 
 	rn = rte_rib_lookup_exact(rib, rte_be_to_cpu_32(ip), prefixlen);
-	o = rte_rib_get_ext(rn);
+	ext = rte_rib_get_ext(rn);
 	if (existing) {
-		assert(route_counts[vrf_id][*o] > 0);
-		route_counts[vrf_id][*o]--;
+		assert(route_counts[vrf_id][ext->origin] > 0);
+		route_counts[vrf_id][ext->origin]--;
 		assert(route_prefixlens[vrf_id][prefixlen] > 0);
 		route_prefixlens[vrf_id][prefixlen]--;
+		nexthop_route_del(existing, ext->route);
 	}
-	*o = origin;
+	ext->origin = origin;
+	ext->route = route;
 	route_counts[vrf_id][origin]++;
 	route_prefixlens[vrf_id][prefixlen]++;
 
@@ -275,8 +314,10 @@ int rib4_insert(
 
 int rib4_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, gr_nh_type_t nh_type) {
 	struct rte_fib *fib = get_fib(vrf_id);
-	gr_nh_origin_t *o, origin;
+	struct nexthop_route *route;
+	const struct rib4_ext *ext;
 	struct rte_rib_node *rn;
+	gr_nh_origin_t origin;
 	struct nexthop *nh;
 	struct rte_rib *rib;
 	uintptr_t nh_id;
@@ -291,8 +332,10 @@ int rib4_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, gr_nh_type_t
 	if (rn == NULL)
 		return errno_set(ENOENT);
 
-	o = rte_rib_get_ext(rn);
-	origin = *o;
+	ext = rte_rib_get_ext(rn);
+	origin = ext->origin;
+	// The node is freed by rte_fib_delete().
+	route = ext->route;
 	rte_rib_get_nh(rn, &nh_id);
 	nh = nh_id_to_ptr(nh_id);
 	if (nh->type != nh_type)
@@ -318,6 +361,7 @@ int rib4_delete(uint16_t vrf_id, ip4_addr_t ip, uint8_t prefixlen, gr_nh_type_t
 	assert(route_prefixlens[vrf_id][prefixlen] > 0);
 	route_prefixlens[vrf_id][prefixlen]--;
 
+	nexthop_route_del(nh, route);
 	nexthop_decref(nh);
 
 	return 0;
@@ -339,7 +383,7 @@ static struct api_out route4_add(const void *request, struct api_ctx *) {
 	} else if ((nh = nexthop_lookup_l3(GR_AF_IP4, req->vrf_id, GR_IFACE_ID_UNDEF, &req->nh))
 		   == NULL) {
 		// ensure route gateway is reachable
-		if ((nh = rib4_lookup(req->vrf_id, req->nh)) == NULL)
+		if ((nh = nexthop_resolve(rib4_lookup(req->vrf_id, req->nh))) == NULL)
 			return api_out(EHOSTUNREACH, 0, NULL);
 
 		// if the route gateway is reachable via a prefix route,
@@ -406,14 +450,14 @@ static struct api_out route4_get(const void *request, struct api_ctx *) {
 }
 
 static int rib4_iter_route(struct rte_rib_node *rn, uint16_t vrf_id, struct rib4_iterator *iter) {
-	gr_nh_origin_t *origin;
+	const struct rib4_ext *ext;
 	uint8_t prefixlen;
 	uintptr_t nh_id;
 	uint32_t ip;
 	int ret;
 
-	origin = rte_rib_get_ext(rn);
-	if (iter->skip_internal && *origin == GR_NH_ORIGIN_INTERNAL)
+	ext = rte_rib_get_ext(rn);
+	if (iter->skip_internal && ext->origin == GR_NH_ORIGIN_INTERNAL)
 		return 0;
 
 	if (iter->max_count != 0 && iter->count >= iter->max_count)
@@ -424,7 +468,7 @@ static int rib4_iter_route(struct rte_rib_node *rn, uint16_t vrf_id, struct rib4
 	rte_rib_get_nh(rn, &nh_id);
 
 	ret = iter->cb(
-		vrf_id, rte_cpu_to_be_32(ip), prefixlen, *origin, nh_id_to_ptr(nh_id), iter->priv
+		vrf_id, rte_cpu_to_be_32(ip), prefixlen, ext->origin, nh_id_to_ptr(nh_id), iter->priv
 	);
 	if (ret < 0)
 		return ret;
@@ -522,11 +566,6 @@ struct rib4_cleanup_entry {
 	gr_nh_type_t type;
 };
 
-struct rib4_cleanup_ctx {
-	const struct nexthop *nh;
-	vec struct rib4_cleanup_entry *entries;
-};
-
 static int rib4_cleanup_cb(
 	uint16_t vrf_id,
 	ip4_addr_t ip,
@@ -535,34 +574,36 @@ static int rib4_cleanup_cb(
 	const struct nexthop *nh,
 	void *priv
 ) {
-	struct rib4_cleanup_ctx *ctx = priv;
-	if (ctx->nh == NULL || nh == ctx->nh) {
-		struct rib4_cleanup_entry entry = {
-			.vrf_id = vrf_id,
-			.ip = ip,
-			.depth = depth,
-			.type = nh->type,
-		};
-		vec_add(ctx->entries, entry);
-	}
+	vec struct rib4_cleanup_entry **entries = priv;
+	struct rib4_cleanup_entry entry = {
+		.vrf_id = vrf_id,
+		.ip = ip,
+		.depth = depth,
+		.type = nh->type,
+	};
+	vec_add(*entries, entry);
 	return 0;
 }
 
 void rib4_cleanup(struct nexthop *nh) {
-	struct rib4_cleanup_ctx ctx = {
-		.nh = nh,
-		.entries = NULL,
-	};
-	struct rib4_iterator iter = {
-		.max_count = 0,
-		.skip_internal = false,
-		.cb = rib4_cleanup_cb,
-		.priv = &ctx,
-	};
-	rib4_iter(GR_VRF_ID_UNDEF, &iter);
-	vec_foreach_ref (struct rib4_cleanup_entry *r, ctx.entries)
+	vec struct rib4_cleanup_entry *entries = NULL;
+	const struct nexthop_route *route;
+
+	// Deleting routes modifies the reverse index, collect them first.
+	vec_foreach (route, nexthop_routes(nh)) {
+		if (route->af != GR_AF_IP4)
+			continue;
+		struct rib4_cleanup_entry entry = {
+			.vrf_id = route->vrf_id,
+			.ip = route->ipv4,
+			.depth = route->prefixlen,
+			.type = nh->type,
+		};
+		vec_add(entries, entry);
+	}
+	vec_foreach_ref (struct rib4_cleanup_entry *r, entries)
 		rib4_delete(r->vrf_id, r->ip, r->depth, r->type);
-	vec_free(ctx.entries);
+	vec_free(entries);
 }
 
 METRIC_GAUGE(m_routes, "rib4_routes", "Number of IPv4 routes by origin.");
@@ -656,6 +697,7 @@ static int serialize_route4_event(const void *obj, void **buf) {
 }
 
 struct fib4_migrate_ctx {
+	struct rte_rib *old_rib;
 	struct rte_fib *new_fib;
 	uint32_t counts[UINT_NUM_VALUES(gr_nh_origin_t)];
 	uint64_t prefixlens[RTE_FIB_MAXDEPTH + 1];
@@ -671,8 +713,12 @@ static int fib4_migrate_cb(
 ) {
 	uint32_t host_ip = rte_be_to_cpu_32(ip);
 	struct fib4_migrate_ctx *ctx = priv;
+	struct rte_rib_node *old, *rn;
+	struct rib4_ext *ext;
 	int ret;
 
+	old = rte_rib_lookup_exact(ctx->old_rib, host_ip, prefixlen);
+
 	ret = rte_fib_add(ctx->new_fib, host_ip, prefixlen, nh_ptr_to_id(nh));
 	if (ret < 0) {
 		if (nh->type == GR_NH_T_L3 && (nexthop_info_l3(nh)->flags & NH_LOCAL_ADDR_FLAGS)) {
@@ -702,15 +748,16 @@ static int fib4_migrate_cb(
 					}
 				);
 			}
+			ext = rte_rib_get_ext(old);
+			nexthop_route_del((void *)nh, ext->route);
 			nexthop_decref((void *)nh);
 		}
 		return 0;
 	}
 
-	struct rte_rib *rib = rte_fib_get_rib(ctx->new_fib);
-	struct rte_rib_node *rn = rte_rib_lookup_exact(rib, host_ip, prefixlen);
-	gr_nh_origin_t *o = rte_rib_get_ext(rn);
-	*o = origin;
+	rn = rte_rib_lookup_exact(rte_fib_get_rib(ctx->new_fib), host_ip, prefixlen);
+	ext = rte_rib_get_ext(rn);
+	*ext = *(const struct rib4_ext *)rte_rib_get_ext(old);
 	ctx->counts[origin]++;
 	ctx->prefixlens[prefixlen]++;
 
@@ -724,6 +771,10 @@ static uint32_t fib4_total_routes(uint16_t vrf_id) {
 	return total;
 }
 
+static void fib4_free(void *fib) {
+	rte_fib_free(fib);
+}
+
 static int fib4_reconfig(struct iface *vrf) {
 	struct gr_iface_info_vrf_fib *conf = &iface_info_vrf(vrf)->ipv4;
 	struct rte_fib *old_fib, *new_fib;
@@ -738,7 +789,10 @@ static int fib4_reconfig(struct iface *vrf) {
 	if (new_fib == NULL)
 		return errno_log(errno, "create_fib");
 
-	struct fib4_migrate_ctx ctx = {.new_fib = new_fib};
+	struct fib4_migrate_ctx ctx = {
+		.old_rib = rte_fib_get_rib(old_fib),
+		.new_fib = new_fib,
+	};
 	struct rib4_iterator iter = {
 		.max_count = 0,
 		.skip_internal = false,
@@ -748,8 +802,7 @@ static int fib4_reconfig(struct iface *vrf) {
 	rib4_iter_vrf(rte_fib_get_rib(old_fib), vrf->id, &iter);
 
 	iface_info_vrf(vrf)->fib4 = new_fib;
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-	rte_fib_free(old_fib);
+	gr_rcu_defer(fib4_free, old_fib);
 
 	memcpy(route_counts[vrf->id], ctx.counts, sizeof(ctx.counts));
 	memcpy(route_prefixlens[vrf->id], ctx.prefixlens, sizeof(ctx.prefixlens));
@@ -803,21 +856,18 @@ static void fib4_fini(struct iface *vrf) {
 
 	if (fib != NULL) {
 		LOG(INFO, "destroying IPv4 FIB for VRF %s(%u)", vrf->name, vrf->id);
-		struct rib4_cleanup_ctx ctx = {
-			.nh = NULL,
-			.entries = NULL,
-		};
+		vec struct rib4_cleanup_entry *entries = NULL;
 		struct rib4_iterator iter = {
 			.max_count = 0,
 			.skip_internal = false,
 			.cb = rib4_cleanup_cb,
-			.priv = &ctx,
+			.priv = &entries,
 		};
 		rib4_iter_vrf(rte_fib_get_rib(fib), vrf->id, &iter);
 
-		vec_foreach_ref (struct rib4_cleanup_entry *r, ctx.entries)
+		vec_foreach_ref (struct rib4_cleanup_entry *r, entries)
 			rib4_delete(r->vrf_id, r->ip, r->depth, r->type);
-		vec_free(ctx.entries);
+		vec_free(entries);
 
 		iface_info_vrf(vrf)->fib4 = NULL;
 		rte_fib_free(fib);
@@ -5,12 +5,15 @@
 
 #include "control_queue.h"
 #include "iface.h"
+#include "ip4.h"
+#include "l3.h"
 #include "mbuf.h"
 #include "nexthop.h"
 
 #include <gr_net_types.h>
 
 #include <rte_byteorder.h>
+#include <rte_graph.h>
 #include <rte_ip.h>
 
 #include <stdint.h>
@@ -29,6 +32,8 @@ GR_MBUF_PRIV_DATA_TYPE(ip_local_mbuf_data, {
 void ip_input_register_nexthop_type(gr_nh_type_t type, const char *next_node);
 void ip_input_local_add_proto(uint8_t proto, const char *next_node);
 void ip_output_register_interface_type(gr_iface_type_t type, const char *next_node);
+// Return true if packets routed via this interface type are sent to eth_output.
+bool ip_output_iface_type_is_eth(gr_iface_type_t type);
 void ip_output_register_nexthop_type(gr_nh_type_t type, const char *next_node);
 int arp_output_request_solicit(struct nexthop *nh);
 void arp_update_nexthop(
@@ -56,6 +61,27 @@ static inline void ip_set_fields(struct rte_ipv4_hdr *ip, struct ip_local_mbuf_d
 	ip->hdr_checksum = rte_ipv4_cksum(ip);
 }
 
+static inline void fib4_lookup_scope(
+	uint16_t vrf_id,
+	uint16_t /*scope_id*/,
+	const void *dsts,
+	const struct nexthop **nhs,
+	unsigned n
+) {
+	fib4_lookup_bulk(vrf_id, dsts, nhs, n);
+}
+
+// Resolve a burst of destination addresses which may belong to different VRFs.
+// See fib_lookup_burst().
+static inline void ip4_fib_lookup_burst(
+	uint16_t n,
+	const uint16_t *vrf_ids,
+	const ip4_addr_t *dsts,
+	const struct nexthop **nhs
+) {
+	fib_lookup_burst(n, vrf_ids, NULL, dsts, sizeof(*dsts), nhs, fib4_lookup_scope);
+}
+
 int icmp_local_send(
 	uint16_t vrf_id,
 	ip4_addr_t dst,
@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "eth.h"
+#include "graph.h"
+#include "iface.h"
+#include "ip4_datapath.h"
+#include "l3.h"
+#include "mbuf.h"
+
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+// Fused ip_input -> ip_forward -> ip_output path for plain unicast forwarding.
+//
+// Packets are validated, routed, have their TTL decremented and their L2
+// destination resolved in one pass before being sent directly to eth_output.
+// Anything that does not fit the common case is sent untouched to ip_input
+// which will handle it (and report errors) as if the fast path did not exist.
+
+enum edges {
+	ETH_OUTPUT = 0,
+	IP_INPUT,
+	EDGE_COUNT,
+};
+
+#define NAT_FLAGS (GR_IFACE_F_SNAT_STATIC | GR_IFACE_F_SNAT_DYNAMIC)
+
+static inline bool ip4_fastpath_validate(struct rte_mbuf *mbuf) {
+	const struct eth_input_mbuf_data *e = eth_input_mbuf_data(mbuf);
+	const struct rte_ipv4_hdr *ip;
+
+	// Keep traced packets on the regular path so that every step is recorded.
+	if (gr_mbuf_is_traced(mbuf))
+		return false;
+	if (e->domain != ETH_DOMAIN_LOCAL || e->iface->flags & NAT_FLAGS)
+		return false;
+	if (rte_pktmbuf_data_len(mbuf) < sizeof(*ip))
+		return false;
+
+	ip = rte_pktmbuf_mtod(mbuf, const struct rte_ipv4_hdr *);
+
+	// IPv4 without options.
+	if (ip->version_ihl != IPV4_VERSION_IHL)
+		return false;
+	if (rte_be_to_cpu_16(ip->total_length) < sizeof(*ip))
+		return false;
+	// Let ip_forward generate ICMP time exceeded errors.
+	if (ip->time_to_live <= 1)
+		return false;
+	if (ip->dst_addr == RTE_IPV4_ANY || ip->dst_addr == IPV4_ADDR_BCAST
+	    || ip4_addr_is_mcast(ip->dst_addr))
+		return false;
+
+	switch (mbuf->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) {
+	case RTE_MBUF_F_RX_IP_CKSUM_NONE:
+	case RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN:
+		if (rte_ipv4_cksum(ip))
+			return false;
+		break;
+	case RTE_MBUF_F_RX_IP_CKSUM_BAD:
+		return false;
+	}
+
+	return true;
+}
+
+static inline bool ip4_fastpath_forward(struct rte_mbuf *mbuf, const struct nexthop *nh) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	const struct nexthop_info_l3 *l3;
+	struct eth_output_mbuf_data *d;
+	const struct iface *iface;
+	rte_be32_t csum;
+
+	if (nh == NULL || nh->type != GR_NH_T_L3)
+		return false;
+
+	l3 = nexthop_info_l3(nh);
+	if (l3->flags & GR_NH_F_LOCAL || l3->state != GR_NH_S_REACHABLE)
+		return false;
+	// Connected route, a /32 nexthop must be created by ip_hold.
+	if (l3->flags & GR_NH_F_LINK && ip->dst_addr != l3->ipv4)
+		return false;
+
+	iface = iface_from_id(nh->iface_id);
+	if (iface == NULL || iface->flags & NAT_FLAGS)
+		return false;
+	// Let ip_output redirect packets to the fast reroute backup, if any.
+	if (!(iface->state & GR_IFACE_S_RUNNING))
+		return false;
+	if (!ip_output_iface_type_is_eth(iface->type))
+		return false;
+	if (rte_pktmbuf_pkt_len(mbuf) > iface->mtu)
+		return false;
+
+	// From here on, the packet cannot go back to ip_input.
+	ip->time_to_live -= 1;
+	csum = ip->hdr_checksum + RTE_BE16(0x0100);
+	csum += csum >= 0xffff;
+	ip->hdr_checksum = csum;
+
+	mbuf->packet_type = RTE_PTYPE_L3_IPV4;
+	mbuf_data(mbuf)->iface = iface;
+
+	// This overwrites the eth_input_mbuf_data fields.
+	d = eth_output_mbuf_data(mbuf);
+	d->dst = l3->mac;
+	d->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+
+	return true;
+}
+
+static void ip4_fastpath_burst(struct gr_node_batch *batch, void **objs, uint16_t nb_objs) {
+	const struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	ip4_addr_t dsts[RTE_GRAPH_BURST_SIZE];
+	bool fast[RTE_GRAPH_BURST_SIZE];
+	struct rte_ipv4_hdr *ip;
+	struct rte_mbuf *mbuf;
+	uint16_t i, n_lookup;
+	rte_edge_t edge;
+
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		fast[i] = ip4_fastpath_validate(mbuf);
+		if (fast[i]) {
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+			vrf_ids[n_lookup] = eth_input_mbuf_data(mbuf)->iface->vrf_id;
+			dsts[n_lookup] = ip->dst_addr;
+			n_lookup++;
+		}
+	}
+
+	if (n_lookup > 0)
+		ip4_fib_lookup_burst(n_lookup, vrf_ids, dsts, nhs);
+
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		edge = IP_INPUT;
+		if (fast[i] && ip4_fastpath_forward(mbuf, nhs[n_lookup++]))
+			edge = ETH_OUTPUT;
+		gr_node_batch_enqueue(batch, edge, mbuf);
+	}
+}
+
+static uint16_t ip4_fastpath_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		ip4_fastpath_burst(&batch, &objs[i], n);
+	}
+
+	gr_node_batch_flush(&batch);
+
+	return nb_objs;
+}
+
+static void ip4_fastpath_register(void) {
+	gr_eth_input_add_fastpath(RTE_BE16(RTE_ETHER_TYPE_IPV4), "ip4_fastpath");
+}
+
+static struct rte_node_register fastpath_node = {
+	.name = "ip4_fastpath",
+
+	.process = ip4_fastpath_process,
+
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[ETH_OUTPUT] = "eth_output",
+		[IP_INPUT] = "ip_input",
+	},
+};
+
+static struct gr_node_info info = {
+	.node = &fastpath_node,
+	.type = GR_NODE_T_L3,
+	.register_callback = ip4_fastpath_register,
+};
+
+GR_NODE_REGISTER(info);
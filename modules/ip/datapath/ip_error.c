@@ -24,6 +24,7 @@ enum edges {
 
 static uint16_t
 ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
 	const struct ip_error_ctx *ctx = ip_error_ctx(node);
 	struct ip_local_mbuf_data *ip_data;
 	const struct nexthop_info_l3 *l3;
@@ -36,6 +37,7 @@ ip_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, ui
 	rte_edge_t edge;
 	unsigned len;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
@@ -90,9 +92,11 @@ next:
 		if (gr_mbuf_is_traced(mbuf)) {
 			gr_mbuf_trace_add(mbuf, node, 0);
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
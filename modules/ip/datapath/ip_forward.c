@@ -12,12 +12,14 @@ enum edges {
 
 static uint16_t
 ip_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
 	rte_be32_t csum;
 	rte_edge_t edge;
 	uint16_t i;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
@@ -34,9 +36,11 @@ ip_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 next:
 		if (gr_mbuf_is_traced(mbuf))
 			gr_mbuf_trace_add(mbuf, node, 0);
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -34,6 +34,27 @@ enum {
 	EDGE_COUNT,
 };
 
+// Truncate a possibly chained mbuf to len bytes, freeing the unused segments.
+// Unlike rte_pktmbuf_trim(), the data may be removed from several segments.
+static void fragment_cut(struct rte_mbuf *m, uint32_t len) {
+	struct rte_mbuf *seg = m;
+	uint32_t off = 0;
+	uint16_t nb_segs = 1;
+
+	while (off + seg->data_len < len) {
+		off += seg->data_len;
+		seg = seg->next;
+		nb_segs++;
+	}
+	seg->data_len = len - off;
+	if (seg->next != NULL) {
+		rte_pktmbuf_free(seg->next);
+		seg->next = NULL;
+	}
+	m->nb_segs = nb_segs;
+	m->pkt_len = len;
+}
+
 static uint16_t
 ip_fragment_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct rte_mbuf *mbuf, *frag_mbuf;
@@ -45,6 +66,7 @@ ip_fragment_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 	uint16_t num_frags, i;
 	uint16_t ip_hdr_len;
 	uint16_t sent = 0;
+	const void *src;
 	rte_edge_t edge;
 	void *payload;
 
@@ -110,9 +132,14 @@ ip_fragment_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 				break;
 			}
 
-			memcpy(payload,
-			       rte_pktmbuf_mtod_offset(mbuf, const void *, ip_hdr_len + offset),
-			       frag_data_len);
+			// The payload may be chained (e.g. shared by flooded replicas).
+			src = rte_pktmbuf_read(mbuf, ip_hdr_len + offset, frag_data_len, payload);
+			if (unlikely(src == NULL)) {
+				rte_pktmbuf_free(frag_mbuf);
+				break;
+			}
+			if (src != payload)
+				memcpy(payload, src, frag_data_len);
 
 			frag_ip->total_length = rte_cpu_to_be_16(ip_hdr_len + frag_data_len);
 			frag_ip->fragment_offset = rte_cpu_to_be_16(
@@ -141,7 +168,7 @@ ip_fragment_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 			num_frags = 1;
 		} else {
 			// Trim first fragment to the right size
-			rte_pktmbuf_trim(mbuf, data_len - frag_size);
+			fragment_cut(mbuf, ip_hdr_len + frag_size);
 			edge = IP_OUTPUT;
 		}
 
@@ -6,48 +6,83 @@
 #include "l3.h"
 #include "mbuf.h"
 #include "nexthop.h"
+#include "trace.h"
+
+#include <rte_ip.h>
 
 enum {
 	CONTROL = 0,
+	QUEUE_FULL,
 	EDGE_COUNT,
 };
 
 static uint16_t
 ip_hold_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	const struct nexthop_info_l3 *l3;
 	const struct nexthop_af_ops *ops;
+	const struct nexthop *nh;
+	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
-		// TODO: Allocate a new mbuf from a control plane pool and copy
-		// the packet into it so that the datapath mbuf can be freed and
-		// returned to the stack for hardware RX.
-		ops = nexthop_af_ops_from_nh(l3_mbuf_data(mbuf)->nh);
+		nh = l3_mbuf_data(mbuf)->nh;
+		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+
+		if (gr_mbuf_is_traced(mbuf))
+			gr_mbuf_trace_add(mbuf, node, 0);
+
+		if (nh == NULL || nh->type != GR_NH_T_L3)
+			goto punt;
+		l3 = nexthop_info_l3(nh);
+		// Connected route, the control plane must create a new nexthop.
+		if (l3->flags & GR_NH_F_LINK && ip->dst_addr != l3->ipv4)
+			goto punt;
+
+		switch (nh_hold_enqueue(nh, GR_AF_IP4, mbuf)) {
+		case NH_HOLD_QUEUED:
+			continue;
+		case NH_HOLD_DROP:
+			edge = QUEUE_FULL;
+			goto next;
+		case NH_HOLD_PUNT:
+			break;
+		}
+punt:
+		ops = nexthop_af_ops_from_nh(nh);
 		if (ops == NULL)
 			ops = nexthop_af_ops_from_mbuf(mbuf);
 		assert(ops != NULL);
 		control_output_set_cb(mbuf, ops->resolve, 0);
-		if (gr_mbuf_is_traced(mbuf))
-			gr_mbuf_trace_add(mbuf, node, 0);
+		edge = CONTROL;
+next:
+		rte_node_enqueue_x1(graph, node, edge, mbuf);
 	}
 
-	rte_node_next_stream_move(graph, node, CONTROL);
-
 	return nb_objs;
 }
 
+static void ip_hold_register(void) {
+	nh_hold_register_output(GR_AF_IP4, "ip_output");
+}
+
 static struct rte_node_register node = {
 	.name = "ip_hold",
 	.process = ip_hold_process,
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
 		[CONTROL] = "control_output",
+		[QUEUE_FULL] = "ip_hold_queue_full",
 	},
 };
 
 static struct gr_node_info info = {
 	.node = &node,
 	.type = GR_NODE_T_CONTROL | GR_NODE_T_L3,
+	.register_callback = ip_hold_register,
 };
 
 GR_NODE_REGISTER(info);
+
+GR_DROP_REGISTER(ip_hold_queue_full);
@@ -43,151 +43,228 @@ void ip_input_register_nexthop_type(gr_nh_type_t type, const char *next_node) {
 	nh_type_edges[type] = gr_node_attach_parent("ip_input", next_node);
 }
 
-static uint16_t
-ip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+// Pseudo edge for packets that passed validation and need a FIB lookup.
+#define FIB_LOOKUP ((rte_edge_t)EDGE_COUNT)
+// Pseudo edge for local packets that may be replies to source NATed connections.
+#define CONN_LOOKUP ((rte_edge_t)EDGE_COUNT + 1)
+
+static inline rte_edge_t ip_input_validate(struct rte_mbuf *mbuf) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+
+	// RFC 1812 section 5.2.2 IP Header Validation
+	//
+	// (1) The packet length reported by the Link Layer must be large
+	//     enough to hold the minimum length legal IP datagram (20 bytes).
+	if (rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ipv4_hdr)) {
+		// XXX: call rte_pktmuf_data_len is used to ensure that the IPv4 header
+		// is located on the first segment. IPv4 headers located on the second,
+		// third or subsequent segments, as well spanning segment boundaries, are
+		// not currently handled.
+		return BAD_LENGTH;
+	}
+
+	// (2) The IP checksum must be correct.
+	switch (mbuf->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) {
+	case RTE_MBUF_F_RX_IP_CKSUM_NONE:
+	case RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN:
+		// if this is not checked in H/W, check it.
+		if (rte_ipv4_cksum(ip))
+			return BAD_CHECKSUM;
+		break;
+	case RTE_MBUF_F_RX_IP_CKSUM_BAD:
+		return BAD_CHECKSUM;
+	}
+
+	if (unlikely(ip->dst_addr == RTE_IPV4_ANY))
+		return BAD_ADDR;
+
+	// (3) The IP version number must be 4.  If the version number is not 4
+	//     then the packet may be another version of IP, such as IPng or
+	//     ST-II.
+	if (ip->version != IPVERSION)
+		return BAD_VERSION;
+
+	// (4) The IP header length field must be large enough to hold the
+	//     minimum length legal IP datagram (20 bytes = 5 words).
+	if (rte_ipv4_hdr_len(ip) < sizeof(struct rte_ipv4_hdr))
+		return BAD_LENGTH;
+
+	// (5) The IP total length field must be large enough to hold the IP
+	//     datagram header, whose length is specified in the IP header
+	//     length field.
+	if (rte_cpu_to_be_16(ip->total_length) < sizeof(struct rte_ipv4_hdr))
+		return BAD_LENGTH;
+
+	switch (eth_input_mbuf_data(mbuf)->domain) {
+	case ETH_DOMAIN_LOOPBACK:
+	case ETH_DOMAIN_LOCAL:
+		// Packet sent to our ethernet address.
+		break;
+	case ETH_DOMAIN_BROADCAST:
+	case ETH_DOMAIN_MULTICAST:
+		// Non unicast ethernet destination. No need for a route lookup.
+		return LOCAL;
+	case ETH_DOMAIN_OTHER:
+	case ETH_DOMAIN_UNKNOWN:
+		// Drop all packets not sent to our ethernet address
+		return OTHER_HOST;
+	}
+
+	if (unlikely(ip->dst_addr == IPV4_ADDR_BCAST || ip4_addr_is_mcast(ip->dst_addr)))
+		return LOCAL;
+
+	return FIB_LOOKUP;
+}
+
+static inline rte_edge_t ip_input_classify(struct rte_mbuf *mbuf, const struct nexthop *nh) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	struct eth_input_mbuf_data *e = eth_input_mbuf_data(mbuf);
+	const struct iface *iface = e->iface;
 	const struct nexthop_info_l3 *l3;
-	struct eth_input_mbuf_data *e;
-	const struct iface *iface;
-	const struct nexthop *nh;
-	struct rte_ipv4_hdr *ip;
-	struct rte_mbuf *mbuf;
-	eth_domain_t domain;
+	eth_domain_t domain = e->domain;
 	rte_edge_t edge;
-	uint16_t i;
 
-	for (i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
-		e = eth_input_mbuf_data(mbuf);
-		domain = e->domain;
-		iface = e->iface;
-		nh = NULL;
-
-		// RFC 1812 section 5.2.2 IP Header Validation
-		//
-		// (1) The packet length reported by the Link Layer must be large
-		//     enough to hold the minimum length legal IP datagram (20 bytes).
-		if (rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ipv4_hdr)) {
-			// XXX: call rte_pktmuf_data_len is used to ensure that the IPv4 header
-			// is located on the first segment. IPv4 headers located on the second,
-			// third or subsequent segments, as well spanning segment boundaries, are
-			// not currently handled.
-			edge = BAD_LENGTH;
-			goto next;
-		}
+	if (nh == NULL)
+		return NO_ROUTE;
 
-		// (2) The IP checksum must be correct.
-		switch (mbuf->ol_flags & RTE_MBUF_F_RX_IP_CKSUM_MASK) {
-		case RTE_MBUF_F_RX_IP_CKSUM_NONE:
-		case RTE_MBUF_F_RX_IP_CKSUM_UNKNOWN:
-			// if this is not checked in H/W, check it.
-			if (rte_ipv4_cksum(ip)) {
-				edge = BAD_CHECKSUM;
-				goto next;
-			}
-			break;
-		case RTE_MBUF_F_RX_IP_CKSUM_BAD:
-			edge = BAD_CHECKSUM;
-			goto next;
-		}
+	// Store the resolved next hop for ip_output to avoid a second route lookup.
+	// This overwrites the eth_input_mbuf_data fields.
+	l3_mbuf_data(mbuf)->nh = nh;
 
-		if (unlikely(ip->dst_addr == RTE_IPV4_ANY)) {
-			edge = BAD_ADDR;
-			goto next;
-		}
+	edge = nh_type_edges[nh->type];
+	if (edge != FORWARD)
+		return edge;
 
-		// (3) The IP version number must be 4.  If the version number is not 4
-		//     then the packet may be another version of IP, such as IPng or
-		//     ST-II.
-		if (ip->version != IPVERSION) {
-			edge = BAD_VERSION;
-			goto next;
-		}
+	// If the resolved next hop is local and the destination IP is ourselves,
+	// send to ip_local.
+	if (domain == ETH_DOMAIN_LOOPBACK)
+		return OUTPUT;
 
-		// (4) The IP header length field must be large enough to hold the
-		//     minimum length legal IP datagram (20 bytes = 5 words).
-		if (rte_ipv4_hdr_len(ip) < sizeof(struct rte_ipv4_hdr)) {
-			edge = BAD_LENGTH;
-			goto next;
+	if (nh->type == GR_NH_T_L3) {
+		l3 = nexthop_info_l3(nh);
+		if (l3->flags & GR_NH_F_LOCAL && ip->dst_addr == l3->ipv4) {
+			edge = LOCAL;
+			if (iface->flags & GR_IFACE_F_SNAT_DYNAMIC)
+				edge = CONN_LOOKUP;
 		}
+	}
 
-		// (5) The IP total length field must be large enough to hold the IP
-		//     datagram header, whose length is specified in the IP header
-		//     length field.
-		if (rte_cpu_to_be_16(ip->total_length) < sizeof(struct rte_ipv4_hdr)) {
-			edge = BAD_LENGTH;
-			goto next;
-		}
+	return edge;
+}
 
-		switch (domain) {
-		case ETH_DOMAIN_LOOPBACK:
-		case ETH_DOMAIN_LOCAL:
-			// Packet sent to our ethernet address.
-			break;
-		case ETH_DOMAIN_BROADCAST:
-		case ETH_DOMAIN_MULTICAST:
-			// Non unicast ethernet destination. No need for a route lookup.
-			edge = LOCAL;
-			goto next;
-		case ETH_DOMAIN_OTHER:
-		case ETH_DOMAIN_UNKNOWN:
-			// Drop all packets not sent to our ethernet address
-			edge = OTHER_HOST;
-			goto next;
-		}
+static void ip_input_conn_lookup(void **objs, uint16_t nb_objs, rte_edge_t *edges) {
+	const struct conn_key *key_ptrs[RTE_GRAPH_BURST_SIZE];
+	struct conn_key keys[RTE_GRAPH_BURST_SIZE];
+	conn_flow_t flows[RTE_GRAPH_BURST_SIZE];
+	struct conn *conns[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	struct conn_mbuf_data *cd;
+	uint16_t i, n_keys;
 
-		if (unlikely(ip->dst_addr == IPV4_ADDR_BCAST || ip4_addr_is_mcast(ip->dst_addr))) {
-			edge = LOCAL;
-			goto next;
+	n_keys = 0;
+	for (i = 0; i < nb_objs; i++) {
+		if (edges[i] != CONN_LOOKUP)
+			continue;
+		edges[i] = LOCAL;
+		// XXX: All returning IP fragments will go to LOCAL
+		// whether they are part of a conntrack or not.
+		// We need reassembly to fix this.
+		if (gr_conn_parse_key(
+			    mbuf_data(objs[i])->iface, GR_AF_IP4, objs[i], &keys[n_keys]
+		    )) {
+			key_ptrs[n_keys] = &keys[n_keys];
+			idx[n_keys] = i;
+			n_keys++;
 		}
+	}
+
+	if (n_keys == 0)
+		return;
+
+	gr_conn_lookup_bulk(key_ptrs, conns, flows, n_keys);
 
-		nh = fib4_lookup(iface->vrf_id, ip->dst_addr);
-		if (nh == NULL) {
-			edge = NO_ROUTE;
-			goto next;
+	for (i = 0; i < n_keys; i++) {
+		if (conns[i] == NULL)
+			continue;
+		cd = conn_mbuf_data(objs[idx[i]]);
+		cd->conn = conns[i];
+		cd->flow = flows[i];
+		edges[idx[i]] = DNAT44_DYNAMIC;
+	}
+}
+
+static void
+ip_input_burst(struct rte_node *node, struct gr_node_batch *batch, void **objs, uint16_t nb_objs) {
+	const struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	ip4_addr_t dsts[RTE_GRAPH_BURST_SIZE];
+	struct rte_ipv4_hdr *ip;
+	uint16_t i, n_lookup, n_conn;
+	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
+
+	// Validation pass: check headers and collect destinations to resolve.
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		edges[i] = ip_input_validate(mbuf);
+		if (edges[i] == FIB_LOOKUP) {
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+			vrf_ids[n_lookup] = eth_input_mbuf_data(mbuf)->iface->vrf_id;
+			dsts[n_lookup] = ip->dst_addr;
+			n_lookup++;
 		}
+	}
 
-		// Store the resolved next hop for ip_output to avoid a second route lookup.
-		l3_mbuf_data(mbuf)->nh = nh;
-
-		edge = nh_type_edges[nh->type];
-		if (edge != FORWARD)
-			goto next;
-
-		// If the resolved next hop is local and the destination IP is ourselves,
-		// send to ip_local.
-		if (domain == ETH_DOMAIN_LOOPBACK)
-			edge = OUTPUT;
-		else if (nh->type == GR_NH_T_L3) {
-			l3 = nexthop_info_l3(nh);
-			if (l3->flags & GR_NH_F_LOCAL && ip->dst_addr == l3->ipv4) {
-				edge = LOCAL;
-				if (iface->flags & GR_IFACE_F_SNAT_DYNAMIC) {
-					conn_flow_t flow = CONN_FLOW_REV;
-					struct conn_key key;
-					struct conn *conn;
-
-					// XXX: All returning IP fragments will go to LOCAL
-					// whether they are part of a conntrack or not.
-					// We need reassembly to fix this.
-					if (gr_conn_parse_key(iface, GR_AF_IP4, mbuf, &key)
-					    && (conn = gr_conn_lookup(&key, &flow)) != NULL) {
-						struct conn_mbuf_data *cd = conn_mbuf_data(mbuf);
-						cd->conn = conn;
-						cd->flow = flow;
-						edge = DNAT44_DYNAMIC;
-					}
-				}
-			}
+	// Lookup pass: one bulk FIB lookup per VRF.
+	if (n_lookup > 0)
+		ip4_fib_lookup_burst(n_lookup, vrf_ids, dsts, nhs);
+
+	// Classification pass: dispatch packets according to their next hop.
+	n_lookup = 0;
+	n_conn = 0;
+	for (i = 0; i < nb_objs; i++) {
+		if (edges[i] == FIB_LOOKUP) {
+			edges[i] = ip_input_classify(objs[i], nhs[n_lookup++]);
+			n_conn += edges[i] == CONN_LOOKUP;
 		}
-next:
+	}
+
+	// Conntrack pass: one bulk lookup for all potential NAT replies.
+	if (n_conn > 0)
+		ip_input_conn_lookup(objs, nb_objs, edges);
+
+	// Enqueue packets in their original order.
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		edge = edges[i];
+
 		if (gr_mbuf_is_traced(mbuf)) {
 			struct rte_ipv4_hdr *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
-			*t = *ip;
+			*t = *rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(batch, edge, mbuf);
+	}
+}
+
+static uint16_t
+ip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	// Node streams may grow beyond the graph burst size when multiple
+	// parent nodes enqueue packets. Process them in chunks to bound the
+	// size of the lookup arrays.
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		ip_input_burst(node, &batch, &objs[i], n);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -241,7 +318,10 @@ int gr_rte_log_type;
 struct log_types log_types = STAILQ_HEAD_INITIALIZER(log_types);
 struct node_infos node_infos = STAILQ_HEAD_INITIALIZER(node_infos);
 mock_func(rte_edge_t, gr_node_attach_parent(const char *, const char *));
-mock_func(const struct nexthop *, fib4_lookup(uint16_t, ip4_addr_t));
+void fib4_lookup_bulk(uint16_t, const ip4_addr_t *, const struct nexthop **nhs, unsigned n) {
+	for (unsigned i = 0; i < n; i++)
+		nhs[i] = mock_ptr_type(const struct nexthop *);
+}
 mock_func(void *, gr_mbuf_trace_add(struct rte_mbuf *, struct rte_node *, size_t));
 mock_func(uint16_t, drop_packets(struct rte_graph *, struct rte_node *, void **, uint16_t));
 mock_func(int, drop_format(char *, size_t, const void *, size_t));
@@ -257,7 +337,17 @@ mock_func(
 		struct conn_key *
 	)
 );
-mock_func(struct conn *, gr_conn_lookup(const struct conn_key *, conn_flow_t *));
+void gr_conn_lookup_bulk(
+	const struct conn_key **,
+	struct conn **conns,
+	conn_flow_t *flows,
+	unsigned n
+) {
+	for (unsigned i = 0; i < n; i++) {
+		conns[i] = mock_ptr_type(struct conn *);
+		flows[i] = CONN_FLOW_REV;
+	}
+}
 
 struct fake_mbuf {
 	struct rte_ipv4_hdr ipv4_hdr;
@@ -365,12 +455,12 @@ static void ip_input_conntrack_dnat(void **) {
 	struct nexthop_info_l3 *l3 = (struct nexthop_info_l3 *)nh.info;
 	l3->flags = GR_NH_F_LOCAL;
 	l3->ipv4 = fake_mbuf.ipv4_hdr.dst_addr;
-	will_return(fib4_lookup, &nh);
+	will_return(fib4_lookup_bulk, &nh);
 
 	iface.flags |= GR_IFACE_F_SNAT_DYNAMIC;
 	struct conn conn;
 	will_return(gr_conn_parse_key, true);
-	will_return(gr_conn_lookup, &conn);
+	will_return(gr_conn_lookup_bulk, &conn);
 
 	expect_value(rte_node_enqueue_x1, next, DNAT44_DYNAMIC);
 	ip_input_process(NULL, NULL, &obj, 1);
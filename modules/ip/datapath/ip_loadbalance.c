@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2025 Christophe Fontaine
 
+#include "flow_hash.h"
 #include "graph.h"
 #include "ip4_datapath.h"
 #include "l3.h"
@@ -12,6 +13,18 @@ enum edges {
 	EDGE_COUNT,
 };
 
+enum xstats {
+	XSTAT_SW_HASH = 0,
+	XSTAT_COUNT,
+};
+
+static struct rte_node_xstats lb_xstats = {
+	.nb_xstats = XSTAT_COUNT,
+	.xstat_desc = {
+		[XSTAT_SW_HASH] = "sw_flow_hash",
+	},
+};
+
 static uint16_t ip_loadbalance_process(
 	struct rte_graph *graph,
 	struct rte_node *node,
@@ -19,19 +32,27 @@ static uint16_t ip_loadbalance_process(
 	uint16_t nb_objs
 ) {
 	struct nexthop_info_group *g;
+	struct gr_node_batch batch;
 	struct l3_mbuf_data *d;
 	struct rte_mbuf *mbuf;
+	uint16_t i, sw_hash;
 	rte_edge_t edge;
-	uint16_t i;
 
+	sw_hash = 0;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		d = l3_mbuf_data(mbuf);
 		g = (struct nexthop_info_group *)d->nh->info;
 		edge = OUTPUT;
 
-		// TODO: increment xstat on ! mbuf->ol_flags & RTE_MBUF_F_RX_RSS_HASH
+		if (gr_mbuf_flow_hash_l3(mbuf, RTE_BE16(RTE_ETHER_TYPE_IPV4)))
+			sw_hash++;
 		d->nh = nexthop_group_get_nh(g, mbuf->hash.rss);
+		// Fast reroute when the selected member cannot forward.
+		if (unlikely(g->backup != NULL) && !nh_group_member_usable(d->nh))
+			d->nh = g->backup;
 		if (unlikely(d->nh == NULL)) {
 			edge = NO_NEXTHOP;
 			goto next;
@@ -40,9 +61,14 @@ next:
 		if (gr_mbuf_is_traced(mbuf))
 			gr_mbuf_trace_add(mbuf, node, 0);
 
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
+	if (sw_hash > 0)
+		rte_node_xstat_increment(node, XSTAT_SW_HASH, sw_hash);
+
 	return nb_objs;
 }
 
@@ -54,6 +80,7 @@ static struct rte_node_register ip_lb_node = {
 	.name = "ip_loadbalance",
 	.process = ip_loadbalance_process,
 	.nb_edges = EDGE_COUNT,
+	.xstats = &lb_xstats,
 	.next_nodes = {
 		[OUTPUT] = "ip_output",
 		[NO_NEXTHOP] = "ip_lb_no_nexthop",
@@ -26,11 +26,13 @@ static uint16_t ip_input_local_process(
 	void **objs,
 	uint16_t nb_objs
 ) {
+	struct gr_node_batch batch;
 	struct rte_ipv4_hdr *ip;
 	struct rte_mbuf *mbuf;
 	rte_edge_t edge;
 	uint16_t i;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
@@ -50,9 +52,11 @@ static uint16_t ip_input_local_process(
 			data->ttl = ip->time_to_live;
 			rte_pktmbuf_adj(mbuf, rte_ipv4_hdr_len(ip));
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -40,6 +40,10 @@ void ip_output_register_interface_type(gr_iface_type_t type, const char *next_no
 	iface_type_edges[type] = gr_node_attach_parent("ip_output", next_node);
 }
 
+bool ip_output_iface_type_is_eth(gr_iface_type_t type) {
+	return iface_type_edges[type] == ETH_OUTPUT;
+}
+
 static rte_edge_t nh_type_edges[UINT_NUM_VALUES(gr_nh_type_t)] = {ETH_OUTPUT};
 
 void ip_output_register_nexthop_type(gr_nh_type_t type, const char *next_node) {
@@ -52,100 +56,154 @@ void ip_output_register_nexthop_type(gr_nh_type_t type, const char *next_node) {
 	nh_type_edges[type] = gr_node_attach_parent("ip_output", next_node);
 }
 
-static uint16_t
-ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	struct eth_output_mbuf_data *eth_data;
-	const struct nexthop_info_l3 *l3;
+// Pseudo edge for packets that have an output interface and may need source NAT.
+#define ROUTED ((rte_edge_t)EDGE_COUNT)
+
+#define NAT_FLAGS (GR_IFACE_F_SNAT_STATIC | GR_IFACE_F_SNAT_DYNAMIC)
+
+static inline rte_edge_t ip_output_route(struct rte_mbuf *mbuf) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	const struct nexthop *nh = l3_mbuf_data(mbuf)->nh;
+	const struct nexthop *backup;
 	const struct iface *iface;
-	const struct nexthop *nh;
-	struct rte_ipv4_hdr *ip;
-	struct rte_mbuf *mbuf;
-	uint16_t i, sent;
 	rte_edge_t edge;
 
-	sent = 0;
+	if (nh == NULL)
+		return NO_ROUTE;
 
-	for (i = 0; i < nb_objs; i++) {
-		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	mbuf->packet_type = RTE_PTYPE_L3_IPV4;
 
-		nh = l3_mbuf_data(mbuf)->nh;
-		if (nh == NULL) {
-			edge = NO_ROUTE;
-			goto next;
-		}
+	edge = nh_type_edges[nh->type];
+	if (edge != ETH_OUTPUT)
+		return edge;
 
-		mbuf->packet_type = RTE_PTYPE_L3_IPV4;
+	iface = iface_from_id(nh->iface_id);
+	if (unlikely((backup = nh_fast_reroute(nh, iface)) != NULL)) {
+		l3_mbuf_data(mbuf)->nh = backup;
+		iface = iface_from_id(backup->iface_id);
+	}
+	if (iface == NULL)
+		return ERROR;
 
-		edge = nh_type_edges[nh->type];
-		if (edge != ETH_OUTPUT)
-			goto next;
+	mbuf_data(mbuf)->iface = iface;
 
-		iface = iface_from_id(nh->iface_id);
-		if (iface == NULL) {
-			edge = ERROR;
-			goto next;
-		}
+	if (rte_pktmbuf_pkt_len(mbuf) > iface->mtu) {
+		if (ip->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_DF_FLAG))
+			return FRAG_NEEDED;
+		return FRAGMENT;
+	}
 
-		mbuf_data(mbuf)->iface = iface;
+	return ROUTED;
+}
 
-		if (rte_pktmbuf_pkt_len(mbuf) > iface->mtu) {
-			if (ip->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_DF_FLAG)) {
-				edge = FRAG_NEEDED;
-			} else {
-				edge = FRAGMENT;
-			}
-			goto next;
-		}
+static inline rte_edge_t ip_output_resolve(struct rte_mbuf *mbuf) {
+	struct rte_ipv4_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
+	const struct nexthop *nh = l3_mbuf_data(mbuf)->nh;
+	const struct nexthop_info_l3 *l3 = nexthop_info_l3(nh);
+	struct eth_output_mbuf_data *eth_data;
+
+	if (l3->state != GR_NH_S_REACHABLE
+	    || (l3->flags & GR_NH_F_LINK && ip->dst_addr != l3->ipv4)) {
+		// The nexthop needs ARP resolution or it is associated with
+		// a "connected" route (i.e. matching an address/prefix on
+		// a local interface).
+		//
+		// In the later case, a new nexthop must be created along with
+		// its internal /32 route.
+		//
+		// In both case, the packet must be sent to control plane.
+		return HOLD;
+	}
+
+	// Prepare ethernet layer info.
+	eth_data = eth_output_mbuf_data(mbuf);
+	eth_data->dst = l3->mac;
+	eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
+
+	return ETH_OUTPUT;
+}
 
-		// Determine what is the next node based on the output interface type
-		// By default, it will be eth_output unless another output node was registered.
-		edge = iface_type_edges[iface->type];
-
-		switch (snat44_process(iface, mbuf)) {
-		case NAT_VERDICT_CONTINUE:
-		case NAT_VERDICT_FINAL:
-			break;
-		case NAT_VERDICT_DROP:
-			edge = DROP;
-			break;
+static uint16_t ip_output_burst(
+	struct rte_node *node,
+	struct gr_node_batch *batch,
+	void **objs,
+	uint16_t nb_objs
+) {
+	const struct iface *nat_ifaces[RTE_GRAPH_BURST_SIZE];
+	struct rte_mbuf *nat_mbufs[RTE_GRAPH_BURST_SIZE];
+	nat_verdict_t verdicts[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	const struct iface *iface;
+	struct rte_mbuf *mbuf;
+	uint16_t i, n_nat;
+	uint16_t sent = 0;
+	rte_edge_t edge;
+
+	// Routing pass: resolve output interfaces and collect packets to NAT.
+	n_nat = 0;
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		edges[i] = ip_output_route(mbuf);
+		if (edges[i] == ROUTED && mbuf_data(mbuf)->iface->flags & NAT_FLAGS) {
+			nat_ifaces[n_nat] = mbuf_data(mbuf)->iface;
+			nat_mbufs[n_nat] = mbuf;
+			n_nat++;
 		}
+	}
+
+	// NAT pass: one bulk conntrack lookup for all dynamic NAT packets.
+	if (n_nat > 0)
+		snat44_process_bulk(nat_ifaces, nat_mbufs, verdicts, n_nat);
 
-		if (edge != ETH_OUTPUT)
-			goto next;
-
-		l3 = nexthop_info_l3(nh);
-
-		if (l3->state != GR_NH_S_REACHABLE
-		    || (l3->flags & GR_NH_F_LINK && ip->dst_addr != l3->ipv4)) {
-			// The nexthop needs ARP resolution or it is associated with
-			// a "connected" route (i.e. matching an address/prefix on
-			// a local interface).
-			//
-			// In the later case, a new nexthop must be created along with
-			// its internal /32 route.
-			//
-			// In both case, the packet must be sent to control plane.
-			edge = HOLD;
-			goto next;
+	// Resolve L2 destinations and enqueue packets in their original order.
+	n_nat = 0;
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		edge = edges[i];
+		if (edge == ROUTED) {
+			iface = mbuf_data(mbuf)->iface;
+			// Determine what is the next node based on the output interface type
+			// By default, it will be eth_output unless another output node was
+			// registered.
+			edge = iface_type_edges[iface->type];
+			if (iface->flags & NAT_FLAGS && verdicts[n_nat++] == NAT_VERDICT_DROP)
+				edge = DROP;
+			if (edge == ETH_OUTPUT) {
+				edge = ip_output_resolve(mbuf);
+				if (edge == ETH_OUTPUT)
+					sent++;
+			}
 		}
 
-		// Prepare ethernet layer info.
-		eth_data = eth_output_mbuf_data(mbuf);
-		eth_data->dst = l3->mac;
-		eth_data->ether_type = RTE_BE16(RTE_ETHER_TYPE_IPV4);
-		sent++;
-next:
 		if (gr_mbuf_is_traced(mbuf)) {
 			struct rte_ipv4_hdr *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
-			*t = *ip;
+			*t = *rte_pktmbuf_mtod(mbuf, struct rte_ipv4_hdr *);
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(batch, edge, mbuf);
 	}
 
 	return sent;
 }
 
+static uint16_t
+ip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n, sent;
+
+	sent = 0;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		sent += ip_output_burst(node, &batch, &objs[i], n);
+	}
+
+	gr_node_batch_flush(&batch);
+
+	return sent;
+}
+
 static struct rte_node_register output_node = {
 	.name = "ip_output",
 	.process = ip_output_process,
@@ -20,6 +20,17 @@
 const struct nexthop *
 fib6_lookup(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *ip);
 
+// Lookup n destination addresses in the FIB of the same VRF at once.
+// Link-local addresses are scoped to iface_id like fib6_lookup() does.
+// Unresolved destinations are reported with a NULL nexthop.
+void fib6_lookup_bulk(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	const struct rte_ipv6_addr *ips,
+	const struct nexthop **nhs,
+	unsigned n
+);
+
 static inline const struct rte_ipv6_addr *addr6_linklocal_scope(
 	const struct rte_ipv6_addr *ip,
 	struct rte_ipv6_addr *scoped_ip,
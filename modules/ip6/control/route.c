@@ -33,6 +33,12 @@ static uint64_t route_prefixlens[GR_MAX_IFACES][RTE_IPV6_MAX_DEPTH + 1];
 
 static uint32_t max_routes_default = 1 << 16;
 
+// Extension stored in each RIB node.
+struct rib6_ext {
+	gr_nh_origin_t origin;
+	struct nexthop_route *route; // entry in the reverse index of the nexthop
+};
+
 // Derive num_tbl8 from max_routes for IPv6 TRIE.
 // The trie uses 8-bit levels beyond the first 24 bits. IPv6 routes at
 // /48 consume up to 3 tbl8 groups each. Sharing reduces actual usage
@@ -68,9 +74,9 @@ static struct rte_fib6 *create_fib6(const struct iface *vrf) {
 		.type = RTE_FIB6_TRIE,
 		.default_nh = 0,
 		.max_routes = fib6_get_max_routes(vrf),
-		.rib_ext_sz = sizeof(gr_nh_origin_t),
+		.rib_ext_sz = sizeof(struct rib6_ext),
 		.trie = {
-			.nh_sz = RTE_FIB6_TRIE_8B,
+			.nh_sz = RTE_FIB6_TRIE_4B,
 			.num_tbl8 = fib6_get_num_tbl8(vrf),
 		},
 	};
@@ -120,27 +126,15 @@ static int fib6_init(struct iface *vrf) {
 	return 0;
 }
 
+// rte_fib6 stores 4-byte nexthop values minus one bit which is used to store
+// metadata about the routing table. Store compact nexthop indexes rather than
+// pointers. Index 0 is the default value and resolves to NULL.
 static inline uintptr_t nh_ptr_to_id(const struct nexthop *nh) {
-	uintptr_t id = (uintptr_t)nh;
-
-	// rte_fib6 stores the nexthop ID on 8 bytes minus one bit which is used
-	// to store metadata about the routing table.
-	//
-	// Address mappings in userspace are guaranteed on x86_64 and aarch64
-	// to use at most 47 bits, leaving at least 17 bits of headroom filled
-	// with zeroes.
-	//
-	// rte_fib6_add already checks that the nexthop value does not exceed the
-	// maximum allowed value. For clarity, we explicitly fail if the MSB is
-	// not zero.
-	if (id & GR_BIT64(63))
-		ABORT("MSB is not 0, martian architecture?");
-
-	return id;
+	return nh->idx;
 }
 
 static inline struct nexthop *nh_id_to_ptr(uintptr_t id) {
-	return (struct nexthop *)id;
+	return nexthop_from_idx(id);
 }
 
 const struct nexthop *
@@ -158,7 +152,53 @@ fib6_lookup(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *ip)
 	if (nh_id == 0)
 		return errno_set_null(EHOSTUNREACH);
 
-	return nh_id_to_ptr(nh_id);
+	return nexthop_resolve(nh_id_to_ptr(nh_id));
+}
+
+// Number of addresses scoped on the stack per rte_fib6_lookup_bulk call.
+#define FIB6_LOOKUP_BULK_MAX 64
+
+void fib6_lookup_bulk(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	const struct rte_ipv6_addr *ips,
+	const struct nexthop **nhs,
+	unsigned n
+) {
+	struct rte_ipv6_addr scoped_ips[FIB6_LOOKUP_BULK_MAX];
+	uintptr_t nh_ids[FIB6_LOOKUP_BULK_MAX];
+	struct rte_fib6 *fib6 = get_fib6(vrf_id);
+	const struct rte_ipv6_addr *lookup_ips;
+	struct rte_ipv6_addr tmp;
+	unsigned i, j, len;
+
+	if (fib6 == NULL) {
+		for (i = 0; i < n; i++)
+			nhs[i] = NULL;
+		return;
+	}
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, FIB6_LOOKUP_BULK_MAX);
+		lookup_ips = &ips[i];
+
+		// Only copy the addresses if at least one of them needs scoping.
+		for (j = 0; j < len; j++) {
+			if (rte_ipv6_addr_is_linklocal(&ips[i + j]))
+				break;
+		}
+		if (j < len) {
+			for (j = 0; j < len; j++)
+				scoped_ips[j] = *addr6_linklocal_scope(&ips[i + j], &tmp, iface_id);
+			lookup_ips = scoped_ips;
+		}
+
+		rte_fib6_lookup_bulk(fib6, lookup_ips, nh_ids, len);
+		// nh_id 0 is the default nexthop value, it is translated to NULL.
+		// Recursive nexthops are followed to what they currently resolve to.
+		for (j = 0; j < len; j++)
+			nhs[i + j] = nexthop_resolve(nh_id_to_ptr(nh_ids[j]));
+	}
 }
 
 struct nexthop *rib6_lookup(uint16_t vrf_id, uint16_t iface_id, const struct rte_ipv6_addr *ip) {
@@ -227,10 +267,11 @@ static int rib6_insert_or_replace(
 	struct rte_fib6 *fib = get_fib6(vrf_id);
 	const struct rte_ipv6_addr *scoped_ip;
 	struct nexthop *existing = NULL;
+	struct nexthop_route *route;
 	struct rte_ipv6_addr tmp;
 	struct rte_rib6_node *rn;
+	struct rib6_ext *ext;
 	struct rte_rib6 *rib;
-	gr_nh_origin_t *o;
 	int ret;
 
 	scoped_ip = addr6_linklocal_scope(ip, &tmp, iface_id);
@@ -251,18 +292,35 @@ static int rib6_insert_or_replace(
 			return errno_set(nexthop_equal(nh, existing) ? EEXIST : EBUSY);
 	}
 
-	if ((ret = rte_fib6_add(fib, scoped_ip, prefixlen, nh_ptr_to_id(nh))) < 0)
+	route = nexthop_route_add(
+		nh,
+		&(struct nexthop_route) {
+			.vrf_id = vrf_id,
+			.iface_id = iface_id,
+			.af = GR_AF_IP6,
+			.prefixlen = prefixlen,
+			.ipv6 = *ip,
+		}
+	);
+	if (route == NULL)
+		return -errno;
+
+	if ((ret = rte_fib6_add(fib, scoped_ip, prefixlen, nh_ptr_to_id(nh))) < 0) {
+		nexthop_route_del(nh, route);
 		return errno_set(-ret);
+	}
 
 	rn = rte_rib6_lookup_exact(rib, scoped_ip, prefixlen);
-	o = rte_rib6_get_ext(rn);
+	ext = rte_rib6_get_ext(rn);
 	if (existing) {
-		assert(route_counts[vrf_id][*o] > 0);
-		route_counts[vrf_id][*o]--;
+		assert(route_counts[vrf_id][ext->origin] > 0);
+		route_counts[vrf_id][ext->origin]--;
 		assert(route_prefixlens[vrf_id][prefixlen] > 0);
 		route_prefixlens[vrf_id][prefixlen]--;
+		nexthop_route_del(existing, ext->route);
 	}
-	*o = origin;
+	ext->origin = origin;
+	ext->route = route;
 	route_counts[vrf_id][origin]++;
 	route_prefixlens[vrf_id][prefixlen]++;
 
@@ -305,9 +363,11 @@ int rib6_delete(
 ) {
 	struct rte_fib6 *fib = get_fib6(vrf_id);
 	const struct rte_ipv6_addr *scoped_ip;
-	gr_nh_origin_t *o, origin;
+	struct nexthop_route *route;
+	const struct rib6_ext *ext;
 	struct rte_ipv6_addr tmp;
 	struct rte_rib6_node *rn;
+	gr_nh_origin_t origin;
 	struct nexthop *nh;
 	struct rte_rib6 *rib;
 	uintptr_t nh_id;
@@ -323,8 +383,10 @@ int rib6_delete(
 	if (rn == NULL)
 		return errno_set(ENOENT);
 
-	o = rte_rib6_get_ext(rn);
-	origin = *o;
+	ext = rte_rib6_get_ext(rn);
+	origin = ext->origin;
+	// The node is freed by rte_fib6_delete().
+	route = ext->route;
 	rte_rib6_get_nh(rn, &nh_id);
 	nh = nh_id_to_ptr(nh_id);
 	if (nh->type != nh_type)
@@ -350,6 +412,7 @@ int rib6_delete(
 	assert(route_prefixlens[vrf_id][prefixlen] > 0);
 	route_prefixlens[vrf_id][prefixlen]--;
 
+	nexthop_route_del(nh, route);
 	nexthop_decref(nh);
 
 	return 0;
@@ -371,7 +434,8 @@ static struct api_out route6_add(const void *request, struct api_ctx *) {
 	} else if ((nh = nexthop_lookup_l3(GR_AF_IP6, req->vrf_id, GR_IFACE_ID_UNDEF, &req->nh))
 		   == NULL) {
 		// ensure route gateway is reachable
-		if ((nh = rib6_lookup(req->vrf_id, GR_IFACE_ID_UNDEF, &req->nh)) == NULL)
+		nh = nexthop_resolve(rib6_lookup(req->vrf_id, GR_IFACE_ID_UNDEF, &req->nh));
+		if (nh == NULL)
 			return api_out(EHOSTUNREACH, 0, NULL);
 
 		if (nh->type == GR_NH_T_L3) {
@@ -451,14 +515,14 @@ static struct api_out route6_get(const void *request, struct api_ctx *) {
 }
 
 static int rib6_iter_route(struct rte_rib6_node *rn, uint16_t vrf_id, struct rib6_iterator *iter) {
+	const struct rib6_ext *ext;
 	struct rte_ipv6_addr ip;
-	gr_nh_origin_t *origin;
 	uint8_t prefixlen;
 	uintptr_t nh_id;
 	int ret;
 
-	origin = rte_rib6_get_ext(rn);
-	if (iter->skip_internal && *origin == GR_NH_ORIGIN_INTERNAL)
+	ext = rte_rib6_get_ext(rn);
+	if (iter->skip_internal && ext->origin == GR_NH_ORIGIN_INTERNAL)
 		return 0;
 
 	if (iter->max_count != 0 && iter->count >= iter->max_count)
@@ -468,7 +532,7 @@ static int rib6_iter_route(struct rte_rib6_node *rn, uint16_t vrf_id, struct rib
 	rte_rib6_get_depth(rn, &prefixlen);
 	rte_rib6_get_nh(rn, &nh_id);
 
-	ret = iter->cb(vrf_id, &ip, prefixlen, *origin, nh_id_to_ptr(nh_id), iter->priv);
+	ret = iter->cb(vrf_id, &ip, prefixlen, ext->origin, nh_id_to_ptr(nh_id), iter->priv);
 	if (ret < 0)
 		return ret;
 
@@ -564,11 +628,6 @@ struct rib6_cleanup_entry {
 	gr_nh_type_t type;
 };
 
-struct rib6_cleanup_ctx {
-	const struct nexthop *nh;
-	vec struct rib6_cleanup_entry *entries;
-};
-
 static int rib6_cleanup_cb(
 	uint16_t vrf_id,
 	const struct rte_ipv6_addr *ip,
@@ -577,35 +636,38 @@ static int rib6_cleanup_cb(
 	const struct nexthop *nh,
 	void *priv
 ) {
-	struct rib6_cleanup_ctx *ctx = priv;
-	if (ctx->nh == NULL || nh == ctx->nh) {
-		struct rib6_cleanup_entry entry = {
-			.vrf_id = vrf_id,
-			.iface_id = nh->iface_id,
-			.ip = *ip,
-			.depth = depth,
-			.type = nh->type,
-		};
-		vec_add(ctx->entries, entry);
-	}
+	vec struct rib6_cleanup_entry **entries = priv;
+	struct rib6_cleanup_entry entry = {
+		.vrf_id = vrf_id,
+		.iface_id = nh->iface_id,
+		.ip = *ip,
+		.depth = depth,
+		.type = nh->type,
+	};
+	vec_add(*entries, entry);
 	return 0;
 }
 
 void rib6_cleanup(struct nexthop *nh) {
-	struct rib6_cleanup_ctx ctx = {
-		.nh = nh,
-		.entries = NULL,
-	};
-	struct rib6_iterator iter = {
-		.max_count = 0,
-		.skip_internal = false,
-		.cb = rib6_cleanup_cb,
-		.priv = &ctx,
-	};
-	rib6_iter(GR_VRF_ID_UNDEF, &iter);
-	vec_foreach_ref (const struct rib6_cleanup_entry *r, ctx.entries)
+	vec struct rib6_cleanup_entry *entries = NULL;
+	const struct nexthop_route *route;
+
+	// Deleting routes modifies the reverse index, collect them first.
+	vec_foreach (route, nexthop_routes(nh)) {
+		if (route->af != GR_AF_IP6)
+			continue;
+		struct rib6_cleanup_entry entry = {
+			.vrf_id = route->vrf_id,
+			.iface_id = route->iface_id,
+			.ip = route->ipv6,
+			.depth = route->prefixlen,
+			.type = nh->type,
+		};
+		vec_add(entries, entry);
+	}
+	vec_foreach_ref (const struct rib6_cleanup_entry *r, entries)
 		rib6_delete(r->vrf_id, r->iface_id, &r->ip, r->depth, r->type);
-	vec_free(ctx.entries);
+	vec_free(entries);
 }
 
 METRIC_GAUGE(m_routes, "rib6_routes", "Number of IPv6 routes by origin.");
@@ -694,6 +756,7 @@ static int serialize_route6_event(const void *obj, void **buf) {
 }
 
 struct fib6_migrate_ctx {
+	struct rte_rib6 *old_rib;
 	struct rte_fib6 *new_fib;
 	uint32_t counts[UINT_NUM_VALUES(gr_nh_origin_t)];
 	uint64_t prefixlens[RTE_IPV6_MAX_DEPTH + 1];
@@ -708,8 +771,11 @@ static int fib6_migrate_cb(
 	void *priv
 ) {
 	struct fib6_migrate_ctx *ctx = priv;
+	struct rte_rib6_node *old, *rn;
+	struct rib6_ext *ext;
 	int ret;
 
+	old = rte_rib6_lookup_exact(ctx->old_rib, ip, prefixlen);
 	ret = rte_fib6_add(ctx->new_fib, ip, prefixlen, nh_ptr_to_id(nh));
 	if (ret < 0) {
 		if (nh->type == GR_NH_T_L3 && (nexthop_info_l3(nh)->flags & NH_LOCAL_ADDR_FLAGS)) {
@@ -739,15 +805,16 @@ static int fib6_migrate_cb(
 					}
 				);
 			}
+			ext = rte_rib6_get_ext(old);
+			nexthop_route_del((struct nexthop *)nh, ext->route);
 			nexthop_decref((struct nexthop *)nh);
 		}
 		return 0;
 	}
 
-	struct rte_rib6 *rib = rte_fib6_get_rib(ctx->new_fib);
-	struct rte_rib6_node *rn = rte_rib6_lookup_exact(rib, ip, prefixlen);
-	gr_nh_origin_t *o = rte_rib6_get_ext(rn);
-	*o = origin;
+	rn = rte_rib6_lookup_exact(rte_fib6_get_rib(ctx->new_fib), ip, prefixlen);
+	ext = rte_rib6_get_ext(rn);
+	*ext = *(const struct rib6_ext *)rte_rib6_get_ext(old);
 	ctx->counts[origin]++;
 	ctx->prefixlens[prefixlen]++;
 
@@ -761,6 +828,10 @@ static uint32_t fib6_total_routes(uint16_t vrf_id) {
 	return total;
 }
 
+static void fib6_free(void *fib) {
+	rte_fib6_free(fib);
+}
+
 static int fib6_reconfig(struct iface *vrf) {
 	struct gr_iface_info_vrf_fib *conf = &iface_info_vrf(vrf)->ipv6;
 	struct rte_fib6 *old_fib, *new_fib;
@@ -775,7 +846,10 @@ static int fib6_reconfig(struct iface *vrf) {
 	if (new_fib == NULL)
 		return errno_log(errno, "create_fib6");
 
-	struct fib6_migrate_ctx ctx = {.new_fib = new_fib};
+	struct fib6_migrate_ctx ctx = {
+		.old_rib = rte_fib6_get_rib(old_fib),
+		.new_fib = new_fib,
+	};
 	struct rib6_iterator iter = {
 		.max_count = 0,
 		.skip_internal = false,
@@ -785,8 +859,7 @@ static int fib6_reconfig(struct iface *vrf) {
 	rib6_iter_vrf(rte_fib6_get_rib(old_fib), vrf->id, &iter);
 
 	iface_info_vrf(vrf)->fib6 = new_fib;
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-	rte_fib6_free(old_fib);
+	gr_rcu_defer(fib6_free, old_fib);
 
 	memcpy(route_counts[vrf->id], ctx.counts, sizeof(ctx.counts));
 	memcpy(route_prefixlens[vrf->id], ctx.prefixlens, sizeof(ctx.prefixlens));
@@ -839,21 +912,18 @@ static void fib6_fini(struct iface *vrf) {
 	struct rte_fib6 *fib = iface_info_vrf(vrf)->fib6;
 	if (fib != NULL) {
 		LOG(INFO, "destroying IPv6 FIB for VRF %s(%u)", vrf->name, vrf->id);
-		struct rib6_cleanup_ctx ctx = {
-			.nh = NULL,
-			.entries = NULL,
-		};
+		vec struct rib6_cleanup_entry *entries = NULL;
 		struct rib6_iterator iter = {
 			.max_count = 0,
 			.skip_internal = false,
 			.cb = rib6_cleanup_cb,
-			.priv = &ctx,
+			.priv = &entries,
 		};
 		rib6_iter_vrf(rte_fib6_get_rib(fib), vrf->id, &iter);
 
-		vec_foreach_ref (const struct rib6_cleanup_entry *r, ctx.entries)
+		vec_foreach_ref (const struct rib6_cleanup_entry *r, entries)
 			rib6_delete(r->vrf_id, r->iface_id, &r->ip, r->depth, r->type);
-		vec_free(ctx.entries);
+		vec_free(entries);
 
 		iface_info_vrf(vrf)->fib6 = NULL;
 
@@ -5,6 +5,8 @@
 
 #include "control_queue.h"
 #include "iface.h"
+#include "ip6.h"
+#include "l3.h"
 #include "mbuf.h"
 #include "nexthop.h"
 
@@ -12,6 +14,7 @@
 
 #include <rte_byteorder.h>
 #include <rte_ether.h>
+#include <rte_graph.h>
 #include <rte_ip6.h>
 
 #include <stdint.h>
@@ -49,6 +52,31 @@ static inline void ip6_set_fields(
 	ip->dst_addr = *dst;
 }
 
+static inline void fib6_lookup_scope(
+	uint16_t vrf_id,
+	uint16_t iface_id,
+	const void *dsts,
+	const struct nexthop **nhs,
+	unsigned n
+) {
+	fib6_lookup_bulk(vrf_id, iface_id, dsts, nhs, n);
+}
+
+// Resolve a burst of destination addresses which may belong to different VRFs.
+//
+// iface_ids contains the link-local scope of each address, callers should use
+// GR_IFACE_ID_UNDEF for global addresses to avoid splitting groups needlessly.
+// See fib_lookup_burst().
+static inline void ip6_fib_lookup_burst(
+	uint16_t n,
+	const uint16_t *vrf_ids,
+	const uint16_t *iface_ids,
+	const struct rte_ipv6_addr *dsts,
+	const struct nexthop **nhs
+) {
+	fib_lookup_burst(n, vrf_ids, iface_ids, dsts, sizeof(*dsts), nhs, fib6_lookup_scope);
+}
+
 void ndp_update_nexthop(
 	struct rte_graph *graph,
 	struct rte_node *node,
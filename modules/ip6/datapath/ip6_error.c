@@ -25,6 +25,7 @@ enum edges {
 
 static uint16_t
 ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
 	const struct ip6_error_ctx *ctx = ip6_error_ctx(node);
 	struct icmp6_err_dest_unreach *du;
 	struct icmp6_err_ttl_exceeded *te;
@@ -37,6 +38,7 @@ ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 	struct icmp6 *icmp6;
 	rte_edge_t edge;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
@@ -100,9 +102,11 @@ ip6_error_process(struct rte_graph *graph, struct rte_node *node, void **objs, u
 		d->iface = iface;
 		edge = ICMP_OUTPUT;
 next:
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -12,10 +12,13 @@ enum edges {
 
 static uint16_t
 ip6_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
 	struct rte_ipv6_hdr *ip;
 	struct rte_mbuf *mbuf;
+	rte_edge_t edge;
 	uint16_t i;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
@@ -23,13 +26,16 @@ ip6_forward_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 			gr_mbuf_trace_add(mbuf, node, 0);
 
 		if (ip->hop_limits <= 1) {
-			rte_node_enqueue_x1(graph, node, TTL_EXCEEDED, mbuf);
-			continue;
+			edge = TTL_EXCEEDED;
+		} else {
+			ip->hop_limits -= 1;
+			edge = OUTPUT;
 		}
-		ip->hop_limits -= 1;
-		rte_node_enqueue_x1(graph, node, OUTPUT, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -41,114 +41,174 @@ void ip6_input_register_nexthop_type(gr_nh_type_t type, const char *next_node) {
 	nh_type_edges[type] = gr_node_attach_parent("ip6_input", next_node);
 }
 
-static uint16_t
-ip6_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+// Pseudo edge for packets that passed validation and need a FIB lookup.
+#define FIB_LOOKUP ((rte_edge_t)EDGE_COUNT)
+
+static inline rte_edge_t ip6_input_validate(struct rte_mbuf *mbuf, const struct nexthop **nh) {
+	struct rte_ipv6_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+	struct eth_input_mbuf_data *e = eth_input_mbuf_data(mbuf);
+
+	*nh = NULL;
+
+	if (rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ipv6_hdr)) {
+		// XXX: call rte_pktmuf_data_len is used to ensure that the IPv6 header
+		// is located on the first segment. IPv6 headers located on the second,
+		// third or subsequent segments, as well spanning segment boundaries, are
+		// not currently handled.
+		return BAD_LENGTH;
+	}
+
+	if (rte_ipv6_check_version(ip))
+		return BAD_VERSION;
+
+	if (rte_ipv6_addr_is_mcast(&ip->src_addr) || rte_ipv6_addr_is_unspec(&ip->dst_addr))
+		return BAD_ADDR;
+
+	if (unlikely(rte_ipv6_addr_is_mcast(&ip->dst_addr))) {
+		switch (rte_ipv6_mc_scope(&ip->dst_addr)) {
+		case RTE_IPV6_MC_SCOPE_NONE:
+			// RFC4291 2.7:
+			// Nodes must not originate a packet to a multicast address
+			// whose scope field contains the reserved value 0; if such
+			// a packet is received, it must be silently dropped.
+		case RTE_IPV6_MC_SCOPE_IFACELOCAL:
+			// This should only happen if the input interface is a loopback
+			// interface. For now, we do not have support for these.
+			return BAD_ADDR;
+		default:
+			*nh = mcast6_get_member(e->iface->id, &ip->dst_addr);
+			if (*nh == NULL)
+				return NOT_MEMBER;
+			return LOCAL;
+		}
+	}
+
+	switch (e->domain) {
+	case ETH_DOMAIN_LOOPBACK:
+	case ETH_DOMAIN_LOCAL:
+		// Packet sent to our ethernet address.
+		break;
+	case ETH_DOMAIN_BROADCAST:
+	case ETH_DOMAIN_MULTICAST:
+		// Non unicast ethernet destination. No need for a route lookup.
+		return LOCAL;
+	case ETH_DOMAIN_OTHER:
+	case ETH_DOMAIN_UNKNOWN:
+		// Drop all packets not sent to our ethernet address
+		return OTHER_HOST;
+	}
+
+	return FIB_LOOKUP;
+}
+
+static inline rte_edge_t ip6_input_classify(struct rte_mbuf *mbuf, const struct nexthop *nh) {
+	struct rte_ipv6_hdr *ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
 	const struct nexthop_info_l3 *l3;
-	struct eth_input_mbuf_data *e;
+	rte_edge_t edge;
+
+	if (nh == NULL)
+		return DEST_UNREACH;
+
+	edge = nh_type_edges[nh->type];
+	if (edge != FORWARD)
+		return edge;
+
+	if (eth_input_mbuf_data(mbuf)->domain == ETH_DOMAIN_LOOPBACK) {
+		edge = OUTPUT;
+	} else if (nh->type == GR_NH_T_L3) {
+		// If the resolved next hop is local and the destination IP is ourselves,
+		// send to ip6_local.
+		l3 = nexthop_info_l3(nh);
+		if (l3->flags & GR_NH_F_LOCAL && rte_ipv6_addr_eq(&ip->dst_addr, &l3->ipv6))
+			edge = LOCAL;
+	}
+
+	return edge;
+}
+
+static void
+ip6_input_burst(struct rte_node *node, struct gr_node_batch *batch, void **objs, uint16_t nb_objs) {
+	const struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	struct rte_ipv6_addr dsts[RTE_GRAPH_BURST_SIZE];
+	uint16_t iface_ids[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
 	const struct iface *iface;
 	const struct nexthop *nh;
 	struct rte_ipv6_hdr *ip;
-	struct l3_mbuf_data *d;
 	struct rte_mbuf *mbuf;
+	uint16_t i, n_lookup;
 	rte_edge_t edge;
-	uint16_t i;
 
+	// Validation pass: check headers and collect destinations to resolve.
+	// Multicast destinations are resolved immediately, their nexthop is
+	// stored at the same index in nhs[].
+	n_lookup = 0;
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
-		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
-		e = eth_input_mbuf_data(mbuf);
-		iface = e->iface;
-		nh = NULL;
-
-		if (rte_pktmbuf_data_len(mbuf) < sizeof(struct rte_ipv6_hdr)) {
-			// XXX: call rte_pktmuf_data_len is used to ensure that the IPv6 header
-			// is located on the first segment. IPv6 headers located on the second,
-			// third or subsequent segments, as well spanning segment boundaries, are
-			// not currently handled.
-			edge = BAD_LENGTH;
-			goto next;
+		edges[i] = ip6_input_validate(mbuf, &nhs[i]);
+		if (edges[i] == FIB_LOOKUP) {
+			ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
+			iface = eth_input_mbuf_data(mbuf)->iface;
+			vrf_ids[n_lookup] = iface->vrf_id;
+			if (rte_ipv6_addr_is_linklocal(&ip->dst_addr))
+				iface_ids[n_lookup] = iface->id;
+			else
+				iface_ids[n_lookup] = GR_IFACE_ID_UNDEF;
+			dsts[n_lookup] = ip->dst_addr;
+			n_lookup++;
 		}
+	}
 
-		if (rte_ipv6_check_version(ip)) {
-			edge = BAD_VERSION;
-			goto next;
-		}
+	// Lookup pass: one bulk FIB lookup per VRF.
+	if (n_lookup > 0) {
+		const struct nexthop *lookup_nhs[RTE_GRAPH_BURST_SIZE];
 
-		if (rte_ipv6_addr_is_mcast(&ip->src_addr)
-		    || rte_ipv6_addr_is_unspec(&ip->dst_addr)) {
-			edge = BAD_ADDR;
-			goto next;
-		}
+		ip6_fib_lookup_burst(n_lookup, vrf_ids, iface_ids, dsts, lookup_nhs);
 
-		if (unlikely(rte_ipv6_addr_is_mcast(&ip->dst_addr))) {
-			switch (rte_ipv6_mc_scope(&ip->dst_addr)) {
-			case RTE_IPV6_MC_SCOPE_NONE:
-				// RFC4291 2.7:
-				// Nodes must not originate a packet to a multicast address
-				// whose scope field contains the reserved value 0; if such
-				// a packet is received, it must be silently dropped.
-			case RTE_IPV6_MC_SCOPE_IFACELOCAL:
-				// This should only happen if the input interface is a loopback
-				// interface. For now, we do not have support for these.
-				edge = BAD_ADDR;
-				break;
-			default:
-				nh = mcast6_get_member(iface->id, &ip->dst_addr);
-				if (nh == NULL)
-					edge = NOT_MEMBER;
-				else
-					edge = LOCAL;
-			}
-			goto next;
-		}
-
-		switch (e->domain) {
-		case ETH_DOMAIN_LOOPBACK:
-		case ETH_DOMAIN_LOCAL:
-			// Packet sent to our ethernet address.
-			break;
-		case ETH_DOMAIN_BROADCAST:
-		case ETH_DOMAIN_MULTICAST:
-			// Non unicast ethernet destination. No need for a route lookup.
-			edge = LOCAL;
-			goto next;
-		case ETH_DOMAIN_OTHER:
-		case ETH_DOMAIN_UNKNOWN:
-			// Drop all packets not sent to our ethernet address
-			edge = OTHER_HOST;
-			goto next;
+		n_lookup = 0;
+		for (i = 0; i < nb_objs; i++) {
+			if (edges[i] == FIB_LOOKUP)
+				nhs[i] = lookup_nhs[n_lookup++];
 		}
+	}
 
-		nh = fib6_lookup(iface->vrf_id, iface->id, &ip->dst_addr);
-		if (nh == NULL) {
-			edge = DEST_UNREACH;
-			goto next;
-		}
+	// Classify and enqueue packets in their original order.
+	for (i = 0; i < nb_objs; i++) {
+		mbuf = objs[i];
+		nh = nhs[i];
+		edge = edges[i];
+		if (edge == FIB_LOOKUP)
+			edge = ip6_input_classify(mbuf, nh);
 
-		edge = nh_type_edges[nh->type];
-		if (edge != FORWARD)
-			goto next;
-
-		if (e->domain == ETH_DOMAIN_LOOPBACK) {
-			edge = OUTPUT;
-		} else if (nh->type == GR_NH_T_L3) {
-			// If the resolved next hop is local and the destination IP is ourselves,
-			// send to ip6_local.
-			l3 = nexthop_info_l3(nh);
-			if (l3->flags & GR_NH_F_LOCAL && rte_ipv6_addr_eq(&ip->dst_addr, &l3->ipv6))
-				edge = LOCAL;
-		}
-next:
 		if (gr_mbuf_is_traced(mbuf)) {
 			struct rte_ipv6_hdr *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
-			*t = *ip;
+			*t = *rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
 		}
 		// Store the resolved next hop for ip6_output to avoid a second route lookup.
-		d = l3_mbuf_data(mbuf);
-		d->nh = nh;
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		// This overwrites the eth_input_mbuf_data fields.
+		l3_mbuf_data(mbuf)->nh = nh;
+		gr_node_batch_enqueue(batch, edge, mbuf);
+	}
+}
+
+static uint16_t
+ip6_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	// Node streams may grow beyond the graph burst size when multiple
+	// parent nodes enqueue packets. Process them in chunks to bound the
+	// size of the lookup arrays.
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		ip6_input_burst(node, &batch, &objs[i], n);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -202,7 +262,16 @@ struct log_types log_types = STAILQ_HEAD_INITIALIZER(log_types);
 struct node_infos node_infos = STAILQ_HEAD_INITIALIZER(node_infos);
 
 mock_func(rte_edge_t, gr_node_attach_parent(const char *, const char *));
-mock_func(const struct nexthop *, fib6_lookup(uint16_t, uint16_t, const struct rte_ipv6_addr *));
+void fib6_lookup_bulk(
+	uint16_t,
+	uint16_t,
+	const struct rte_ipv6_addr *,
+	const struct nexthop **nhs,
+	unsigned n
+) {
+	for (unsigned i = 0; i < n; i++)
+		nhs[i] = mock_ptr_type(const struct nexthop *);
+}
 mock_func(void *, gr_mbuf_trace_add(struct rte_mbuf *, struct rte_node *, size_t));
 mock_func(uint16_t, drop_packets(struct rte_graph *, struct rte_node *, void **, uint16_t));
 mock_func(int, drop_format(char *, size_t, const void *, size_t));
@@ -33,12 +33,14 @@ static uint16_t ip6_input_local_process(
 	uint16_t nb_objs
 ) {
 	struct ip6_local_mbuf_data *d;
+	struct gr_node_batch batch;
 	const struct iface *iface;
 	struct rte_ipv6_hdr *ip;
 	struct rte_mbuf *m;
 	rte_edge_t edge;
 	uint16_t i;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		ip = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
@@ -119,9 +121,11 @@ adj_next:
 		rte_pktmbuf_adj(m, d->ext_offset);
 		d->ext_offset = 0;
 next:
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
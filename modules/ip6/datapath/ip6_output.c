@@ -52,8 +52,9 @@ static uint16_t
 ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct eth_output_mbuf_data *eth_data;
 	const struct nexthop_info_l3 *l3;
+	struct gr_node_batch batch;
 	const struct iface *iface;
-	const struct nexthop *nh;
+	const struct nexthop *nh, *backup;
 	struct rte_ipv6_hdr *ip;
 	struct rte_mbuf *mbuf;
 	uint16_t i, sent;
@@ -61,6 +62,7 @@ ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 
 	sent = 0;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 		ip = rte_pktmbuf_mtod(mbuf, struct rte_ipv6_hdr *);
@@ -78,10 +80,15 @@ ip6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 			goto next;
 
 		// For multicast destination, nh->iface will be NULL
-		if (rte_ipv6_addr_is_mcast(&ip->dst_addr))
+		if (rte_ipv6_addr_is_mcast(&ip->dst_addr)) {
 			iface = mbuf_data(mbuf)->iface;
-		else
+		} else {
 			iface = iface_from_id(nh->iface_id);
+			if (unlikely((backup = nh_fast_reroute(nh, iface)) != NULL)) {
+				l3_mbuf_data(mbuf)->nh = nh = backup;
+				iface = iface_from_id(nh->iface_id);
+			}
+		}
 		if (iface == NULL) {
 			edge = ERROR;
 			goto next;
@@ -122,9 +129,11 @@ next:
 			struct rte_ipv6_hdr *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
 			*t = *ip;
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return sent;
 }
 
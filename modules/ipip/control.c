@@ -44,6 +44,37 @@ struct iface *ipip_get_iface(ip4_addr_t local, ip4_addr_t remote, uint16_t vrf_i
 	return data;
 }
 
+void ipip_get_iface_bulk(
+	unsigned n,
+	const ip4_addr_t *locals,
+	const ip4_addr_t *remotes,
+	const uint16_t *vrf_ids,
+	struct iface **ifaces
+) {
+	const void *key_ptrs[RTE_HASH_LOOKUP_BULK_MAX];
+	struct ipip_key keys[RTE_HASH_LOOKUP_BULK_MAX];
+	void *data[RTE_HASH_LOOKUP_BULK_MAX];
+	unsigned i, j, len;
+	uint64_t hits;
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, RTE_HASH_LOOKUP_BULK_MAX);
+
+		for (j = 0; j < len; j++) {
+			keys[j].local = locals[i + j];
+			keys[j].remote = remotes[i + j];
+			keys[j].vrf_id = vrf_ids[i + j];
+			key_ptrs[j] = &keys[j];
+		}
+
+		if (rte_hash_lookup_bulk_data(ipip_hash, key_ptrs, len, &hits, data) < 0)
+			hits = 0;
+
+		for (j = 0; j < len; j++)
+			ifaces[i + j] = hits & GR_BIT64(j) ? data[j] : NULL;
+	}
+}
+
 static int iface_ipip_reconfig(
 	struct iface *iface,
 	uint64_t /*set_attrs*/,
@@ -23,34 +23,46 @@ int trace_ipip_format(char *buf, size_t len, const void *data, size_t /*data_len
 	return snprintf(buf, len, "iface=%s", iface ? iface->name : "[deleted]");
 }
 
-static uint16_t
-ipip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+static void ipip_input_burst(
+	struct gr_node_batch *batch,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface *ifaces[RTE_GRAPH_BURST_SIZE];
+	ip4_addr_t remotes[RTE_GRAPH_BURST_SIZE];
+	ip4_addr_t locals[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	uint16_t keys[RTE_GRAPH_BURST_SIZE];
 	struct eth_input_mbuf_data *eth_data;
 	struct ip_local_mbuf_data *ip_data;
-	ip4_addr_t last_src, last_dst;
 	struct rte_mbuf *mbuf;
-	uint16_t last_vrf_id;
 	struct iface *ipip;
+	uint16_t i, n;
 	rte_edge_t edge;
 
 	IFACE_STATS_VARS(rx);
 
-	ipip = NULL;
-	last_src = 0;
-	last_dst = 0;
-	last_vrf_id = GR_VRF_ID_UNDEF;
+	// Collect distinct consecutive (local, remote, vrf) keys.
+	n = 0;
+	for (i = 0; i < nb_objs; i++) {
+		ip_data = ip_local_mbuf_data(objs[i]);
+		if (n == 0 || locals[n - 1] != ip_data->dst || remotes[n - 1] != ip_data->src
+		    || vrf_ids[n - 1] != ip_data->vrf_id) {
+			locals[n] = ip_data->dst;
+			remotes[n] = ip_data->src;
+			vrf_ids[n] = ip_data->vrf_id;
+			n++;
+		}
+		keys[i] = n - 1;
+	}
+
+	ipip_get_iface_bulk(n, locals, remotes, vrf_ids, ifaces);
 
-	for (uint16_t i = 0; i < nb_objs; i++) {
+	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
-		ip_data = ip_local_mbuf_data(mbuf);
-
-		if (ip_data->dst != last_dst || ip_data->src != last_src
-		    || ip_data->vrf_id != last_vrf_id) {
-			ipip = ipip_get_iface(ip_data->dst, ip_data->src, ip_data->vrf_id);
-			last_dst = ip_data->dst;
-			last_src = ip_data->src;
-			last_vrf_id = ip_data->vrf_id;
-		}
+		ipip = ifaces[keys[i]];
+
 		if (ipip == NULL) {
 			edge = NO_TUNNEL;
 			goto next;
@@ -72,10 +84,25 @@ next:
 			struct trace_ipip_data *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
 			t->iface_id = ipip ? ipip->id : 0;
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(batch, edge, mbuf);
 	}
 
 	IFACE_STATS_FLUSH(rx);
+}
+
+static uint16_t
+ipip_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		ipip_input_burst(&batch, node, &objs[i], n);
+	}
+
+	gr_node_batch_flush(&batch);
 
 	return nb_objs;
 }
@@ -30,12 +30,14 @@ ipip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 	const struct rte_ipv4_hdr *inner;
 	struct l3_mbuf_data *ip_data;
 	struct rte_ipv4_hdr *outer;
+	struct gr_node_batch batch;
 	const struct iface *iface;
 	struct rte_mbuf *mbuf;
 	rte_edge_t edge;
 
 	IFACE_STATS_VARS(tx);
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
@@ -79,11 +81,13 @@ ipip_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 		edge = IP_OUTPUT;
 
 next:
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
 	IFACE_STATS_FLUSH(tx);
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
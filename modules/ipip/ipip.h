@@ -18,6 +18,15 @@ GR_IFACE_INFO(GR_IFACE_TYPE_IPIP, iface_info_ipip, { BASE(gr_iface_info_ipip); }
 
 struct iface *ipip_get_iface(ip4_addr_t local, ip4_addr_t remote, uint16_t vrf_id);
 
+// Lookup multiple IPIP interfaces at once. Interfaces that are not found are set to NULL.
+void ipip_get_iface_bulk(
+	unsigned n,
+	const ip4_addr_t *locals,
+	const ip4_addr_t *remotes,
+	const uint16_t *vrf_ids,
+	struct iface **ifaces
+);
+
 struct trace_ipip_data {
 	uint16_t iface_id;
 };
@@ -16,6 +16,11 @@
 typedef enum : uint16_t {
 	GR_BRIDGE_F_NO_FLOOD = GR_BIT16(0),
 	GR_BRIDGE_F_NO_LEARN = GR_BIT16(1),
+	// Forward registered multicast groups only to members that joined them.
+	GR_BRIDGE_F_MCAST_SNOOPING = GR_BIT16(2),
+	// Remove group members as soon as they send a leave message. Only safe
+	// when there is a single listener per member port.
+	GR_BRIDGE_F_MCAST_FAST_LEAVE = GR_BIT16(3),
 } gr_bridge_flags_t;
 
 #define GR_BRIDGE_MAX_MEMBERS 64
@@ -47,6 +52,11 @@ struct gr_iface_info_bridge {
 #define GR_VXLAN_SET_DST_PORT GR_BIT64(34)
 #define GR_VXLAN_SET_LOCAL GR_BIT64(35)
 #define GR_VXLAN_SET_MAC GR_BIT64(37)
+#define GR_VXLAN_SET_SRC_PORTS GR_BIT64(38)
+
+// Default UDP source port range (RFC 7348 section 5).
+#define GR_VXLAN_SRC_PORT_MIN 49152
+#define GR_VXLAN_SRC_PORT_MAX 65535
 
 // Info structure for GR_IFACE_TYPE_VXLAN interfaces.
 struct gr_iface_info_vxlan {
@@ -55,6 +65,13 @@ struct gr_iface_info_vxlan {
 	uint16_t dst_port; // UDP destination port (default 4789).
 	ip4_addr_t local; // Local VTEP IP address (must be a configured address in encap_vrf_id).
 	struct rte_ether_addr mac; // Default to random address.
+	// UDP source port range. The source port of each packet is chosen in
+	// that range from a hash of the inner Ethernet, IP and L4 headers so
+	// that the underlay can spread flows across ECMP paths and RX queues.
+	// Set both to the same value to use a fixed source port. Default to
+	// GR_VXLAN_SRC_PORT_MIN - GR_VXLAN_SRC_PORT_MAX if both are zero.
+	uint16_t src_port_min;
+	uint16_t src_port_max;
 };
 
 // FDB (L2 Forwarding Database) management /////////////////////////////////////
@@ -87,6 +104,7 @@ enum gr_l2_requests : uint32_t {
 	GR_FLOOD_ADD,
 	GR_FLOOD_DEL,
 	GR_FLOOD_LIST,
+	GR_MDB_LIST,
 };
 
 // Add an FDB entry. The bridge_id is resolved from the member interface's domain.
@@ -136,7 +154,8 @@ struct gr_fdb_config_get_resp {
 GR_REQ(GR_FDB_CONFIG_GET, struct gr_empty, struct gr_fdb_config_get_resp);
 
 // Set FDB subsystem configuration.
-// Changing max_entries requires the FDB to be empty (returns EBUSY otherwise).
+// Changing max_entries migrates existing entries to the new table. Returns ENOSPC
+// if static entries do not fit. Learned entries that do not fit are dropped.
 struct gr_fdb_config_set_req {
 	uint32_t max_entries;
 };
@@ -191,6 +210,26 @@ struct gr_flood_list_req {
 
 GR_REQ_STREAM(GR_FLOOD_LIST, struct gr_flood_list_req, struct gr_flood_entry);
 
+// Multicast database (MDB) populated by IGMP/MLD snooping /////////////////////
+
+// Group membership of a bridge member interface.
+// IPv4 groups are stored as IPv4-mapped IPv6 addresses. Entries with an
+// unspecified group address denote multicast router ports, where IGMP/MLD
+// queries were received. These receive all registered multicast traffic.
+struct gr_mdb_entry {
+	uint16_t bridge_id;
+	uint16_t vlan_id;
+	struct rte_ipv6_addr group;
+	uint16_t iface_id;
+	uint16_t expires; // Seconds before the membership times out.
+};
+
+struct gr_mdb_list_req {
+	uint16_t bridge_id; // GR_IFACE_ID_UNDEF to list all bridges.
+};
+
+GR_REQ_STREAM(GR_MDB_LIST, struct gr_mdb_list_req, struct gr_mdb_entry);
+
 // events //////////////////////////////////////////////////////////////////////
 
 enum gr_l2_events : uint32_t {
@@ -22,9 +22,11 @@ bridge_show(struct gr_api_client *c, const struct gr_iface *iface, struct gr_obj
 		o,
 		"bridge_flags",
 		GR_DISP_STR_ARRAY,
-		"%sflood %slearn",
+		"%sflood %slearn %smcast_snooping %smcast_fast_leave",
 		(bridge->flags & GR_BRIDGE_F_NO_FLOOD) ? "no_" : "",
-		(bridge->flags & GR_BRIDGE_F_NO_LEARN) ? "no_" : ""
+		(bridge->flags & GR_BRIDGE_F_NO_LEARN) ? "no_" : "",
+		(bridge->flags & GR_BRIDGE_F_MCAST_SNOOPING) ? "" : "no_",
+		(bridge->flags & GR_BRIDGE_F_MCAST_FAST_LEAVE) ? "" : "no_"
 	);
 	gr_object_field(o, "ageing_time", GR_DISP_INT, "%u", bridge->ageing_time);
 	gr_object_field(o, "mac", 0, ETH_F, &bridge->mac);
@@ -40,10 +42,12 @@ bridge_list_info(struct gr_api_client *, const struct gr_iface *iface, char *buf
 	snprintf(
 		buf,
 		len,
-		"members=%u %sflood %slearn",
+		"members=%u %sflood %slearn %smcast_snooping %smcast_fast_leave",
 		bridge->n_members,
 		(bridge->flags & GR_BRIDGE_F_NO_FLOOD) ? "no_" : "",
-		(bridge->flags & GR_BRIDGE_F_NO_LEARN) ? "no_" : ""
+		(bridge->flags & GR_BRIDGE_F_NO_LEARN) ? "no_" : "",
+		(bridge->flags & GR_BRIDGE_F_MCAST_SNOOPING) ? "" : "no_",
+		(bridge->flags & GR_BRIDGE_F_MCAST_FAST_LEAVE) ? "" : "no_"
 	);
 }
 
@@ -78,6 +82,20 @@ static uint64_t parse_bridge_args(
 		bridge->flags |= GR_BRIDGE_F_NO_LEARN;
 		set_attrs |= GR_BRIDGE_SET_FLAGS;
 	}
+	if (arg_str(p, "mcast_snooping")) {
+		bridge->flags |= GR_BRIDGE_F_MCAST_SNOOPING;
+		set_attrs |= GR_BRIDGE_SET_FLAGS;
+	} else if (arg_str(p, "no_mcast_snooping")) {
+		bridge->flags &= ~GR_BRIDGE_F_MCAST_SNOOPING;
+		set_attrs |= GR_BRIDGE_SET_FLAGS;
+	}
+	if (arg_str(p, "mcast_fast_leave")) {
+		bridge->flags |= GR_BRIDGE_F_MCAST_FAST_LEAVE;
+		set_attrs |= GR_BRIDGE_SET_FLAGS;
+	} else if (arg_str(p, "no_mcast_fast_leave")) {
+		bridge->flags &= ~GR_BRIDGE_F_MCAST_FAST_LEAVE;
+		set_attrs |= GR_BRIDGE_SET_FLAGS;
+	}
 
 	if (arg_u16(p, "AGE", &bridge->ageing_time) == 0)
 		set_attrs |= GR_BRIDGE_SET_AGEING_TIME;
@@ -145,7 +163,8 @@ out:
 	return ret;
 }
 
-#define BRIDGE_ATTRS_CMD IFACE_ATTRS_CMD ",(ageing_time AGE),(mac MAC),FLOOD,LEARN"
+#define BRIDGE_ATTRS_CMD                                                                           \
+	IFACE_ATTRS_CMD ",(ageing_time AGE),(mac MAC),FLOOD,LEARN,MCAST_SNOOPING,MCAST_FAST_LEAVE"
 
 #define BRIDGE_ATTRS_ARGS                                                                          \
 	IFACE_ATTRS_ARGS,                                                                          \
@@ -168,6 +187,28 @@ out:
 			"LEARN",                                                                   \
 			with_help("Enable MAC learning.", ec_node_str("learn", "learn")),          \
 			with_help("Disable MAC learning.", ec_node_str("no_learn", "no_learn"))    \
+		),                                                                                 \
+		EC_NODE_OR(                                                                        \
+			"MCAST_SNOOPING",                                                          \
+			with_help(                                                                 \
+				"Enable IGMP/MLD snooping.",                                       \
+				ec_node_str("mcast_snooping", "mcast_snooping")                    \
+			),                                                                         \
+			with_help(                                                                 \
+				"Disable IGMP/MLD snooping.",                                      \
+				ec_node_str("no_mcast_snooping", "no_mcast_snooping")              \
+			)                                                                          \
+		),                                                                                 \
+		EC_NODE_OR(                                                                        \
+			"MCAST_FAST_LEAVE",                                                        \
+			with_help(                                                                 \
+				"Remove group members immediately when they leave.",               \
+				ec_node_str("mcast_fast_leave", "mcast_fast_leave")                \
+			),                                                                         \
+			with_help(                                                                 \
+				"Expire group members after the last member query time.",          \
+				ec_node_str("no_mcast_fast_leave", "no_mcast_fast_leave")          \
+			)                                                                          \
 		)
 
 static int ctx_init(struct ec_node *root) {
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "cli.h"
+#include "cli_iface.h"
+#include "display.h"
+
+#include <gr_api.h>
+#include <gr_l2.h>
+#include <gr_net_types.h>
+
+#include <ecoli.h>
+
+#include <string.h>
+
+static cmd_status_t mdb_show(struct gr_api_client *c, const struct ec_pnode *p) {
+	struct gr_mdb_list_req req = {.bridge_id = GR_IFACE_ID_UNDEF};
+	const struct gr_mdb_entry *mdb;
+	ip4_addr_t group4;
+	int ret;
+
+	if (arg_str(p, "BRIDGE") != NULL) {
+		if (arg_iface(c, p, "BRIDGE", GR_IFACE_TYPE_BRIDGE, &req.bridge_id) < 0)
+			return CMD_ERROR;
+	}
+
+	struct gr_table *table = gr_table_new();
+	gr_table_column(table, "BRIDGE", GR_DISP_LEFT); // 0
+	gr_table_column(table, "VLAN", GR_DISP_RIGHT | GR_DISP_INT); // 1
+	gr_table_column(table, "GROUP", GR_DISP_LEFT); // 2
+	gr_table_column(table, "IFACE", GR_DISP_LEFT); // 3
+	gr_table_column(table, "EXPIRES", GR_DISP_RIGHT | GR_DISP_INT); // 4
+
+	gr_api_client_stream_foreach (mdb, ret, c, GR_MDB_LIST, sizeof(req), &req) {
+		gr_table_cell(table, 0, "%s", iface_name_from_id(c, mdb->bridge_id));
+
+		if (mdb->vlan_id != 0)
+			gr_table_cell(table, 1, "%u", mdb->vlan_id);
+
+		if (rte_ipv6_addr_is_unspec(&mdb->group)) {
+			gr_table_cell(table, 2, "router");
+		} else if (rte_ipv6_addr_is_v4mapped(&mdb->group)) {
+			memcpy(&group4, &mdb->group.a[12], sizeof(group4));
+			gr_table_cell(table, 2, IP4_F, &group4);
+		} else {
+			gr_table_cell(table, 2, IP6_F, &mdb->group);
+		}
+
+		gr_table_cell(table, 3, "%s", iface_name_from_id(c, mdb->iface_id));
+		gr_table_cell(table, 4, "%u", mdb->expires);
+
+		if (gr_table_print_row(table) < 0)
+			break;
+	}
+
+	gr_table_free(table);
+
+	return ret < 0 ? CMD_ERROR : CMD_SUCCESS;
+}
+
+#define MDB_CTX(root)                                                                              \
+	CLI_CONTEXT(root, CTX_ARG("mdb", "Multicast group database populated by snooping."))
+
+static int ctx_init(struct ec_node *root) {
+	int ret;
+
+	ret = CLI_COMMAND(
+		MDB_CTX(root),
+		"[show] [bridge BRIDGE]",
+		mdb_show,
+		"Show multicast group memberships.",
+		with_help(
+			"Show only groups on this bridge.",
+			ec_node_dyn("BRIDGE", complete_iface_names, INT2PTR(GR_IFACE_TYPE_BRIDGE))
+		)
+	);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
+static struct cli_context ctx = {
+	.name = "mdb",
+	.init = ctx_init,
+};
+
+static void __attribute__((constructor, used)) init(void) {
+	cli_context_register(&ctx);
+}
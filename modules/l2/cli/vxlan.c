@@ -20,6 +20,8 @@ static void vxlan_show(struct gr_api_client *c, const struct gr_iface *iface, st
 	gr_object_field(o, "local", 0, IP4_F, &vxlan->local);
 	gr_object_field(o, "encap_vrf", 0, "%s", iface_name_from_id(c, vxlan->encap_vrf_id));
 	gr_object_field(o, "dst_port", GR_DISP_INT, "%u", vxlan->dst_port);
+	gr_object_field(o, "src_port_min", GR_DISP_INT, "%u", vxlan->src_port_min);
+	gr_object_field(o, "src_port_max", GR_DISP_INT, "%u", vxlan->src_port_max);
 	gr_object_field(o, "mac", 0, ETH_F, &vxlan->mac);
 }
 
@@ -84,6 +86,15 @@ static uint64_t parse_vxlan_args(
 		set_attrs |= GR_VXLAN_SET_DST_PORT;
 	}
 
+	if (arg_u16(p, "SRC_PORT_MIN", &vxlan->src_port_min) < 0) {
+		if (errno != ENOENT)
+			return 0;
+	} else if (arg_u16(p, "SRC_PORT_MAX", &vxlan->src_port_max) < 0) {
+		return 0;
+	} else {
+		set_attrs |= GR_VXLAN_SET_SRC_PORTS;
+	}
+
 	if (arg_eth_addr(p, "MAC", &vxlan->mac) < 0) {
 		if (errno != ENOENT)
 			return 0;
@@ -146,7 +157,9 @@ out:
 	return ret;
 }
 
-#define VXLAN_ATTRS_CMD "(encap_vrf ENCAP_VRF),(mac MAC),(dst_port DST_PORT)"
+#define VXLAN_ATTRS_CMD                                                                            \
+	"(encap_vrf ENCAP_VRF),(mac MAC),(dst_port DST_PORT),"                                     \
+	"(src_ports SRC_PORT_MIN SRC_PORT_MAX)"
 
 #define VXLAN_ATTRS_ARGS                                                                           \
 	IFACE_ATTRS_ARGS,                                                                          \
@@ -163,6 +176,14 @@ out:
 		with_help(                                                                         \
 			"UDP destination port (default 4789).",                                    \
 			ec_node_uint("DST_PORT", 1, 65535, 10)                                     \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Lowest UDP source port for flow entropy (default 49152).",                \
+			ec_node_uint("SRC_PORT_MIN", 1, 65535, 10)                                 \
+		),                                                                                 \
+		with_help(                                                                         \
+			"Highest UDP source port for flow entropy (default 65535).",               \
+			ec_node_uint("SRC_PORT_MAX", 1, 65535, 10)                                 \
 		)
 
 static int ctx_init(struct ec_node *root) {
@@ -74,6 +74,7 @@ static int bridge_detach_member(struct iface *bridge, struct iface *member) {
 			member->domain_id = GR_IFACE_ID_UNDEF;
 			member->mode = GR_IFACE_MODE_VRF;
 			fdb_purge_iface(member->id);
+			mdb_purge_iface(member->id);
 			break;
 		}
 	}
@@ -96,6 +97,7 @@ static int bridge_fini(struct iface *iface) {
 	}
 
 	fdb_purge_bridge(iface->id);
+	mdb_purge_bridge(iface->id);
 
 	return 0;
 }
@@ -11,7 +11,13 @@
 #include <gr_clock.h>
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include <stdatomic.h>
 
 LOG_TYPE("fdb");
 
@@ -21,18 +27,197 @@ struct fdb_key {
 	struct rte_ether_addr mac;
 };
 
+// Entries are allocated from the pool of the table they are inserted in and
+// returned to it when deleted. The hash and its pool are published together,
+// datapath workers load the table pointer only once per operation.
+struct fdb_table {
+	struct rte_hash *hash;
+	struct rte_mempool *pool;
+};
+
 static unsigned fdb_max_entries;
-static struct rte_hash *fdb_hash;
-static struct rte_mempool *fdb_pool;
+static _Atomic(struct fdb_table *) fdb_current;
+static unsigned fdb_gen;
+
+// Keys deleted while replaced tables are waiting for the end of their grace
+// period. Their entries must not be copied back from a replaced table. Only
+// accessed by the control plane, it exists while fdb_retiring > 0.
+static struct rte_hash *fdb_tombstones;
+static unsigned fdb_retiring;
+
+// Per-lcore direct-mapped cache of recently learned source addresses.
+//
+// A source address that was learned (or refreshed) by the same lcore on the
+// same interface less than FDB_LEARN_CACHE_MS ago is not looked up again. This
+// avoids a hash lookup, a clock read and a shared cache line write per packet.
+// The last_seen timestamp of busy entries is refreshed at most once per period
+// and per lcore, which is negligible compared to bridge ageing times.
+//
+// Whenever an entry is removed from the FDB or moves to another interface, all
+// caches are invalidated so that the address is learned again immediately.
+
+#define FDB_LEARN_CACHE_SLOTS 256 // must be a power of two
+#define FDB_LEARN_CACHE_MS 100
+
+struct fdb_learn_slot {
+	struct fdb_key key;
+	uint16_t iface_id;
+	ip4_addr_t vtep;
+	uint64_t refreshed;
+};
+
+struct fdb_learn_cache {
+	unsigned gen;
+	uint64_t period;
+	struct fdb_learn_slot slots[FDB_LEARN_CACHE_SLOTS];
+};
+
+static struct fdb_learn_cache *learn_caches[RTE_MAX_LCORE];
+static atomic_uint learn_gen;
+
+static inline void fdb_learn_cache_invalidate(void) {
+	atomic_fetch_add_explicit(&learn_gen, 1, memory_order_release);
+}
+
+// Datapath workers may still have the address in their cache until the entry
+// is reclaimed. Invalidate them now so that it is learned again immediately.
+static int fdb_del_key(const void *key) {
+	int ret = rte_hash_del_key(fdb_current->hash, key);
+	if (ret >= 0) {
+		fdb_learn_cache_invalidate();
+		if (fdb_tombstones != NULL && rte_hash_add_key(fdb_tombstones, key) < 0)
+			LOG(NOTICE, "too many deleted entries, they may be restored");
+	}
+	return ret;
+}
+
+static bool fdb_deleted(const struct fdb_key *key) {
+	return fdb_tombstones != NULL && rte_hash_lookup(fdb_tombstones, key) >= 0;
+}
+
+static struct rte_hash *fdb_tombstones_create(unsigned max_entries) {
+	struct rte_hash_parameters params = {
+		.name = "fdb-tombstones",
+		.socket_id = SOCKET_ID_ANY,
+		.key_len = sizeof(struct fdb_key),
+		.entries = max_entries,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_EXT_TABLE,
+	};
+	struct rte_hash *h = rte_hash_create(&params);
+	if (h == NULL)
+		return errno_log_null(rte_errno, "rte_hash_create");
+	return h;
+}
+
+// Entries of a replaced table whose interface has since been removed from
+// the bridge (or the bridge itself destroyed) must not be copied back.
+static bool fdb_orphaned(const struct gr_fdb_entry *fdb) {
+	const struct iface *iface = iface_from_id(fdb->iface_id);
+	const struct iface *bridge = iface_from_id(fdb->bridge_id);
+
+	return iface == NULL || bridge == NULL || bridge->type != GR_IFACE_TYPE_BRIDGE
+		|| iface->domain_id != bridge->id;
+}
 
 static void fdb_free_entry(void *pool, void *fdb) {
 	event_push(GR_EVENT_FDB_DEL, fdb);
 	rte_mempool_put(pool, fdb);
 }
 
+// Copy entries from one table to another. Entries that already exist in the
+// destination table may be in use by datapath workers, only their last_seen
+// timestamp is refreshed. When catching up with a replaced table, entries that
+// were deleted from the destination table after it was swapped in are skipped.
+// Returns the number of entries that could not be copied.
+static unsigned fdb_copy(
+	struct rte_hash *src,
+	struct rte_hash *h,
+	struct rte_mempool *p,
+	bool learned,
+	bool catch_up
+) {
+	const struct gr_fdb_entry *fdb;
+	struct gr_fdb_entry *copy;
+	unsigned dropped = 0;
+	uint32_t next = 0;
+	const void *key;
+	void *data;
+
+	while (rte_hash_iterate(src, &key, &data, &next) >= 0) {
+		fdb = data;
+		if (!(fdb->flags & GR_FDB_F_LEARN) != !learned)
+			continue;
+
+		if (rte_hash_lookup_data(h, key, &data) >= 0) {
+			// Already copied. Its location may have been updated by
+			// datapath workers since, it is more recent.
+			copy = data;
+			if (fdb->last_seen > copy->last_seen)
+				copy->last_seen = fdb->last_seen;
+			continue;
+		}
+
+		if (catch_up) {
+			// Their deletion has already been notified.
+			if (fdb_deleted(key))
+				continue;
+			if (fdb_orphaned(fdb)) {
+				event_push(GR_EVENT_FDB_DEL, fdb);
+				continue;
+			}
+		}
+
+		if (rte_mempool_get(p, &data) == 0) {
+			copy = data;
+			*copy = *fdb;
+			if (rte_hash_add_key_data(h, key, copy) == 0)
+				continue;
+			rte_mempool_put(p, copy);
+		}
+
+		dropped++;
+		if (catch_up)
+			event_push(GR_EVENT_FDB_DEL, fdb);
+	}
+
+	return dropped;
+}
+
+static void fdb_pool_free(void *pool) {
+	rte_mempool_free(pool);
+}
+
+// Called once datapath workers have stopped using a replaced table.
+static void fdb_table_retire(void *priv) {
+	struct fdb_table *cur = fdb_current;
+	struct fdb_table *old = priv;
+	unsigned dropped;
+
+	if (cur != NULL) {
+		// Catch up with addresses learned and refreshed by datapath
+		// workers in the previous table since the first copy.
+		dropped = fdb_copy(old->hash, cur->hash, cur->pool, true, true);
+		if (dropped > 0)
+			LOG(NOTICE, "%u learned entries did not fit in the new table", dropped);
+		fdb_learn_cache_invalidate();
+	}
+
+	if (--fdb_retiring == 0) {
+		rte_hash_free(fdb_tombstones);
+		fdb_tombstones = NULL;
+	}
+
+	// Deleted entries of the old table are returned to its pool when the
+	// table is freed. Release the pool only after that.
+	gr_rcu_hash_free(old->hash);
+	gr_rcu_defer(fdb_pool_free, old->pool);
+	free(old);
+}
+
 static int fdb_reconfig(unsigned max_entries) {
-	char name[64];
-	snprintf(name, sizeof(name), "fdb-%u", max_entries);
+	char name[RTE_MEMPOOL_NAMESIZE];
+	// Replaced tables are freed after a grace period, names must not be reused.
+	snprintf(name, sizeof(name), "fdb-%u-%u", max_entries, fdb_gen++);
 
 	struct rte_hash_parameters params = {
 		.name = name,
@@ -65,27 +250,50 @@ static int fdb_reconfig(unsigned max_entries) {
 		return errno_log(rte_errno, "rte_mempool_create");
 	}
 
-	struct rte_hash_rcu_config conf = {
-		.v = gr_datapath_rcu(),
-		.mode = RTE_HASH_QSBR_MODE_SYNC,
-		.free_key_data_func = fdb_free_entry,
-		.key_data_ptr = p,
-	};
-	if (rte_hash_rcu_qsbr_add(h, &conf) < 0) {
+	if (gr_rcu_hash_attach(h, fdb_free_entry, p) < 0) {
 		rte_hash_free(h);
 		rte_mempool_free(p);
-		return errno_log(rte_errno, "rte_hash_rcu_qsbr_add");
+		return errno_log(errno, "gr_rcu_hash_attach");
+	}
+
+	struct fdb_table *old = fdb_current;
+	if (old != NULL) {
+		// Migrate existing entries before the new table becomes visible.
+		// Static entries first, they must all fit.
+		if (fdb_copy(old->hash, h, p, false, false) > 0) {
+			// Nothing was deleted from the new table, its pool is unused.
+			gr_rcu_hash_free(h);
+			rte_mempool_free(p);
+			return errno_set(ENOSPC);
+		}
+		fdb_copy(old->hash, h, p, true, false);
+	}
+
+	if (old != NULL && fdb_tombstones == NULL) {
+		fdb_tombstones = fdb_tombstones_create(max_entries);
+		if (fdb_tombstones == NULL) {
+			gr_rcu_hash_free(h);
+			rte_mempool_free(p);
+			return -errno;
+		}
 	}
 
-	struct rte_hash *tmp_h = fdb_hash;
-	struct rte_mempool *tmp_p = fdb_pool;
-	fdb_hash = h;
-	fdb_pool = p;
+	struct fdb_table *t = malloc(sizeof(*t));
+	if (t == NULL) {
+		gr_rcu_hash_free(h);
+		rte_mempool_free(p);
+		return errno_set(ENOMEM);
+	}
+	t->hash = h;
+	t->pool = p;
 
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), rte_lcore_id());
+	atomic_store_explicit(&fdb_current, t, memory_order_release);
+	fdb_learn_cache_invalidate();
 
-	rte_hash_free(tmp_h);
-	rte_mempool_free(tmp_p);
+	if (old != NULL) {
+		fdb_retiring++;
+		gr_rcu_defer(fdb_table_retire, old);
+	}
 
 	fdb_max_entries = max_entries;
 
@@ -94,43 +302,71 @@ static int fdb_reconfig(unsigned max_entries) {
 
 const struct gr_fdb_entry *
 fdb_lookup(uint16_t bridge_id, const struct rte_ether_addr *mac, uint16_t vlan_id) {
+	const struct fdb_table *t = atomic_load_explicit(&fdb_current, memory_order_acquire);
 	const struct fdb_key key = {bridge_id, vlan_id, *mac};
 	void *data;
 
-	if (rte_hash_lookup_data(fdb_hash, &key, &data) < 0)
+	if (rte_hash_lookup_data(t->hash, &key, &data) < 0)
 		return errno_set_null(ENOENT);
 
 	return data;
 }
 
-// Learn a new FDB entry or refresh its last_seen timestamp.
-void fdb_learn(
-	uint16_t bridge_id,
-	uint16_t iface_id,
-	const struct rte_ether_addr *mac,
-	uint16_t vlan_id,
-	ip4_addr_t vtep
+void fdb_lookup_bulk(
+	unsigned n,
+	const uint16_t *bridge_ids,
+	const struct rte_ether_addr *const *macs,
+	const uint16_t *vlan_ids,
+	const struct gr_fdb_entry **fdbs
 ) {
-	const struct fdb_key key = {bridge_id, vlan_id, *mac};
+	const struct fdb_table *t = atomic_load_explicit(&fdb_current, memory_order_acquire);
+	struct fdb_key keys[RTE_HASH_LOOKUP_BULK_MAX];
+	const void *key_ptrs[RTE_HASH_LOOKUP_BULK_MAX];
+	void *data[RTE_HASH_LOOKUP_BULK_MAX];
+	unsigned i, j, len;
+	uint64_t hits;
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, RTE_HASH_LOOKUP_BULK_MAX);
+
+		for (j = 0; j < len; j++) {
+			keys[j].bridge_id = bridge_ids[i + j];
+			keys[j].vlan_id = vlan_ids[i + j];
+			keys[j].mac = *macs[i + j];
+			key_ptrs[j] = &keys[j];
+		}
+
+		if (rte_hash_lookup_bulk_data(t->hash, key_ptrs, len, &hits, data) < 0)
+			hits = 0;
+
+		for (j = 0; j < len; j++)
+			fdbs[i + j] = hits & GR_BIT64(j) ? data[j] : NULL;
+	}
+}
+
+static bool fdb_learn_slow(const struct fdb_key *key, uint16_t iface_id, ip4_addr_t vtep) {
+	// The entry must be allocated from the pool of the table it is inserted
+	// in, even if the table is replaced concurrently.
+	const struct fdb_table *t = atomic_load_explicit(&fdb_current, memory_order_acquire);
 	struct gr_fdb_entry *fdb;
 	void *data;
 
-	if (rte_hash_lookup_data(fdb_hash, &key, &data) < 0) {
-		if (rte_mempool_get(fdb_pool, &data) < 0)
-			return; // pool exhausted
+	if (rte_hash_lookup_data(t->hash, key, &data) < 0) {
+		if (rte_mempool_get(t->pool, &data) < 0)
+			return false; // pool exhausted
 
 		fdb = data;
-		fdb->bridge_id = bridge_id;
-		fdb->vlan_id = vlan_id;
-		fdb->mac = *mac;
+		fdb->bridge_id = key->bridge_id;
+		fdb->vlan_id = key->vlan_id;
+		fdb->mac = key->mac;
 		fdb->flags = GR_FDB_F_LEARN;
 		fdb->iface_id = iface_id;
 		fdb->vtep = vtep;
 
-		if (rte_hash_add_key_data(fdb_hash, &key, fdb) < 0) {
+		if (rte_hash_add_key_data(t->hash, key, fdb) < 0) {
 			// no space left in hash
-			rte_mempool_put(fdb_pool, fdb);
-			return;
+			rte_mempool_put(t->pool, fdb);
+			return false;
 		}
 
 		event_push(GR_EVENT_FDB_ADD, fdb);
@@ -144,8 +380,56 @@ void fdb_learn(
 		// update in case the mac address has moved
 		fdb->iface_id = iface_id;
 		fdb->vtep = vtep;
+		// other lcores may have cached the previous location
+		fdb_learn_cache_invalidate();
 		event_push(GR_EVENT_FDB_UPDATE, fdb);
 	}
+
+	return true;
+}
+
+// Learn a new FDB entry or refresh its last_seen timestamp.
+void fdb_learn(
+	uint16_t bridge_id,
+	uint16_t iface_id,
+	const struct rte_ether_addr *mac,
+	uint16_t vlan_id,
+	ip4_addr_t vtep
+) {
+	const struct fdb_key key = {bridge_id, vlan_id, *mac};
+	struct fdb_learn_slot *slot = NULL;
+	struct fdb_learn_cache *cache;
+	unsigned lcore_id, gen;
+	uint64_t now = 0;
+	uint32_t idx;
+
+	lcore_id = rte_lcore_id();
+	cache = lcore_id < RTE_MAX_LCORE ? learn_caches[lcore_id] : NULL;
+
+	if (likely(cache != NULL)) {
+		gen = atomic_load_explicit(&learn_gen, memory_order_acquire);
+		if (unlikely(cache->gen != gen)) {
+			memset(cache->slots, 0, sizeof(cache->slots));
+			cache->gen = gen;
+		}
+		idx = rte_hash_crc(&key, sizeof(key), 0) & (FDB_LEARN_CACHE_SLOTS - 1);
+		slot = &cache->slots[idx];
+		now = rte_rdtsc();
+		if (slot->iface_id == iface_id && slot->vtep == vtep
+		    && now - slot->refreshed < cache->period
+		    && memcmp(&slot->key, &key, sizeof(key)) == 0)
+			return;
+	}
+
+	if (!fdb_learn_slow(&key, iface_id, vtep))
+		return;
+
+	if (slot != NULL) {
+		slot->key = key;
+		slot->iface_id = iface_id;
+		slot->vtep = vtep;
+		slot->refreshed = now;
+	}
 }
 
 void fdb_purge_iface(uint16_t iface_id) {
@@ -154,10 +438,10 @@ void fdb_purge_iface(uint16_t iface_id) {
 	const void *key;
 	void *data;
 
-	while (rte_hash_iterate(fdb_hash, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(fdb_current->hash, &key, &data, &next) >= 0) {
 		fdb = data;
 		if (fdb->iface_id == iface_id) {
-			rte_hash_del_key(fdb_hash, key);
+			fdb_del_key(key);
 		}
 	}
 }
@@ -168,10 +452,10 @@ void fdb_purge_bridge(uint16_t bridge_id) {
 	const void *key;
 	void *data;
 
-	while (rte_hash_iterate(fdb_hash, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(fdb_current->hash, &key, &data, &next) >= 0) {
 		fdb = data;
 		if (fdb->bridge_id == bridge_id) {
-			rte_hash_del_key(fdb_hash, key);
+			fdb_del_key(key);
 		}
 	}
 }
@@ -199,8 +483,8 @@ static struct api_out fdb_add(const void *request, struct api_ctx *) {
 
 	const struct fdb_key key = {iface->id, req->fdb.vlan_id, req->fdb.mac};
 
-	if (rte_hash_lookup_data(fdb_hash, &key, &data) < 0) {
-		if ((ret = rte_mempool_get(fdb_pool, &data)) < 0)
+	if (rte_hash_lookup_data(fdb_current->hash, &key, &data) < 0) {
+		if ((ret = rte_mempool_get(fdb_current->pool, &data)) < 0)
 			return api_out(-ret, 0, NULL);
 
 		e = data;
@@ -208,8 +492,8 @@ static struct api_out fdb_add(const void *request, struct api_ctx *) {
 		e->bridge_id = iface->id;
 		e->last_seen = gr_clock_us();
 
-		if ((ret = rte_hash_add_key_data(fdb_hash, &key, data)) < 0) {
-			rte_mempool_put(fdb_pool, e);
+		if ((ret = rte_hash_add_key_data(fdb_current->hash, &key, data)) < 0) {
+			rte_mempool_put(fdb_current->pool, e);
 			return api_out(-ret, 0, NULL);
 		}
 
@@ -233,7 +517,7 @@ static struct api_out fdb_del(const void *request, struct api_ctx *) {
 	const struct fdb_key key = {req->bridge_id, req->vlan_id, req->mac};
 	int ret;
 
-	ret = rte_hash_del_key(fdb_hash, &key);
+	ret = fdb_del_key(&key);
 	if (ret == -ENOENT && req->missing_ok)
 		ret = 0;
 	else if (ret > 0)
@@ -271,11 +555,11 @@ static struct api_out fdb_flush(const void *request, struct api_ctx *) {
 	void *data;
 	int ret;
 
-	while (rte_hash_iterate(fdb_hash, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(fdb_current->hash, &key, &data, &next) >= 0) {
 		if (!fdb_match(data, req->flags, req->bridge_id, req->iface_id, &req->mac))
 			continue;
 
-		ret = rte_hash_del_key(fdb_hash, key);
+		ret = fdb_del_key(key);
 		if (ret < 0)
 			return api_out(-ret, 0, NULL);
 	}
@@ -290,7 +574,7 @@ static struct api_out fdb_list(const void *request, struct api_ctx *ctx) {
 	const void *key;
 	void *data;
 
-	while (rte_hash_iterate(fdb_hash, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(fdb_current->hash, &key, &data, &next) >= 0) {
 		if (!fdb_match(data, req->flags, req->bridge_id, req->iface_id, NULL))
 			continue;
 
@@ -308,7 +592,7 @@ static struct api_out fdb_config_get(const void * /*request*/, struct api_ctx *)
 		return api_out(ENOMEM, 0, NULL);
 
 	resp->max_entries = fdb_max_entries;
-	resp->used_entries = rte_hash_count(fdb_hash);
+	resp->used_entries = rte_hash_count(fdb_current->hash);
 
 	return api_out(0, sizeof(*resp), resp);
 }
@@ -320,9 +604,6 @@ static struct api_out fdb_config_set(const void *request, struct api_ctx *) {
 		return api_out(EINVAL, 0, NULL);
 
 	if (req->max_entries != fdb_max_entries) {
-		if (rte_hash_count(fdb_hash) > 0)
-			return api_out(EBUSY, 0, NULL);
-
 		if (fdb_reconfig(req->max_entries) < 0)
 			return api_out(errno, 0, NULL);
 
@@ -344,7 +625,7 @@ static void fdb_ageing_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
 
 	now = gr_clock_us();
 
-	while (rte_hash_iterate(fdb_hash, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(fdb_current->hash, &key, &data, &next) >= 0) {
 		fdb = data;
 
 		if ((fdb->flags & GR_FDB_F_STATIC) || !(fdb->flags & GR_FDB_F_LEARN))
@@ -366,12 +647,29 @@ static void fdb_ageing_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
 			    fdb->bridge_id,
 			    fdb->iface_id,
 			    age);
-			rte_hash_del_key(fdb_hash, key);
+			fdb_del_key(key);
 		}
 	}
 }
 
 static struct event *ageing_timer;
+static void *lcore_cb_handle;
+
+static int fdb_lcore_init(unsigned lcore_id, void *) {
+	learn_caches[lcore_id] = rte_zmalloc_socket(
+		__func__, sizeof(*learn_caches[lcore_id]), RTE_CACHE_LINE_SIZE, rte_socket_id()
+	);
+	if (learn_caches[lcore_id] == NULL)
+		return errno_log(ENOMEM, "rte_zmalloc_socket(fdb_learn_cache)");
+	learn_caches[lcore_id]->gen = atomic_load(&learn_gen);
+	learn_caches[lcore_id]->period = rte_get_tsc_hz() * FDB_LEARN_CACHE_MS / 1000;
+	return 0;
+}
+
+static void fdb_lcore_fini(unsigned lcore_id, void *) {
+	rte_free(learn_caches[lcore_id]);
+	learn_caches[lcore_id] = NULL;
+}
 
 #define FDB_DEFAULT_MAX_ENTRIES 4096
 
@@ -385,19 +683,32 @@ static void fdb_init(struct event_base *base) {
 
 	if (event_add(ageing_timer, &(struct timeval) {.tv_sec = 1}) < 0)
 		ABORT("event_add() failed");
+
+	lcore_cb_handle = rte_lcore_callback_register("fdb", fdb_lcore_init, fdb_lcore_fini, NULL);
+	if (lcore_cb_handle == NULL)
+		ABORT("rte_lcore_callback_register(fdb)");
 }
 
 static void fdb_fini(struct event_base *) {
+	rte_lcore_callback_unregister(lcore_cb_handle);
+	lcore_cb_handle = NULL;
+
 	if (ageing_timer != NULL)
 		event_free(ageing_timer);
 
-	rte_hash_free(fdb_hash);
-	rte_mempool_free(fdb_pool);
+	struct fdb_table *t = fdb_current;
+	fdb_current = NULL;
+	gr_rcu_hash_free(t->hash);
+	gr_rcu_defer_flush();
+	rte_mempool_free(t->pool);
+	free(t);
+	rte_hash_free(fdb_tombstones);
+	fdb_tombstones = NULL;
 }
 
 static struct module module = {
 	.name = "fdb",
-	.depends_on = "rcu",
+	.depends_on = "rcu_defer",
 	.init = fdb_init,
 	.fini = fdb_fini,
 };
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "control_queue.h"
 #include "iface.h"
 #include "module.h"
 
@@ -27,7 +28,17 @@ GR_IFACE_INFO(GR_IFACE_TYPE_BRIDGE, iface_info_bridge, {
 const struct gr_fdb_entry *
 fdb_lookup(uint16_t bridge_id, const struct rte_ether_addr *, uint16_t vlan_id);
 
+// Lookup multiple FDB entries at once. Entries that are not found are set to NULL.
+void fdb_lookup_bulk(
+	unsigned n,
+	const uint16_t *bridge_ids,
+	const struct rte_ether_addr *const *macs,
+	const uint16_t *vlan_ids,
+	const struct gr_fdb_entry **fdbs
+);
+
 // Learn a new FDB entry or refresh its last_seen timestamp.
+// Addresses recently learned by the calling lcore are not looked up again.
 void fdb_learn(
 	uint16_t bridge_id,
 	uint16_t iface_id,
@@ -42,6 +53,27 @@ void fdb_purge_iface(uint16_t iface_id);
 // Delete all FDB entries referencing the provided bridge.
 void fdb_purge_bridge(uint16_t bridge_id);
 
+// Members of a multicast group snooped on a bridge.
+struct mdb_entry {
+	uint16_t n_ifaces;
+	uint16_t ifaces[GR_BRIDGE_MAX_MEMBERS];
+	clock_t expires[GR_BRIDGE_MAX_MEMBERS];
+};
+
+// Lookup the members of a multicast group. An unspecified group address
+// returns the multicast router ports.
+const struct mdb_entry *
+mdb_lookup(uint16_t bridge_id, uint16_t vlan_id, const struct rte_ipv6_addr *group);
+
+// Process an IGMP or MLD packet snooped by bridge_input.
+void mdb_snoop_cb(void *obj, uintptr_t priv, const struct control_queue_drain *);
+
+// Delete all group memberships of the provided interface.
+void mdb_purge_iface(uint16_t iface_id);
+
+// Delete all groups of the provided bridge.
+void mdb_purge_bridge(uint16_t bridge_id);
+
 struct vxlan_template {
 	struct rte_ipv4_hdr ip;
 	struct rte_udp_hdr udp;
@@ -52,6 +84,7 @@ GR_IFACE_INFO(GR_IFACE_TYPE_VXLAN, iface_info_vxlan, {
 	BASE(gr_iface_info_vxlan);
 
 	struct vxlan_template template;
+	uint32_t src_port_range; // src_port_max - src_port_min + 1
 
 	uint16_t n_flood_vteps;
 	ip4_addr_t *flood_vteps;
@@ -59,6 +92,14 @@ GR_IFACE_INFO(GR_IFACE_TYPE_VXLAN, iface_info_vxlan, {
 
 struct iface *vxlan_get_iface(rte_be32_t vni, uint16_t encap_vrf_id);
 
+// Lookup multiple VXLAN interfaces at once. Interfaces that are not found are set to NULL.
+void vxlan_get_iface_bulk(
+	unsigned n,
+	const rte_be32_t *vnis,
+	const uint16_t *encap_vrf_ids,
+	struct iface **ifaces
+);
+
 // Flood list type callbacks, registered per gr_flood_t.
 struct flood_type_ops {
 	gr_flood_type_t type;
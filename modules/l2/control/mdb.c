@@ -0,0 +1,535 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) 2026 Robin Jarry
+
+#include "iface.h"
+#include "l2.h"
+#include "log.h"
+#include "mbuf.h"
+#include "module.h"
+#include "rcu.h"
+#include "rxtx.h"
+
+#include <gr_clock.h>
+
+#include <event2/event.h>
+#include <rte_ether.h>
+#include <rte_hash.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+
+#include <netinet/in.h>
+#include <stdatomic.h>
+
+LOG_TYPE("mdb");
+
+// IGMP/MLD snooping (RFC 4541).
+//
+// IGMP and MLD packets received on bridges with GR_BRIDGE_F_MCAST_SNOOPING are
+// flooded as usual and a copy is sent here via the control queue. Reports add
+// the ingress interface to the group members. Leave/done messages and version
+// 3/2 reports that exclude all sources shorten its membership to the last
+// member query time. The querier sends group specific queries when it receives
+// a leave, other listeners on the same port refresh the membership by replying.
+// With GR_BRIDGE_F_MCAST_FAST_LEAVE, the member is removed immediately.
+// Queries mark the ingress interface as a multicast router port.
+//
+// Group members are stored in place in hash entries. Datapath workers may see
+// a membership list that is being updated but never a freed entry.
+
+#define MDB_MAX_ENTRIES 4096
+#define MDB_MEMBERSHIP_TIMEOUT 260 // robustness * query interval + response time
+#define MDB_ROUTER_TIMEOUT 255 // other querier present interval
+#define MDB_LAST_MEMBER_TIMEOUT 2 // last member query count * interval
+
+struct mdb_key {
+	uint16_t bridge_id;
+	uint16_t vlan_id;
+	struct rte_ipv6_addr group;
+};
+
+static struct rte_hash *mdb_hash;
+
+const struct mdb_entry *
+mdb_lookup(uint16_t bridge_id, uint16_t vlan_id, const struct rte_ipv6_addr *group) {
+	const struct mdb_key key = {bridge_id, vlan_id, *group};
+	void *data;
+
+	if (rte_hash_lookup_data(mdb_hash, &key, &data) < 0)
+		return NULL;
+
+	return data;
+}
+
+static void mdb_join(const struct mdb_key *key, uint16_t iface_id, unsigned timeout) {
+	struct mdb_entry *e;
+	void *data;
+
+	if (rte_hash_lookup_data(mdb_hash, key, &data) < 0) {
+		e = rte_zmalloc(__func__, sizeof(*e), RTE_CACHE_LINE_SIZE);
+		if (e == NULL) {
+			LOG(ERR, "rte_zmalloc: %s", rte_strerror(rte_errno));
+			return;
+		}
+		if (rte_hash_add_key_data(mdb_hash, key, e) < 0) {
+			LOG(NOTICE, "rte_hash_add_key_data: %s", rte_strerror(rte_errno));
+			rte_free(e);
+			return;
+		}
+		LOG(DEBUG,
+		    "bridge=%u vlan=%u group=" IP6_F ": new",
+		    key->bridge_id,
+		    key->vlan_id,
+		    &key->group);
+	} else {
+		e = data;
+	}
+
+	for (uint16_t i = 0; i < e->n_ifaces; i++) {
+		if (e->ifaces[i] == iface_id) {
+			e->expires[i] = gr_clock_us() + timeout * CLOCKS_PER_SEC;
+			return;
+		}
+	}
+
+	if (e->n_ifaces == ARRAY_DIM(e->ifaces))
+		return;
+
+	e->ifaces[e->n_ifaces] = iface_id;
+	e->expires[e->n_ifaces] = gr_clock_us() + timeout * CLOCKS_PER_SEC;
+	// ensure n_ifaces is incremented *after* ifaces is updated
+	atomic_thread_fence(memory_order_release);
+	e->n_ifaces++;
+}
+
+// Returns true if the entry was freed along with its last member.
+static bool mdb_entry_del_member(const void *key, struct mdb_entry *e, uint16_t i) {
+	e->ifaces[i] = e->ifaces[e->n_ifaces - 1];
+	e->expires[i] = e->expires[e->n_ifaces - 1];
+	e->n_ifaces--;
+	if (e->n_ifaces > 0)
+		return false;
+	rte_hash_del_key(mdb_hash, key);
+	return true;
+}
+
+static void mdb_leave(const struct mdb_key *key, uint16_t iface_id) {
+	const struct iface *bridge = iface_from_id(key->bridge_id);
+	struct mdb_entry *e;
+	clock_t expires;
+	void *data;
+
+	if (rte_hash_lookup_data(mdb_hash, key, &data) < 0)
+		return;
+
+	e = data;
+	for (uint16_t i = 0; i < e->n_ifaces; i++) {
+		if (e->ifaces[i] != iface_id)
+			continue;
+		if (bridge != NULL
+		    && iface_info_bridge(bridge)->flags & GR_BRIDGE_F_MCAST_FAST_LEAVE) {
+			mdb_entry_del_member(key, e, i);
+			return;
+		}
+		// Other listeners may remain behind this port.
+		expires = gr_clock_us() + MDB_LAST_MEMBER_TIMEOUT * CLOCKS_PER_SEC;
+		if (e->expires[i] > expires)
+			e->expires[i] = expires;
+		return;
+	}
+}
+
+void mdb_purge_iface(uint16_t iface_id) {
+	struct mdb_entry *e;
+	uint32_t next = 0;
+	const void *key;
+	void *data;
+
+	while (rte_hash_iterate(mdb_hash, &key, &data, &next) >= 0) {
+		e = data;
+		for (uint16_t i = 0; i < e->n_ifaces; i++) {
+			if (e->ifaces[i] == iface_id) {
+				mdb_entry_del_member(key, e, i);
+				break;
+			}
+		}
+	}
+}
+
+void mdb_purge_bridge(uint16_t bridge_id) {
+	const struct mdb_key *k;
+	uint32_t next = 0;
+	const void *key;
+	void *data;
+
+	while (rte_hash_iterate(mdb_hash, &key, &data, &next) >= 0) {
+		k = key;
+		if (k->bridge_id == bridge_id)
+			rte_hash_del_key(mdb_hash, key);
+	}
+}
+
+// IGMP and MLD messages ///////////////////////////////////////////////////////
+
+#define IGMP_MEMBERSHIP_QUERY 0x11
+#define IGMP_V1_MEMBERSHIP_REPORT 0x12
+#define IGMP_V2_MEMBERSHIP_REPORT 0x16
+#define IGMP_V2_LEAVE_GROUP 0x17
+#define IGMP_V3_MEMBERSHIP_REPORT 0x22
+
+// Group record types (RFC 3376 section 4.2.12, RFC 3810 section 5.2.12).
+#define MODE_IS_INCLUDE 1
+#define MODE_IS_EXCLUDE 2
+#define CHANGE_TO_INCLUDE_MODE 3
+#define CHANGE_TO_EXCLUDE_MODE 4
+#define ALLOW_NEW_SOURCES 5
+
+struct igmp_hdr {
+	uint8_t type;
+	uint8_t max_resp_time;
+	rte_be16_t cksum;
+	ip4_addr_t group;
+} __attribute__((packed));
+
+struct igmpv3_report {
+	uint8_t type;
+	uint8_t reserved1;
+	rte_be16_t cksum;
+	rte_be16_t reserved2;
+	rte_be16_t n_records;
+} __attribute__((packed));
+
+struct igmpv3_record {
+	uint8_t type;
+	uint8_t aux_len; // in 32-bit words
+	rte_be16_t n_sources;
+	ip4_addr_t group;
+} __attribute__((packed));
+
+struct mldv1_hdr {
+	uint8_t type;
+	uint8_t code;
+	rte_be16_t cksum;
+	rte_be16_t max_delay;
+	rte_be16_t reserved;
+	struct rte_ipv6_addr group;
+} __attribute__((packed));
+
+struct mldv2_report {
+	uint8_t type;
+	uint8_t code;
+	rte_be16_t cksum;
+	rte_be16_t reserved;
+	rte_be16_t n_records;
+} __attribute__((packed));
+
+struct mldv2_record {
+	uint8_t type;
+	uint8_t aux_len; // in 32-bit words
+	rte_be16_t n_sources;
+	struct rte_ipv6_addr group;
+} __attribute__((packed));
+
+#define MLD_LISTENER_QUERY 130
+#define MLD_LISTENER_REPORT 131
+#define MLD_LISTENER_DONE 132
+#define MLD_V2_LISTENER_REPORT 143
+
+// Returns true if the record means that there is at least one listener.
+static inline bool record_is_join(uint8_t type, uint16_t n_sources) {
+	switch (type) {
+	case MODE_IS_EXCLUDE:
+	case CHANGE_TO_EXCLUDE_MODE:
+		return true;
+	case MODE_IS_INCLUDE:
+	case CHANGE_TO_INCLUDE_MODE:
+	case ALLOW_NEW_SOURCES:
+		return n_sources > 0;
+	}
+	return false;
+}
+
+static inline bool record_is_leave(uint8_t type, uint16_t n_sources) {
+	return (type == MODE_IS_INCLUDE || type == CHANGE_TO_INCLUDE_MODE) && n_sources == 0;
+}
+
+static inline bool mdb_group4(ip4_addr_t group, struct rte_ipv6_addr *out) {
+	// 224.0.0.0/24 is always flooded, see bridge_input.
+	if (!ip4_addr_is_mcast(group)
+	    || (group & RTE_BE32(0xffffff00)) == RTE_BE32(RTE_IPV4(224, 0, 0, 0)))
+		return false;
+	*out = (struct rte_ipv6_addr)RTE_IPV6_ADDR_UNSPEC;
+	out->a[10] = 0xff;
+	out->a[11] = 0xff;
+	memcpy(&out->a[12], &group, sizeof(group));
+	return true;
+}
+
+static inline bool mdb_group6(const struct rte_ipv6_addr *group, struct rte_ipv6_addr *out) {
+	// Scopes up to link-local are always flooded, see bridge_input.
+	if (!rte_ipv6_addr_is_mcast(group) || (group->a[1] & 0x0f) <= 2)
+		return false;
+	*out = *group;
+	return true;
+}
+
+static void igmp_input(struct mdb_key *key, uint16_t iface_id, const void *data, uint32_t len) {
+	const struct igmpv3_report *report;
+	const struct igmpv3_record *rec;
+	const struct igmp_hdr *igmp;
+	uint16_t n_records, n_sources;
+	uint32_t off;
+
+	if (len < sizeof(*igmp))
+		return;
+	igmp = data;
+
+	switch (igmp->type) {
+	case IGMP_MEMBERSHIP_QUERY:
+		key->group = (struct rte_ipv6_addr)RTE_IPV6_ADDR_UNSPEC;
+		mdb_join(key, iface_id, MDB_ROUTER_TIMEOUT);
+		break;
+	case IGMP_V1_MEMBERSHIP_REPORT:
+	case IGMP_V2_MEMBERSHIP_REPORT:
+		if (mdb_group4(igmp->group, &key->group))
+			mdb_join(key, iface_id, MDB_MEMBERSHIP_TIMEOUT);
+		break;
+	case IGMP_V2_LEAVE_GROUP:
+		if (mdb_group4(igmp->group, &key->group))
+			mdb_leave(key, iface_id);
+		break;
+	case IGMP_V3_MEMBERSHIP_REPORT:
+		report = data;
+		n_records = rte_be_to_cpu_16(report->n_records);
+		off = sizeof(*report);
+		for (uint16_t r = 0; r < n_records; r++) {
+			if (off + sizeof(*rec) > len)
+				break;
+			rec = RTE_PTR_ADD(data, off);
+			n_sources = rte_be_to_cpu_16(rec->n_sources);
+			off += sizeof(*rec) + n_sources * sizeof(ip4_addr_t) + rec->aux_len * 4;
+			if (!mdb_group4(rec->group, &key->group))
+				continue;
+			if (record_is_join(rec->type, n_sources))
+				mdb_join(key, iface_id, MDB_MEMBERSHIP_TIMEOUT);
+			else if (record_is_leave(rec->type, n_sources))
+				mdb_leave(key, iface_id);
+		}
+		break;
+	}
+}
+
+static void mld_input(struct mdb_key *key, uint16_t iface_id, const void *data, uint32_t len) {
+	const struct mldv2_report *report;
+	const struct mldv2_record *rec;
+	const struct mldv1_hdr *mld;
+	uint16_t n_records, n_sources;
+	uint32_t off;
+
+	if (len < sizeof(*report))
+		return;
+	mld = data;
+
+	switch (mld->type) {
+	case MLD_LISTENER_QUERY:
+		key->group = (struct rte_ipv6_addr)RTE_IPV6_ADDR_UNSPEC;
+		mdb_join(key, iface_id, MDB_ROUTER_TIMEOUT);
+		break;
+	case MLD_LISTENER_REPORT:
+		if (len >= sizeof(*mld) && mdb_group6(&mld->group, &key->group))
+			mdb_join(key, iface_id, MDB_MEMBERSHIP_TIMEOUT);
+		break;
+	case MLD_LISTENER_DONE:
+		if (len >= sizeof(*mld) && mdb_group6(&mld->group, &key->group))
+			mdb_leave(key, iface_id);
+		break;
+	case MLD_V2_LISTENER_REPORT:
+		report = data;
+		n_records = rte_be_to_cpu_16(report->n_records);
+		off = sizeof(*report);
+		for (uint16_t r = 0; r < n_records; r++) {
+			if (off + sizeof(*rec) > len)
+				break;
+			rec = RTE_PTR_ADD(data, off);
+			n_sources = rte_be_to_cpu_16(rec->n_sources);
+			off += sizeof(*rec) + n_sources * sizeof(struct rte_ipv6_addr)
+				+ rec->aux_len * 4;
+			if (!mdb_group6(&rec->group, &key->group))
+				continue;
+			if (record_is_join(rec->type, n_sources))
+				mdb_join(key, iface_id, MDB_MEMBERSHIP_TIMEOUT);
+			else if (record_is_leave(rec->type, n_sources))
+				mdb_leave(key, iface_id);
+		}
+		break;
+	}
+}
+
+void mdb_snoop_cb(void *obj, uintptr_t, const struct control_queue_drain *drain) {
+	const struct rte_ether_hdr *eth;
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_ipv4_hdr *ip;
+	const struct iface *bridge;
+	struct rte_mbuf *m = obj;
+	const struct iface *iface;
+	struct mdb_key key;
+	uint32_t len, off;
+	const uint8_t *ext;
+
+	iface = mbuf_data(m)->iface;
+
+	// Check if packet references deleted interface.
+	if (drain && drain->event == GR_EVENT_IFACE_REMOVE && iface == drain->obj)
+		goto out;
+	if (iface->mode != GR_IFACE_MODE_BRIDGE)
+		goto out;
+	bridge = iface_from_id(iface->domain_id);
+	if (drain && drain->event == GR_EVENT_IFACE_REMOVE && bridge == drain->obj)
+		goto out;
+	if (bridge == NULL || !(iface_info_bridge(bridge)->flags & GR_BRIDGE_F_MCAST_SNOOPING))
+		goto out;
+
+	key.bridge_id = bridge->id;
+	key.vlan_id = iface_mbuf_data(m)->vlan_id;
+
+	eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+	len = rte_pktmbuf_data_len(m);
+	off = sizeof(*eth);
+
+	switch (eth->ether_type) {
+	case RTE_BE16(RTE_ETHER_TYPE_IPV4):
+		if (len < off + sizeof(*ip))
+			goto out;
+		ip = rte_pktmbuf_mtod_offset(m, const struct rte_ipv4_hdr *, off);
+		off += rte_ipv4_hdr_len(ip);
+		if (ip->next_proto_id != IPPROTO_IGMP || len < off)
+			goto out;
+		igmp_input(&key, iface->id, rte_pktmbuf_mtod_offset(m, void *, off), len - off);
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_IPV6):
+		if (len < off + sizeof(*ip6) + 8)
+			goto out;
+		ip6 = rte_pktmbuf_mtod_offset(m, const struct rte_ipv6_hdr *, off);
+		off += sizeof(*ip6);
+		// MLD messages are always sent with a hop-by-hop router alert option.
+		ext = rte_pktmbuf_mtod_offset(m, const uint8_t *, off);
+		if (ip6->proto != IPPROTO_HOPOPTS || ext[0] != IPPROTO_ICMPV6)
+			goto out;
+		off += (ext[1] + 1) * 8;
+		if (len < off)
+			goto out;
+		mld_input(&key, iface->id, rte_pktmbuf_mtod_offset(m, void *, off), len - off);
+		break;
+	}
+out:
+	rte_pktmbuf_free(m);
+}
+
+static struct api_out mdb_list(const void *request, struct api_ctx *ctx) {
+	const struct gr_mdb_list_req *req = request;
+	const struct mdb_entry *e;
+	const struct mdb_key *k;
+	uint32_t next = 0;
+	const void *key;
+	clock_t now;
+	void *data;
+
+	now = gr_clock_us();
+
+	while (rte_hash_iterate(mdb_hash, &key, &data, &next) >= 0) {
+		k = key;
+		e = data;
+		if (req->bridge_id != GR_IFACE_ID_UNDEF && k->bridge_id != req->bridge_id)
+			continue;
+
+		for (uint16_t i = 0; i < e->n_ifaces; i++) {
+			struct gr_mdb_entry entry = {
+				.bridge_id = k->bridge_id,
+				.vlan_id = k->vlan_id,
+				.group = k->group,
+				.iface_id = e->ifaces[i],
+				.expires = e->expires[i] > now
+					? (e->expires[i] - now) / CLOCKS_PER_SEC
+					: 0,
+			};
+			api_send(ctx, sizeof(entry), &entry);
+		}
+	}
+
+	return api_out(0, 0, NULL);
+}
+
+static void mdb_ageing_cb(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct mdb_entry *e;
+	uint32_t next = 0;
+	const void *key;
+	clock_t now;
+	void *data;
+
+	now = gr_clock_us();
+
+	while (rte_hash_iterate(mdb_hash, &key, &data, &next) >= 0) {
+		e = data;
+		for (uint16_t i = 0; i < e->n_ifaces;) {
+			if (e->expires[i] > now)
+				i++;
+			else if (mdb_entry_del_member(key, e, i))
+				break;
+		}
+	}
+}
+
+static void mdb_free_entry(void *, void *e) {
+	rte_free(e);
+}
+
+static struct event *ageing_timer;
+
+static void mdb_init(struct event_base *base) {
+	struct rte_hash_parameters params = {
+		.name = "mdb",
+		.socket_id = SOCKET_ID_ANY,
+		.key_len = sizeof(struct mdb_key),
+		.entries = MDB_MAX_ENTRIES,
+		.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF
+			| RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT,
+	};
+	mdb_hash = rte_hash_create(&params);
+	if (mdb_hash == NULL)
+		ABORT("rte_hash_create(mdb): %s", rte_strerror(rte_errno));
+
+	if (gr_rcu_hash_attach(mdb_hash, mdb_free_entry, NULL) < 0)
+		ABORT("gr_rcu_hash_attach(mdb): %s", rte_strerror(errno));
+
+	ageing_timer = event_new(base, -1, EV_PERSIST | EV_FINALIZE, mdb_ageing_cb, NULL);
+	if (ageing_timer == NULL)
+		ABORT("event_new() failed");
+
+	if (event_add(ageing_timer, &(struct timeval) {.tv_sec = 1}) < 0)
+		ABORT("event_add() failed");
+}
+
+static void mdb_fini(struct event_base *) {
+	const void *key;
+	uint32_t next = 0;
+	void *data;
+
+	if (ageing_timer != NULL)
+		event_free(ageing_timer);
+
+	while (rte_hash_iterate(mdb_hash, &key, &data, &next) >= 0)
+		rte_free(data);
+	gr_rcu_hash_free(mdb_hash);
+	gr_rcu_defer_flush();
+}
+
+static struct module module = {
+	.name = "mdb",
+	.depends_on = "rcu_defer",
+	.init = mdb_init,
+	.fini = mdb_fini,
+};
+
+RTE_INIT(init) {
+	api_handler(GR_MDB_LIST, mdb_list);
+	module_register(&module);
+}
@@ -41,6 +41,35 @@ struct iface *vxlan_get_iface(rte_be32_t vni, uint16_t encap_vrf_id) {
 	return data;
 }
 
+void vxlan_get_iface_bulk(
+	unsigned n,
+	const rte_be32_t *vnis,
+	const uint16_t *encap_vrf_ids,
+	struct iface **ifaces
+) {
+	const void *key_ptrs[RTE_HASH_LOOKUP_BULK_MAX];
+	struct vxlan_key keys[RTE_HASH_LOOKUP_BULK_MAX];
+	void *data[RTE_HASH_LOOKUP_BULK_MAX];
+	unsigned i, j, len;
+	uint64_t hits;
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, RTE_HASH_LOOKUP_BULK_MAX);
+
+		for (j = 0; j < len; j++) {
+			keys[j].vni = vnis[i + j];
+			keys[j].vrf_id = encap_vrf_ids[i + j];
+			key_ptrs[j] = &keys[j];
+		}
+
+		if (rte_hash_lookup_bulk_data(vxlan_hash, key_ptrs, len, &hits, data) < 0)
+			hits = 0;
+
+		for (j = 0; j < len; j++)
+			ifaces[i + j] = hits & GR_BIT64(j) ? data[j] : NULL;
+	}
+}
+
 static int iface_vxlan_reconfig(
 	struct iface *iface,
 	uint64_t set_attrs,
@@ -142,6 +171,22 @@ static int iface_vxlan_reconfig(
 		conf_done |= GR_VXLAN_SET_MAC;
 	}
 
+	if (set_attrs & GR_VXLAN_SET_SRC_PORTS) {
+		uint16_t min = next->src_port_min;
+		uint16_t max = next->src_port_max;
+		if (min == 0 && max == 0) {
+			min = GR_VXLAN_SRC_PORT_MIN;
+			max = GR_VXLAN_SRC_PORT_MAX;
+		}
+		if (min == 0 || min > max) {
+			errno = ERANGE;
+			goto err;
+		}
+		cur->src_port_min = min;
+		cur->src_port_max = max;
+		conf_done |= GR_VXLAN_SET_SRC_PORTS;
+	}
+
 	// Update the datapath template from the current config.
 	cur->template.ip.version_ihl = IPV4_VERSION_IHL;
 	cur->template.ip.time_to_live = IPV4_DEFAULT_TTL;
@@ -150,6 +195,7 @@ static int iface_vxlan_reconfig(
 	cur->template.udp.dst_port = rte_cpu_to_be_16(cur->dst_port);
 	cur->template.vxlan.vx_flags = VXLAN_FLAGS_VNI;
 	cur->template.vxlan.vx_vni = vxlan_encode_vni(cur->vni);
+	cur->src_port_range = cur->src_port_max - cur->src_port_min + 1;
 
 	if (conf_done & GR_VXLAN_SET_ENCAP_VRF)
 		vrf_decref(prev.encap_vrf_id);
@@ -158,6 +204,10 @@ static int iface_vxlan_reconfig(
 
 err:
 	ret = errno ?: EINVAL;
+	if (conf_done & GR_VXLAN_SET_SRC_PORTS) {
+		cur->src_port_min = prev.src_port_min;
+		cur->src_port_max = prev.src_port_max;
+	}
 	if (conf_done & GR_VXLAN_SET_MAC) {
 		iface_set_eth_addr(iface, &prev.mac);
 	}
@@ -4,6 +4,7 @@
 #include "graph.h"
 #include "iface.h"
 #include "l2.h"
+#include "l2_datapath.h"
 #include "mbuf.h"
 
 #include <gr_infra.h>
@@ -16,19 +17,24 @@ enum edges {
 	EDGE_COUNT
 };
 
-static inline struct rte_mbuf *
-copy_packet(struct rte_mbuf *m, uint16_t copy_count, const struct iface *output_iface) {
+// Number of bytes duplicated in each shared copy. Output interfaces only push
+// headers in front of the original data but some of them (e.g. bond hashing)
+// read up to the L4 header. Keep these contiguous.
+#define FLOOD_HDR_LEN 128
+
+static inline struct rte_mbuf *copy_packet(struct rte_mbuf *m, const struct iface *output_iface) {
 	struct rte_mbuf *copy;
 
-	// Copy packet for each output port (except the first one)
-	if (copy_count == 0) {
-		copy = m;
-	} else {
+	if (output_iface->type == GR_IFACE_TYPE_BRIDGE) {
+		// The local stack may modify the packet in place, give it its own copy.
 		copy = gr_mbuf_copy(m, UINT32_MAX);
-		if (copy == NULL) {
-			// TODO: add xstat
-			return NULL;
-		}
+	} else {
+		// Share the payload with the other copies.
+		copy = gr_mbuf_share(m, FLOOD_HDR_LEN);
+	}
+	if (copy == NULL) {
+		// TODO: add xstat
+		return NULL;
 	}
 
 	mbuf_data(copy)->iface = output_iface;
@@ -36,6 +42,80 @@ copy_packet(struct rte_mbuf *m, uint16_t copy_count, const struct iface *output_
 	return copy;
 }
 
+// Replication of a single packet.
+//
+// The data buffer of the original packet is referenced by all shared copies.
+// Output nodes may write into it (e.g. VLAN tag insertion or header prepend
+// without enough headroom), the original can only be sent as is when there
+// is a single destination. The first destination is recorded and only
+// resolved once all the others are known.
+struct flood {
+	struct rte_mbuf *m;
+	const struct iface *first;
+	rte_edge_t first_edge;
+	uint16_t count;
+};
+
+static inline void flood_send(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct flood *f,
+	const struct iface *iface,
+	rte_edge_t edge
+) {
+	struct rte_mbuf *copy;
+
+	if (f->count == 0) {
+		f->first = iface;
+		f->first_edge = edge;
+		f->count = 1;
+		return;
+	}
+
+	copy = copy_packet(f->m, iface);
+	if (copy == NULL)
+		return;
+
+	rte_node_enqueue_x1(graph, node, edge, copy);
+	f->count++;
+}
+
+static inline uint16_t
+flood_finish(struct rte_graph *graph, struct rte_node *node, struct flood *f) {
+	struct gr_trace_head traces;
+	struct rte_mbuf *copy;
+
+	switch (f->count) {
+	case 0:
+		rte_node_enqueue_x1(graph, node, DROP, f->m);
+		return 0;
+	case 1:
+		mbuf_data(f->m)->iface = f->first;
+		rte_node_enqueue_x1(graph, node, f->first_edge, f->m);
+		return 1;
+	}
+
+	// The first destination also gets a copy. Move the traces of the
+	// original to it instead of duplicating them.
+	STAILQ_INIT(&traces);
+	STAILQ_CONCAT(&traces, gr_mbuf_traces(f->m));
+
+	copy = copy_packet(f->m, f->first);
+	if (copy == NULL) {
+		STAILQ_CONCAT(gr_mbuf_traces(f->m), &traces);
+		rte_node_enqueue_x1(graph, node, DROP, f->m);
+		return f->count - 1;
+	}
+
+	STAILQ_INIT(gr_mbuf_traces(copy));
+	STAILQ_CONCAT(gr_mbuf_traces(copy), &traces);
+	rte_node_enqueue_x1(graph, node, f->first_edge, copy);
+	// Release the reference of the original, the copies hold their own.
+	rte_pktmbuf_free(f->m);
+
+	return f->count;
+}
+
 static uint16_t bridge_flood_process(
 	struct rte_graph *graph,
 	struct rte_node *node,
@@ -44,18 +124,16 @@ static uint16_t bridge_flood_process(
 ) {
 	const struct iface *br, *member, *iface;
 	const struct iface_info_bridge *bridge;
-	struct rte_mbuf *m, *copy;
-	uint16_t flood_count;
+	struct flood f;
 	uint16_t sent = 0;
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
-		m = objs[i];
-		flood_count = 0;
+		f = (struct flood) {.m = objs[i]};
 
-		if (gr_mbuf_is_traced(m))
-			gr_mbuf_trace_add(m, node, 0);
+		if (gr_mbuf_is_traced(f.m))
+			gr_mbuf_trace_add(f.m, node, 0);
 
-		iface = mbuf_data(m)->iface;
+		iface = mbuf_data(f.m)->iface;
 		assert(iface != NULL);
 
 		br = iface_from_id(iface->domain_id);
@@ -73,31 +151,97 @@ static uint16_t bridge_flood_process(
 			if (!(member->flags & GR_IFACE_F_UP))
 				continue; // Skip down interfaces
 
-			copy = copy_packet(m, flood_count, member);
-			if (copy == NULL)
-				continue;
-
 			if (member->type == GR_IFACE_TYPE_VXLAN)
-				rte_node_enqueue_x1(graph, node, VXLAN_FLOOD, copy);
+				flood_send(graph, node, &f, member, VXLAN_FLOOD);
 			else
-				rte_node_enqueue_x1(graph, node, OUTPUT, copy);
-
-			flood_count++;
+				flood_send(graph, node, &f, member, OUTPUT);
 		}
 		if (iface != br && (br->flags & GR_IFACE_F_UP)) {
 			// also flood to bridge interface
-			copy = copy_packet(m, flood_count, br);
-			if (copy != NULL) {
-				rte_node_enqueue_x1(graph, node, INPUT, copy);
-				flood_count++;
-			}
+			flood_send(graph, node, &f, br, INPUT);
 		}
 next:
-		if (flood_count == 0) {
-			// If no flooding occurred, drop the original packet
-			rte_node_enqueue_x1(graph, node, DROP, m);
+		sent += flood_finish(graph, node, &f);
+	}
+
+	return sent;
+}
+
+static inline bool mdb_entry_has(const struct mdb_entry *e, uint16_t iface_id) {
+	for (uint16_t i = 0; i < e->n_ifaces; i++) {
+		if (e->ifaces[i] == iface_id)
+			return true;
+	}
+	return false;
+}
+
+static inline void bridge_mcast_send(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	struct flood *f,
+	const struct iface *br,
+	const struct iface *iface,
+	uint16_t member_id
+) {
+	const struct iface *member = iface_from_id(member_id);
+
+	// Memberships may be stale while an interface is being detached.
+	if (member == NULL || member == iface || member->domain_id != br->id
+	    || !(member->flags & GR_IFACE_F_UP))
+		return;
+
+	if (member->type == GR_IFACE_TYPE_VXLAN)
+		flood_send(graph, node, f, member, VXLAN_FLOOD);
+	else
+		flood_send(graph, node, f, member, OUTPUT);
+}
+
+// Forward multicast frames of snooped groups to their members and to the
+// multicast router ports of the bridge.
+//
+// Reports sent by the local stack are not snooped, the bridge interface is
+// never registered as a group member. Always deliver the frames to it.
+static uint16_t bridge_mcast_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	const struct bridge_mcast_mbuf_data *d;
+	const struct mdb_entry *group, *routers;
+	const struct iface *br, *iface;
+	uint16_t member_id, sent = 0;
+	struct flood f;
+
+	for (uint16_t i = 0; i < nb_objs; i++) {
+		f = (struct flood) {.m = objs[i]};
+
+		if (gr_mbuf_is_traced(f.m))
+			gr_mbuf_trace_add(f.m, node, 0);
+
+		d = bridge_mcast_mbuf_data(f.m);
+		iface = d->iface;
+		group = d->group;
+		routers = d->routers;
+
+		br = iface_from_id(iface->domain_id);
+		if (br == NULL || br->type != GR_IFACE_TYPE_BRIDGE)
+			goto next;
+
+		for (uint16_t j = 0; j < group->n_ifaces; j++) {
+			member_id = group->ifaces[j];
+			bridge_mcast_send(graph, node, &f, br, iface, member_id);
+		}
+		for (uint16_t j = 0; routers != NULL && j < routers->n_ifaces; j++) {
+			member_id = routers->ifaces[j];
+			if (mdb_entry_has(group, member_id))
+				continue; // Already a member of the group
+			bridge_mcast_send(graph, node, &f, br, iface, member_id);
 		}
-		sent += flood_count;
+		if (iface != br && (br->flags & GR_IFACE_F_UP))
+			flood_send(graph, node, &f, br, INPUT);
+next:
+		sent += flood_finish(graph, node, &f);
 	}
 
 	return sent;
@@ -115,11 +259,30 @@ static struct rte_node_register node = {
 	},
 };
 
+static struct rte_node_register mcast_node = {
+	.name = "bridge_mcast",
+	.process = bridge_mcast_process,
+	.nb_edges = EDGE_COUNT,
+	.next_nodes = {
+		[OUTPUT] = "iface_output",
+		[INPUT] = "iface_input",
+		[VXLAN_FLOOD] = "vxlan_flood",
+		[DROP] = "bridge_mcast_drop",
+	},
+};
+
 static struct gr_node_info info = {
 	.node = &node,
 	.type = GR_NODE_T_L2,
 };
 
+static struct gr_node_info mcast_info = {
+	.node = &mcast_node,
+	.type = GR_NODE_T_L2,
+};
+
 GR_NODE_REGISTER(info);
+GR_NODE_REGISTER(mcast_info);
 
 GR_DROP_REGISTER(bridge_flood_drop);
+GR_DROP_REGISTER(bridge_mcast_drop);
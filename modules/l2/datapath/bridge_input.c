@@ -1,13 +1,18 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // Copyright (c) 2026 Robin Jarry
 
+#include "control_output.h"
 #include "graph.h"
 #include "iface.h"
 #include "l2.h"
+#include "l2_datapath.h"
 #include "mbuf.h"
 #include "rxtx.h"
 
 #include <rte_ether.h>
+#include <rte_ip.h>
+
+#include <netinet/in.h>
 
 enum edges {
 	OUTPUT = 0,
@@ -17,6 +22,8 @@ enum edges {
 	HAIRPIN,
 	OUT_IFACE_INVAL,
 	FLOOD_DISABLED,
+	MCAST,
+	CONTROL,
 	EDGE_COUNT
 };
 
@@ -25,26 +32,135 @@ struct bridge_input_trace {
 	uint16_t bridge_id;
 };
 
-static uint16_t bridge_input_process(
-	struct rte_graph *graph,
+// Pseudo-edge for frames that need an FDB lookup.
+#define FDB_LOOKUP ((rte_edge_t)EDGE_COUNT)
+// Pseudo-edge for IGMP/MLD frames that must be flooded and snooped.
+#define SNOOP ((rte_edge_t)EDGE_COUNT + 1)
+
+static inline bool icmp6_type_is_mld(uint8_t type) {
+	switch (type) {
+	case 130: // Multicast Listener Query
+	case 131: // Multicast Listener Report
+	case 132: // Multicast Listener Done
+	case 143: // Version 2 Multicast Listener Report
+		return true;
+	}
+	return false;
+}
+
+// Classify multicast frames on bridges with snooping enabled.
+static inline rte_edge_t bridge_input_mcast(
+	const struct iface *bridge,
+	struct rte_mbuf *m,
+	const struct rte_ether_hdr *eth
+) {
+	struct bridge_mcast_mbuf_data *d = bridge_mcast_mbuf_data(m);
+	static const struct rte_ipv6_addr unspec = RTE_IPV6_ADDR_UNSPEC;
+	uint32_t len = rte_pktmbuf_data_len(m) - sizeof(*eth);
+	const struct rte_ipv6_hdr *ip6;
+	const struct rte_ipv4_hdr *ip;
+	struct rte_ipv6_addr group;
+	const uint8_t *ext;
+
+	switch (eth->ether_type) {
+	case RTE_BE16(RTE_ETHER_TYPE_IPV4):
+		ip = PAYLOAD(eth);
+		if (len < sizeof(*ip))
+			return FLOOD;
+		if (ip->next_proto_id == IPPROTO_IGMP)
+			return SNOOP;
+		// 224.0.0.0/24 is reserved for local network control traffic.
+		if ((ip->dst_addr & RTE_BE32(0xffffff00)) == RTE_BE32(RTE_IPV4(224, 0, 0, 0)))
+			return FLOOD;
+		// Groups are stored as IPv4-mapped addresses.
+		group = unspec;
+		group.a[10] = 0xff;
+		group.a[11] = 0xff;
+		memcpy(&group.a[12], &ip->dst_addr, sizeof(ip->dst_addr));
+		break;
+	case RTE_BE16(RTE_ETHER_TYPE_IPV6):
+		ip6 = PAYLOAD(eth);
+		if (len < sizeof(*ip6) + 8)
+			return FLOOD;
+		if (ip6->proto == IPPROTO_HOPOPTS) {
+			// MLD messages always have a hop-by-hop router alert option.
+			ext = PAYLOAD(ip6);
+			if (ext[0] == IPPROTO_ICMPV6 && len > sizeof(*ip6) + (ext[1] + 1) * 8
+			    && icmp6_type_is_mld(ext[(ext[1] + 1) * 8]))
+				return SNOOP;
+		}
+		// Scopes up to link-local are never snooped.
+		if ((ip6->dst_addr.a[1] & 0x0f) <= 2)
+			return FLOOD;
+		group = ip6->dst_addr;
+		break;
+	default:
+		return FLOOD;
+	}
+
+	// Unregistered groups are flooded.
+	d->group = mdb_lookup(bridge->id, d->vlan_id, &group);
+	if (d->group == NULL)
+		return FLOOD;
+	d->routers = mdb_lookup(bridge->id, d->vlan_id, &unspec);
+
+	return MCAST;
+}
+
+static inline rte_edge_t
+bridge_input_forward(struct iface_mbuf_data *d, const struct gr_fdb_entry *fdb) {
+	const struct iface *iface;
+
+	if (fdb == NULL) {
+		// Unknown unicast
+		return FLOOD;
+	}
+	if (fdb->iface_id == d->iface->id) {
+		// Don't forward back to source interface
+		return HAIRPIN;
+	}
+	iface = iface_from_id(fdb->iface_id);
+	if (iface == NULL)
+		return OUT_IFACE_INVAL;
+
+	// Direct output to learned interface
+	d->iface = iface;
+	d->vtep = fdb->vtep;
+
+	if (iface->type == GR_IFACE_TYPE_BRIDGE)
+		return INPUT;
+
+	return OUTPUT;
+}
+
+static void bridge_input_burst(
+	struct gr_node_batch *batch,
 	struct rte_node *node,
 	void **objs,
 	uint16_t nb_objs
 ) {
-	const struct iface *bridge, *iface;
+	const struct rte_ether_addr *macs[RTE_GRAPH_BURST_SIZE];
+	const struct gr_fdb_entry *fdbs[RTE_GRAPH_BURST_SIZE];
+	gr_bridge_flags_t br_flags[RTE_GRAPH_BURST_SIZE];
+	uint16_t bridge_ids[RTE_GRAPH_BURST_SIZE];
+	uint16_t vlan_ids[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
 	const struct iface_info_bridge *br;
-	const struct gr_fdb_entry *fdb;
+	const struct iface *bridge;
 	struct iface_mbuf_data *d;
 	struct rte_ether_hdr *eth;
-	struct rte_mbuf *m;
+	struct rte_mbuf *m, *copy;
+	uint16_t i, n_lookup;
 	ip4_addr_t vtep;
 	rte_edge_t edge;
 
-	for (uint16_t i = 0; i < nb_objs; i++) {
+	// Classify frames, learn source addresses and collect destinations.
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		d = iface_mbuf_data(m);
 		eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-		fdb = NULL;
+		br_flags[i] = 0;
 
 		if (gr_mbuf_is_traced(m)) {
 			struct bridge_input_trace *t = gr_mbuf_trace_add(m, node, sizeof(*t));
@@ -54,10 +170,11 @@ static uint16_t bridge_input_process(
 
 		bridge = iface_from_id(d->iface->domain_id);
 		if (bridge == NULL || bridge->type != GR_IFACE_TYPE_BRIDGE) {
-			edge = BRIDGE_INVAL;
-			goto next;
+			edges[i] = BRIDGE_INVAL;
+			continue;
 		}
 		br = iface_info_bridge(bridge);
+		br_flags[i] = br->flags;
 
 		if (rte_is_unicast_ether_addr(&eth->src_addr)
 		    && !(br->flags & GR_BRIDGE_F_NO_LEARN)) {
@@ -66,41 +183,63 @@ static uint16_t bridge_input_process(
 		}
 
 		if (rte_is_unicast_ether_addr(&eth->dst_addr)) {
-			fdb = fdb_lookup(bridge->id, &eth->dst_addr, d->vlan_id);
-			if (fdb == NULL) {
-				// Unknown unicast
-				edge = FLOOD;
-				goto next;
-			}
-			if (fdb->iface_id == d->iface->id) {
-				// Don't forward back to source interface
-				edge = HAIRPIN;
-				goto next;
-			}
-			iface = iface_from_id(fdb->iface_id);
-			if (iface == NULL) {
-				edge = OUT_IFACE_INVAL;
-				goto next;
-			}
-			// Direct output to learned interface
-			d->iface = iface;
-			d->vtep = fdb->vtep;
-
-			if (iface->type == GR_IFACE_TYPE_BRIDGE) {
-				edge = INPUT;
-			} else {
-				edge = OUTPUT;
+			bridge_ids[n_lookup] = bridge->id;
+			macs[n_lookup] = &eth->dst_addr;
+			vlan_ids[n_lookup] = d->vlan_id;
+			n_lookup++;
+			edges[i] = FDB_LOOKUP;
+		} else if (br->flags & GR_BRIDGE_F_MCAST_SNOOPING
+			   && !rte_is_broadcast_ether_addr(&eth->dst_addr)) {
+			edges[i] = bridge_input_mcast(bridge, m, eth);
+			if (edges[i] == SNOOP) {
+				// Flood the original, send a copy to the control plane.
+				copy = gr_mbuf_copy(m, UINT32_MAX);
+				if (copy != NULL) {
+					control_output_set_cb(copy, mdb_snoop_cb, 0);
+					rte_node_enqueue_x1(batch->graph, node, CONTROL, copy);
+				}
+				edges[i] = FLOOD;
 			}
 		} else {
 			// Broadcast, multicast
-			edge = FLOOD;
+			edges[i] = FLOOD;
 		}
-next:
-		if (edge == FLOOD && (br->flags & GR_BRIDGE_F_NO_FLOOD))
+	}
+
+	if (n_lookup > 0)
+		fdb_lookup_bulk(n_lookup, bridge_ids, macs, vlan_ids, fdbs);
+
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		edge = edges[i];
+
+		if (edge == FDB_LOOKUP)
+			edge = bridge_input_forward(iface_mbuf_data(m), fdbs[n_lookup++]);
+		if (edge == FLOOD && (br_flags[i] & GR_BRIDGE_F_NO_FLOOD))
 			edge = FLOOD_DISABLED;
 
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(batch, edge, m);
 	}
+}
+
+static uint16_t bridge_input_process(
+	struct rte_graph *graph,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		bridge_input_burst(&batch, node, &objs[i], n);
+	}
+
+	gr_node_batch_flush(&batch);
 
 	return nb_objs;
 }
@@ -135,6 +274,8 @@ static struct rte_node_register node = {
 		[HAIRPIN] = "bridge_input_hairpin",
 		[OUT_IFACE_INVAL] = "bridge_input_invalid_output",
 		[FLOOD_DISABLED] = "bridge_input_flood_disabled",
+		[MCAST] = "bridge_mcast",
+		[CONTROL] = "control_output",
 	},
 };
 
@@ -3,13 +3,65 @@
 
 #pragma once
 
+#include "flow_hash.h"
+#include "l2.h"
+#include "mbuf.h"
+#include "rxtx.h"
+
 #include <gr_net_types.h>
 
+#include <rte_byteorder.h>
+#include <rte_ip.h>
+
+#include <stddef.h>
 #include <stdint.h>
 
+// Extends iface_mbuf_data with the snooped groups resolved by bridge_input.
+GR_MBUF_PRIV_DATA_TYPE(bridge_mcast_mbuf_data, {
+	uint16_t vlan_id;
+	ip4_addr_t vtep;
+	const struct mdb_entry *group;
+	const struct mdb_entry *routers;
+});
+
+#define BRIDGE_MCAST_SAME_OFFSET(f)                                                                \
+	(offsetof(struct bridge_mcast_mbuf_data, f) == offsetof(struct iface_mbuf_data, f))
+static_assert(BRIDGE_MCAST_SAME_OFFSET(vlan_id));
+static_assert(BRIDGE_MCAST_SAME_OFFSET(vtep));
+
 struct trace_vxlan_data {
 	rte_be32_t vni;
 	ip4_addr_t vtep;
 };
 
 int trace_vxlan_format(char *buf, size_t len, const void *data, size_t data_len);
+
+// RFC 7348 Section 5, recommends using source port hashing to enable ECMP load
+// balancing in the underlay network.
+static inline rte_be16_t vxlan_src_port(const struct iface_info_vxlan *vxlan, uint32_t hash) {
+	// Scale the hash to the configured range without a division.
+	uint32_t offset = ((uint64_t)hash * vxlan->src_port_range) >> 32;
+	return rte_cpu_to_be_16(vxlan->src_port_min + offset);
+}
+
+// Prepend the VXLAN, UDP and IPv4 headers to a packet.
+// Returns NULL if there is not enough headroom.
+static inline struct vxlan_template *
+vxlan_encap(struct rte_mbuf *m, const struct iface_info_vxlan *vxlan, ip4_addr_t vtep) {
+	uint16_t len = rte_pktmbuf_pkt_len(m);
+	struct vxlan_template *vh;
+
+	vh = gr_mbuf_prepend(m, vh);
+	if (unlikely(vh == NULL))
+		return NULL;
+
+	*vh = vxlan->template;
+	gr_mbuf_flow_hash_eth(m);
+	vh->udp.src_port = vxlan_src_port(vxlan, m->hash.rss);
+	vh->udp.dgram_len = rte_cpu_to_be_16(len + sizeof(vh->udp) + sizeof(vh->vxlan));
+	vh->ip.dst_addr = vtep;
+	vh->ip.total_length = rte_cpu_to_be_16(len + sizeof(*vh));
+	vh->ip.hdr_checksum = rte_ipv4_cksum(&vh->ip);
+
+	return vh;
+}
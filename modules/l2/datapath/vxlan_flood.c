@@ -2,53 +2,116 @@
 // Copyright (c) 2026 Robin Jarry
 
 #include "graph.h"
+#include "ip4.h"
 #include "l2.h"
+#include "l2_datapath.h"
+#include "l3.h"
 #include "mbuf.h"
 #include "rxtx.h"
 
+#include <rte_ether.h>
+
+// Head-end replication of BUM frames to all remote VTEPs of a flood list.
+//
+// Each replica is made of a private segment holding the outer headers, chained
+// to the shared inner frame. All replicas of a frame are encapsulated here and
+// sent to ip_output in bursts. The original frame is used for the last replica
+// when it has enough headroom for in place encapsulation.
+
 enum edges {
-	OUTPUT = 0,
+	IP_OUTPUT = 0,
+	NO_ROUTE,
+	NO_HEADROOM,
 	DROP,
 	EDGE_COUNT
 };
 
+// Outer headers and the ethernet header pushed later by eth_output.
+#define VXLAN_FLOOD_HEADROOM                                                                       \
+	(sizeof(struct vxlan_template) + sizeof(struct rte_ether_hdr) + sizeof(struct rte_vlan_hdr))
+
 static uint16_t
 vxlan_flood_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct rte_mbuf *replicas[RTE_GRAPH_BURST_SIZE];
+	const struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	const struct iface *iface, *nhs_iface = NULL;
 	const struct iface_info_vxlan *vxlan;
-	struct rte_mbuf *m, *copy;
-	uint16_t flood_count;
+	uint16_t j, k, n, len, n_vteps;
+	struct rte_mbuf *m, *r;
+	const ip4_addr_t *vteps;
 	uint16_t sent = 0;
+	bool in_place;
+	ip4_addr_t vtep;
+	IFACE_STATS_VARS(tx);
 
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		m = objs[i];
-		flood_count = 0;
+		iface = mbuf_data(m)->iface;
+		vxlan = iface_info_vxlan(iface);
+		n_vteps = vxlan->n_flood_vteps;
+		vteps = vxlan->flood_vteps;
+
+		if (n_vteps == 0) {
+			if (gr_mbuf_is_traced(m))
+				gr_mbuf_trace_add(m, node, 0);
+			rte_node_enqueue_x1(graph, node, DROP, m);
+			continue;
+		}
 
-		if (gr_mbuf_is_traced(m))
-			gr_mbuf_trace_add(m, node, 0);
+		in_place = rte_pktmbuf_headroom(m) >= VXLAN_FLOOD_HEADROOM;
+		// Compute the inner flow hash before the headers are shared.
+		gr_mbuf_flow_hash_eth(m);
 
-		vxlan = iface_info_vxlan(mbuf_data(m)->iface);
+		for (j = 0; j < n_vteps; j += len) {
+			len = RTE_MIN(n_vteps - j, RTE_GRAPH_BURST_SIZE);
 
-		for (uint16_t j = 0; j < vxlan->n_flood_vteps; j++) {
-			if (flood_count == 0) {
-				copy = m;
-			} else {
-				copy = gr_mbuf_copy(m, UINT32_MAX);
-				if (copy == NULL)
-					continue;
+			// Consecutive frames are usually flooded to the same VTEPs.
+			if (iface != nhs_iface || n_vteps > RTE_GRAPH_BURST_SIZE) {
+				fib4_lookup_bulk(vxlan->encap_vrf_id, &vteps[j], nhs, len);
+				nhs_iface = iface;
 			}
 
-			iface_mbuf_data(copy)->vtep = vxlan->flood_vteps[j];
+			n = 0;
+			for (k = 0; k < len; k++) {
+				vtep = vteps[j + k];
+
+				if (in_place && j + k == n_vteps - 1)
+					r = m;
+				else if ((r = gr_mbuf_share(m, 0)) == NULL)
+					continue;
 
-			rte_node_enqueue_x1(graph, node, OUTPUT, copy);
+				if (gr_mbuf_is_traced(r)) {
+					struct trace_vxlan_data *t;
+					t = gr_mbuf_trace_add(r, node, sizeof(*t));
+					t->vni = rte_cpu_to_be_32(vxlan->vni);
+					t->vtep = vtep;
+				}
 
-			flood_count++;
+				if (nhs[k] == NULL) {
+					rte_node_enqueue_x1(graph, node, NO_ROUTE, r);
+					continue;
+				}
+				if (unlikely(vxlan_encap(r, vxlan, vtep) == NULL)) {
+					rte_node_enqueue_x1(graph, node, NO_HEADROOM, r);
+					continue;
+				}
+
+				l3_mbuf_data(r)->nh = nhs[k];
+				IFACE_STATS_INC(tx, r, iface);
+				replicas[n++] = r;
+			}
+
+			if (n > 0)
+				rte_node_enqueue(graph, node, IP_OUTPUT, (void **)replicas, n);
+			sent += n;
 		}
 
-		if (flood_count == 0)
-			rte_node_enqueue_x1(graph, node, DROP, m);
-		sent += flood_count;
+		if (!in_place)
+			rte_pktmbuf_free(m);
 	}
 
+	IFACE_STATS_FLUSH(tx);
+
 	return sent;
 }
 
@@ -57,7 +120,9 @@ static struct rte_node_register node = {
 	.process = vxlan_flood_process,
 	.nb_edges = EDGE_COUNT,
 	.next_nodes = {
-		[OUTPUT] = "iface_output",
+		[IP_OUTPUT] = "ip_output",
+		[NO_ROUTE] = "vxlan_output_no_route",
+		[NO_HEADROOM] = "error_no_headroom",
 		[DROP] = "vxlan_flood_drop",
 	},
 };
@@ -65,6 +130,7 @@ static struct rte_node_register node = {
 static struct gr_node_info info = {
 	.node = &node,
 	.type = GR_NODE_T_L2,
+	.trace_format = trace_vxlan_format,
 };
 
 GR_NODE_REGISTER(info);
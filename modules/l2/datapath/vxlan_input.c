@@ -33,66 +33,103 @@ int trace_vxlan_format(char *buf, size_t len, const void *data, size_t /*data_le
 	return n;
 }
 
-static uint16_t
-vxlan_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
-	uint16_t last_vrf_id, vrf_id;
+// Pseudo-edge for packets that need a VNI lookup.
+#define VNI_LOOKUP ((rte_edge_t)EDGE_COUNT)
+
+static void vxlan_input_burst(
+	struct gr_node_batch *batch,
+	struct rte_node *node,
+	void **objs,
+	uint16_t nb_objs
+) {
+	struct iface *ifaces[RTE_GRAPH_BURST_SIZE];
+	rte_be32_t key_vnis[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	rte_be32_t vnis[RTE_GRAPH_BURST_SIZE];
+	uint16_t keys[RTE_GRAPH_BURST_SIZE];
 	struct ip_local_mbuf_data *l;
 	struct iface_mbuf_data *d;
 	struct rte_vxlan_hdr *vh;
-	rte_be32_t vni, last_vni;
+	uint16_t i, n_lookup;
 	ip4_addr_t src_vtep;
 	struct iface *iface;
 	struct rte_mbuf *m;
-	rte_edge_t edge;
 
-	last_vrf_id = GR_VRF_ID_UNDEF;
-	last_vni = 0;
-	iface = NULL;
-	vni = 0;
-
-	for (uint16_t i = 0; i < nb_objs; i++) {
+	// Validate headers and collect distinct consecutive (vni, vrf) keys.
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		l = ip_local_mbuf_data(m);
-		vrf_id = l->vrf_id;
-		src_vtep = l->src;
+		vnis[i] = 0;
 
 		if (rte_pktmbuf_pkt_len(m) < VXLAN_MIN_PKT_LEN) {
-			edge = BAD_LENGTH;
-			goto next;
+			edges[i] = BAD_LENGTH;
+			continue;
 		}
 
 		vh = rte_pktmbuf_mtod_offset(m, struct rte_vxlan_hdr *, sizeof(struct rte_udp_hdr));
 		if (!(vh->vx_flags & VXLAN_FLAGS_VNI)) {
-			edge = BAD_FLAGS;
-			goto next;
+			edges[i] = BAD_FLAGS;
+			continue;
 		}
 
-		vni = vxlan_decode_vni(vh->vx_vni);
-		if (vni != last_vni || vrf_id != last_vrf_id) {
-			iface = vxlan_get_iface(vni, vrf_id);
-			last_vrf_id = vrf_id;
-			last_vni = vni;
-		}
-		if (iface == NULL) {
-			edge = NO_TUNNEL;
-			goto next;
+		vnis[i] = vxlan_decode_vni(vh->vx_vni);
+		if (n_lookup == 0 || key_vnis[n_lookup - 1] != vnis[i]
+		    || vrf_ids[n_lookup - 1] != l->vrf_id) {
+			key_vnis[n_lookup] = vnis[i];
+			vrf_ids[n_lookup] = l->vrf_id;
+			n_lookup++;
 		}
+		keys[i] = n_lookup - 1;
+		edges[i] = VNI_LOOKUP;
+	}
 
-		rte_pktmbuf_adj(m, sizeof(struct rte_udp_hdr) + sizeof(*vh));
+	if (n_lookup > 0)
+		vxlan_get_iface_bulk(n_lookup, key_vnis, vrf_ids, ifaces);
 
-		d = iface_mbuf_data(m);
-		d->iface = iface;
-		d->vlan_id = 0;
-		d->vtep = src_vtep;
-		edge = IFACE_INPUT;
-next:
+	for (i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		src_vtep = ip_local_mbuf_data(m)->src;
+		iface = NULL;
+
+		if (edges[i] == VNI_LOOKUP) {
+			iface = ifaces[keys[i]];
+			if (iface == NULL) {
+				edges[i] = NO_TUNNEL;
+			} else {
+				rte_pktmbuf_adj(
+					m, sizeof(struct rte_udp_hdr) + sizeof(struct rte_vxlan_hdr)
+				);
+				d = iface_mbuf_data(m);
+				d->iface = iface;
+				d->vlan_id = 0;
+				d->vtep = src_vtep;
+				edges[i] = IFACE_INPUT;
+			}
+		}
 		if (gr_mbuf_is_traced(m) || (iface && iface->flags & GR_IFACE_F_PACKET_TRACE)) {
 			struct trace_vxlan_data *t = gr_mbuf_trace_add(m, node, sizeof(*t));
-			t->vni = vni;
+			t->vni = vnis[i];
 			t->vtep = src_vtep;
 		}
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(batch, edges[i], m);
 	}
+}
+
+static uint16_t
+vxlan_input_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		vxlan_input_burst(&batch, node, &objs[i], n);
+	}
+
+	gr_node_batch_flush(&batch);
 
 	return nb_objs;
 }
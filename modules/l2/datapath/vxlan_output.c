@@ -20,15 +20,6 @@ enum {
 	EDGE_COUNT,
 };
 
-#define EPHEMERAL_PORT_START 49152
-#define EPHEMERAL_PORT_MASK (UINT16_MAX - EPHEMERAL_PORT_START)
-
-static inline rte_be16_t vxlan_src_port(uint32_t hash) {
-	// RFC 7348 Section 5, recommends using source port hashing to enable
-	// ECMP load balancing in the underlay network.
-	return rte_cpu_to_be_16(EPHEMERAL_PORT_START + (hash & EPHEMERAL_PORT_MASK));
-}
-
 static uint16_t vxlan_output_process(
 	struct rte_graph *graph,
 	struct rte_node *node,
@@ -36,13 +27,13 @@ static uint16_t vxlan_output_process(
 	uint16_t nb_objs
 ) {
 	const struct iface_info_vxlan *vxlan;
+	struct gr_node_batch batch;
 	struct iface_mbuf_data *d;
-	struct vxlan_template *vh;
 	const struct nexthop *nh;
 	struct rte_mbuf *m;
 	rte_edge_t edge;
-	uint16_t len;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		d = iface_mbuf_data(m);
@@ -60,28 +51,20 @@ static uint16_t vxlan_output_process(
 			goto next;
 		}
 
-		len = rte_pktmbuf_pkt_len(m);
-
-		vh = gr_mbuf_prepend(m, vh);
-		if (unlikely(vh == NULL)) {
+		if (unlikely(vxlan_encap(m, vxlan, d->vtep) == NULL)) {
 			edge = NO_HEADROOM;
 			goto next;
 		}
 
-		*vh = vxlan->template;
-		vh->udp.src_port = vxlan_src_port(m->hash.rss);
-		vh->udp.dgram_len = rte_cpu_to_be_16(len + sizeof(vh->udp) + sizeof(vh->vxlan));
-		vh->ip.dst_addr = d->vtep;
-		vh->ip.total_length = rte_cpu_to_be_16(len + sizeof(*vh));
-		vh->ip.hdr_checksum = rte_ipv4_cksum(&vh->ip);
-
 		l3_mbuf_data(m)->nh = nh;
 
 		edge = IP_OUTPUT;
 next:
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -97,6 +97,8 @@ GR_REQ(GR_CONNTRACK_FLUSH, struct gr_empty, struct gr_empty);
 // Connection tracking configuration and timeout settings.
 struct gr_conntrack_config {
 	// Maximum number of tracked connections (default: 16K).
+	// Existing connections are preserved when it is changed. They are
+	// migrated in the background, no other resize is allowed meanwhile.
 	uint32_t max_count;
 	// Full closed states (default: 5 sec).
 	uint32_t timeout_closed_sec;
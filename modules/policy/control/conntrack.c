@@ -3,16 +3,21 @@
 
 #include "conntrack.h"
 #include "log.h"
+#include "metrics.h"
 #include "module.h"
 #include "rcu.h"
+#include "vec.h"
 
+#include <gr_bitops.h>
 #include <gr_clock.h>
+#include <gr_macro.h>
 #include <gr_net_types.h>
 
 #include <rte_hash.h>
 #include <rte_icmp.h>
 #include <rte_ip.h>
 #include <rte_mempool.h>
+#include <rte_ring.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
@@ -327,8 +332,58 @@ static struct gr_conntrack_config conf = {
 };
 static _Atomic(struct rte_hash *) conn_hash;
 static _Atomic(struct rte_mempool *) conn_pool;
+// New connections created by datapath workers, waiting to be scheduled in
+// the expiry timer wheel. It has one slot per connection and cannot overflow.
+static _Atomic(struct rte_ring *) conn_ring;
 static struct event *ageing_timer;
 
+// Live resize.
+//
+// When the table size is changed, a new hash table and object pool replace the
+// current ones. Existing connections keep their objects from the previous pool.
+// Their keys are copied to the new table in the background while lookups are
+// done in both tables. Once all entries have been copied, the previous table is
+// freed. The previous pool is freed when its last connection is destroyed.
+//
+// Connections that cannot be copied because of hash collisions in the new
+// table remain reachable through the previous table. Copying them is retried
+// every MIGRATE_BACKOFF_SEC until they have all been copied or destroyed.
+static _Atomic(struct rte_hash *) conn_hash_old;
+static vec struct rte_mempool **retired_pools;
+static struct event *migrate_timer;
+static uint32_t migrate_iter;
+static unsigned migrate_failures;
+static bool migrate_backoff;
+static unsigned table_gen;
+
+#define MIGRATE_BATCH 1024
+#define MIGRATE_BACKOFF_SEC 1
+
+// Connection expiry timer wheel with one slot per second.
+//
+// Each connection is linked in the slot of its expected expiry time. When the
+// wheel reaches a slot, the actual deadline of its connections is recomputed
+// from their current state and last update time. Expired connections are
+// destroyed and the others are moved to the slot of their new deadline.
+// Active connections are only visited once per timeout period. Timeouts
+// longer than the wheel size cause extra visits which are harmless.
+#define WHEEL_SLOTS 1024 // must be a power of two
+
+LIST_HEAD(conn_list, conn);
+
+static struct {
+	struct conn_list slots[WHEEL_SLOTS];
+	uint64_t current; // next second to process
+} wheel;
+
+#define EXPIRY_LATENCY_SLOTS 16
+
+static struct {
+	uint64_t scanned;
+	uint64_t expired;
+	uint64_t latency[EXPIRY_LATENCY_SLOTS]; // seconds after deadline
+} ageing_stats;
+
 #define CONN_FLOW_FWD_BIT ((uintptr_t)0x1)
 
 static inline conn_flow_t conn_flow(void *data) {
@@ -348,22 +403,108 @@ static inline void *conn_data(struct conn *conn, conn_flow_t flow) {
 }
 
 struct conn *gr_conn_lookup(const struct conn_key *key, conn_flow_t *flow) {
+	// Load the current table before the previous one, see config_update.
+	struct rte_hash *h = atomic_load(&conn_hash);
+	struct rte_hash *old = atomic_load(&conn_hash_old);
 	void *data;
 
-	if (rte_hash_lookup_data(conn_hash, key, &data) < 0)
-		return NULL;
+	// During a resize, entries are added to the new table before being
+	// removed from the previous one. Look in the previous table first so that
+	// a connection being migrated is never missed.
+	if (unlikely(old != NULL) && rte_hash_lookup_data(old, key, &data) >= 0)
+		goto found;
 
+	if (rte_hash_lookup_data(h, key, &data) < 0)
+		return NULL;
+found:
 	*flow = conn_flow(data);
 
 	return conn_ptr(data);
 }
 
+// Lookup at most RTE_HASH_LOOKUP_BULK_MAX keys. Only fill the results of keys
+// that were found. Returns a bit mask of these keys.
+static inline uint64_t conn_hash_lookup_bulk(
+	struct rte_hash *h,
+	const struct conn_key **keys,
+	struct conn **conns,
+	conn_flow_t *flows,
+	unsigned n
+) {
+	void *data[RTE_HASH_LOOKUP_BULK_MAX];
+	uint64_t hits;
+
+	if (rte_hash_lookup_bulk_data(h, (const void **)keys, n, &hits, data) < 0)
+		return 0;
+
+	for (unsigned i = 0; i < n; i++) {
+		if (hits & GR_BIT64(i)) {
+			conns[i] = conn_ptr(data[i]);
+			flows[i] = conn_flow(data[i]);
+		}
+	}
+
+	return hits;
+}
+
+void gr_conn_lookup_bulk(
+	const struct conn_key **keys,
+	struct conn **conns,
+	conn_flow_t *flows,
+	unsigned n
+) {
+	// Load the current table before the previous one, see config_update.
+	struct rte_hash *h = atomic_load(&conn_hash);
+	struct rte_hash *old = atomic_load(&conn_hash_old);
+	const struct conn_key *miss_keys[RTE_HASH_LOOKUP_BULK_MAX];
+	struct conn *miss_conns[RTE_HASH_LOOKUP_BULK_MAX];
+	conn_flow_t miss_flows[RTE_HASH_LOOKUP_BULK_MAX];
+	uint8_t miss_idx[RTE_HASH_LOOKUP_BULK_MAX];
+	unsigned i, j, len, n_miss;
+	uint64_t hits;
+
+	for (i = 0; i < n; i += len) {
+		len = RTE_MIN(n - i, RTE_HASH_LOOKUP_BULK_MAX);
+		for (j = 0; j < len; j++)
+			conns[i + j] = NULL;
+
+		if (likely(old == NULL)) {
+			conn_hash_lookup_bulk(h, &keys[i], &conns[i], &flows[i], len);
+			continue;
+		}
+
+		// Resize in progress, see gr_conn_lookup.
+		hits = conn_hash_lookup_bulk(old, &keys[i], &conns[i], &flows[i], len);
+		n_miss = 0;
+		for (j = 0; j < len; j++) {
+			if (!(hits & GR_BIT64(j))) {
+				miss_keys[n_miss] = keys[i + j];
+				miss_idx[n_miss] = j;
+				n_miss++;
+			}
+		}
+		if (n_miss == 0)
+			continue;
+
+		hits = conn_hash_lookup_bulk(h, miss_keys, miss_conns, miss_flows, n_miss);
+		for (j = 0; j < n_miss; j++) {
+			if (hits & GR_BIT64(j)) {
+				conns[i + miss_idx[j]] = miss_conns[j];
+				flows[i + miss_idx[j]] = miss_flows[j];
+			}
+		}
+	}
+}
+
 struct conn *gr_conn_insert(const struct conn_key *fwd_key, const struct conn_key *rev_key) {
+	struct rte_mempool *pool = atomic_load(&conn_pool);
+	struct rte_hash *h = atomic_load(&conn_hash);
+	struct rte_ring *ring = atomic_load(&conn_ring);
 	struct conn *conn;
 	void *data;
 
 	// create a new connection object
-	if (rte_mempool_get(conn_pool, &data) < 0)
+	if (rte_mempool_get(pool, &data) < 0)
 		return NULL;
 
 	conn = data;
@@ -371,121 +512,388 @@ struct conn *gr_conn_insert(const struct conn_key *fwd_key, const struct conn_ke
 	conn->rev_key = *rev_key;
 	conn->fwd_key = *fwd_key;
 
-	if (rte_hash_add_key_data(conn_hash, fwd_key, conn_data(data, CONN_FLOW_FWD)) < 0) {
+	if (rte_hash_add_key_data(h, fwd_key, conn_data(data, CONN_FLOW_FWD)) < 0) {
 		// hash full
-		rte_mempool_put(conn_pool, data);
+		rte_mempool_put(pool, data);
 		return NULL;
 	}
 
 	// Also reference the conntrack by its *reverse* key for replies.
-	if (rte_hash_add_key_data(conn_hash, rev_key, conn_data(data, CONN_FLOW_REV)) < 0) {
+	if (rte_hash_add_key_data(h, rev_key, conn_data(data, CONN_FLOW_REV)) < 0) {
 		// hash full, remove forward key,
-		rte_hash_del_key(conn_hash, fwd_key);
-		rte_mempool_put(conn_pool, data);
+		rte_hash_del_key(h, fwd_key);
+		rte_mempool_put(pool, data);
+		return NULL;
+	}
+
+	// Notify the control plane so that it can schedule its expiry.
+	if (rte_ring_mp_enqueue(ring, conn) < 0) {
+		rte_hash_del_key(h, rev_key);
+		rte_hash_del_key(h, fwd_key);
+		rte_mempool_put(pool, data);
 		return NULL;
 	}
 
 	return conn;
 }
 
-static void do_ageing(evutil_socket_t, short /*what*/, void * /*priv*/) {
-	clock_t now = gr_clock_us(), last;
-	uint64_t age, timeout;
+static uint32_t conn_timeout(const struct conn *conn) {
+	switch (atomic_load(&conn->state)) {
+	case CONN_S_NEW:
+	case CONN_S_SIMSYN_SENT:
+	case CONN_S_SYN_RECEIVED:
+		return conf.timeout_new_sec;
+	case CONN_S_ESTABLISHED:
+		switch (conn->fwd_key.proto) {
+		case IPPROTO_TCP:
+			return conf.timeout_tcp_established_sec;
+		case IPPROTO_UDP:
+			if (conn->fwd_key.dst_id == RTE_BE16(53))
+				return 2;
+			return conf.timeout_udp_established_sec;
+		default:
+			return conf.timeout_udp_established_sec;
+		}
+	case CONN_S_FIN_SENT:
+	case CONN_S_FIN_RECEIVED:
+	case CONN_S_CLOSE_WAIT:
+	case CONN_S_FIN_WAIT:
+		return conf.timeout_half_close_sec;
+	case CONN_S_TIME_WAIT:
+		return conf.timeout_time_wait_sec;
+	case CONN_S_CLOSING:
+	case CONN_S_CLOSED:
+	case CONN_S_LAST_ACK:
+	default:
+		return conf.timeout_closed_sec;
+	}
+}
+
+// Return the time after which a connection must be destroyed (microseconds).
+static inline clock_t conn_deadline(const struct conn *conn) {
+	return atomic_load(&conn->last_update) + (clock_t)conn_timeout(conn) * CLOCKS_PER_SEC;
+}
+
+static void conn_wheel_schedule(struct conn *conn) {
+	uint64_t slot = conn_deadline(conn) / CLOCKS_PER_SEC + 1;
+
+	if (slot < wheel.current)
+		slot = wheel.current;
+
+	LIST_INSERT_HEAD(&wheel.slots[slot & (WHEEL_SLOTS - 1)], conn, wheel_next);
+}
+
+// Schedule the expiry of connections created by datapath workers.
+static void conn_wheel_drain_ring(struct rte_ring *ring) {
+	struct conn *conns[32];
+	unsigned n;
+
+	do {
+		n = rte_ring_sc_dequeue_burst(ring, (void **)conns, ARRAY_DIM(conns), NULL);
+		for (unsigned i = 0; i < n; i++)
+			conn_wheel_schedule(conns[i]);
+	} while (n > 0);
+}
+
+static inline void conn_wheel_drain(void) {
+	conn_wheel_drain_ring(conn_ring);
+}
+
+// Connections are only visited when the wheel reaches their slot. After
+// a timeout was lowered, move them all to the slot of their new deadline.
+// Those that are already past it will be destroyed on the next timer run.
+static void conn_wheel_reschedule(void) {
+	struct conn_list all;
 	struct conn *conn;
+
+	conn_wheel_drain();
+
+	LIST_INIT(&all);
+	for (unsigned i = 0; i < WHEEL_SLOTS; i++) {
+		while ((conn = LIST_FIRST(&wheel.slots[i])) != NULL) {
+			LIST_REMOVE(conn, wheel_next);
+			LIST_INSERT_HEAD(&all, conn, wheel_next);
+		}
+	}
+
+	while ((conn = LIST_FIRST(&all)) != NULL) {
+		LIST_REMOVE(conn, wheel_next);
+		conn_wheel_schedule(conn);
+	}
+}
+
+// Iterator over all connections, including those not yet migrated after a resize.
+struct conn_iter {
+	bool old_done;
+	uint32_t next;
+};
+
+static struct conn *conn_next(struct conn_iter *it, conn_flow_t *flow) {
+	struct rte_hash *old = atomic_load(&conn_hash_old);
 	const void *key;
-	uint32_t iter;
 	void *data;
 
-	iter = 0;
-	while (rte_hash_iterate(conn_hash, &key, &data, &iter) >= 0) {
-		conn = conn_ptr(data);
+	if (!it->old_done) {
+		while (old != NULL && rte_hash_iterate(old, &key, &data, &it->next) >= 0) {
+			// Skip entries that were already copied to the new table.
+			if (rte_hash_lookup(conn_hash, key) >= 0)
+				continue;
+			*flow = conn_flow(data);
+			return conn_ptr(data);
+		}
+		it->old_done = true;
+		it->next = 0;
+	}
+
+	if (rte_hash_iterate(conn_hash, &key, &data, &it->next) < 0)
+		return NULL;
+
+	*flow = conn_flow(data);
+	return conn_ptr(data);
+}
+
+static void retired_pools_gc(void) {
+	struct rte_mempool *pool;
+	unsigned i = 0;
+
+	while (i < vec_len(retired_pools)) {
+		pool = retired_pools[i];
+		if (rte_mempool_in_use_count(pool) == 0) {
+			LOG(DEBUG, "freeing %s", pool->name);
+			rte_mempool_free(pool);
+			vec_del_swap(retired_pools, i);
+		} else {
+			i++;
+		}
+	}
+}
+
+// Copy up to max connections from the previous table to the new one. They are
+// left in the previous table which is freed as a whole once all of them have
+// been copied. Return true when the end of the previous table was reached.
+static bool migrate_batch(struct rte_hash *old, struct rte_hash *h, unsigned max) {
+	struct conn *conn;
+	const void *key;
+	unsigned n = 0;
+	void *data;
+
+	while (n < max && rte_hash_iterate(old, &key, &data, &migrate_iter) >= 0) {
 		if (conn_flow(data) != CONN_FLOW_FWD)
 			continue;
+		conn = conn_ptr(data);
+		n++;
 
-		switch (atomic_load(&conn->state)) {
-		case CONN_S_NEW:
-		case CONN_S_SIMSYN_SENT:
-		case CONN_S_SYN_RECEIVED:
-			timeout = conf.timeout_new_sec;
-			break;
-		case CONN_S_ESTABLISHED:
-			switch (conn->fwd_key.proto) {
-			case IPPROTO_TCP:
-				timeout = conf.timeout_tcp_established_sec;
-				break;
-			case IPPROTO_UDP:
-				if (conn->fwd_key.dst_id == RTE_BE16(53))
-					timeout = 2;
-				else
-					timeout = conf.timeout_udp_established_sec;
-				break;
-			default:
-				timeout = conf.timeout_udp_established_sec;
-				break;
-			}
-			break;
-		case CONN_S_FIN_SENT:
-		case CONN_S_FIN_RECEIVED:
-		case CONN_S_CLOSE_WAIT:
-		case CONN_S_FIN_WAIT:
-			timeout = conf.timeout_half_close_sec;
-			break;
-		case CONN_S_TIME_WAIT:
-			timeout = conf.timeout_time_wait_sec;
-			break;
-		case CONN_S_CLOSING:
-		case CONN_S_CLOSED:
-		case CONN_S_LAST_ACK:
-		default:
-			timeout = conf.timeout_closed_sec;
-			break;
+		if (rte_hash_add_key_data(h, &conn->fwd_key, conn_data(conn, CONN_FLOW_FWD)) < 0) {
+			migrate_failures++;
+			continue;
 		}
-
-		last = atomic_load(&conn->last_update);
-		if (last > now)
+		if (rte_hash_add_key_data(h, &conn->rev_key, conn_data(conn, CONN_FLOW_REV)) < 0) {
+			rte_hash_del_key(h, &conn->fwd_key);
+			migrate_failures++;
 			continue;
-		age = (now - last) / 1000000ULL;
-		if (age > timeout)
-			gr_conn_destroy(conn);
+		}
 	}
+
+	return n < max;
 }
 
-void gr_conn_snat44_purge(struct snat44_policy *policy) {
-	struct rte_hash *h = atomic_load(&conn_hash);
-	uint32_t next = 0;
+// Destroy the connections that could not be copied to the new table.
+static void migrate_drop_remaining(struct rte_hash *old, struct rte_hash *h) {
+	unsigned dropped = 0;
+	uint32_t iter = 0;
 	struct conn *conn;
 	const void *key;
 	void *data;
 
-	while (rte_hash_iterate(h, &key, &data, &next) >= 0) {
+	while (rte_hash_iterate(old, &key, &data, &iter) >= 0) {
 		if (conn_flow(data) != CONN_FLOW_FWD)
 			continue;
 		conn = conn_ptr(data);
-		if (conn->nat.policy == policy)
+		if (rte_hash_lookup(h, &conn->fwd_key) >= 0)
+			continue;
+		gr_conn_destroy(conn);
+		dropped++;
+	}
+
+	if (dropped > 0)
+		LOG(NOTICE, "%u connections did not fit in the new table, destroyed", dropped);
+}
+
+static void migrate_schedule(bool backoff) {
+	struct timeval tv = {.tv_usec = 1000};
+
+	if (backoff)
+		tv = (struct timeval) {.tv_sec = MIGRATE_BACKOFF_SEC};
+
+	migrate_backoff = backoff;
+	event_del(migrate_timer);
+	event_add(migrate_timer, &tv);
+}
+
+static void migrate_done(struct rte_hash *old) {
+	atomic_store(&conn_hash_old, NULL);
+	gr_rcu_hash_free(old);
+	event_del(migrate_timer);
+
+	LOG(INFO, "conntrack table resize complete");
+}
+
+static void do_migrate(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	struct rte_hash *old = atomic_load(&conn_hash_old);
+	struct rte_hash *h = atomic_load(&conn_hash);
+
+	if (old == NULL) {
+		event_del(migrate_timer);
+		return;
+	}
+
+	if (migrate_backoff)
+		migrate_schedule(false); // new pass, process the next batches quickly
+
+	if (!migrate_batch(old, h, MIGRATE_BATCH))
+		return; // more entries to process on next run
+
+	migrate_iter = 0;
+	if (migrate_failures > 0) {
+		// Hash collisions in the new table. Keep the previous one for
+		// lookups and try again when some connections have expired.
+		LOG(DEBUG, "%u connections could not be migrated, retrying", migrate_failures);
+		migrate_failures = 0;
+		migrate_schedule(true);
+		return;
+	}
+
+	migrate_done(old);
+}
+
+static void do_ageing(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	clock_t now = gr_clock_us(), deadline;
+	struct conn_list *slot, expiring;
+	uint64_t latency;
+	struct conn *conn;
+
+	conn_wheel_drain();
+	retired_pools_gc();
+
+	for (unsigned n = 0; n < WHEEL_SLOTS && wheel.current <= now / CLOCKS_PER_SEC; n++) {
+		slot = &wheel.slots[wheel.current & (WHEEL_SLOTS - 1)];
+		wheel.current++;
+
+		LIST_INIT(&expiring);
+		while ((conn = LIST_FIRST(slot)) != NULL) {
+			LIST_REMOVE(conn, wheel_next);
+			LIST_INSERT_HEAD(&expiring, conn, wheel_next);
+		}
+
+		while ((conn = LIST_FIRST(&expiring)) != NULL) {
+			LIST_REMOVE(conn, wheel_next);
+			ageing_stats.scanned++;
+
+			deadline = conn_deadline(conn);
+			if (now <= deadline) {
+				conn_wheel_schedule(conn);
+				continue;
+			}
+
+			latency = (now - deadline) / CLOCKS_PER_SEC;
+			if (latency >= EXPIRY_LATENCY_SLOTS)
+				latency = EXPIRY_LATENCY_SLOTS - 1;
+			ageing_stats.latency[latency]++;
+			ageing_stats.expired++;
+
+			conn->wheel_next.le_prev = NULL;
+			gr_conn_destroy(conn);
+		}
+	}
+
+	// The timer was late by more than a full wheel turn, all slots were visited.
+	if (wheel.current <= now / CLOCKS_PER_SEC)
+		wheel.current = now / CLOCKS_PER_SEC + 1;
+}
+
+void gr_conn_snat44_purge(struct snat44_policy *policy) {
+	struct conn_iter it = {0};
+	struct conn *conn;
+	conn_flow_t flow;
+
+	while ((conn = conn_next(&it, &flow)) != NULL) {
+		if (flow == CONN_FLOW_FWD && conn->nat.policy == policy)
 			gr_conn_destroy(conn);
 	}
+
+	// The ports of the destroyed connections are released to the policy
+	// pools after a grace period. Wait for it before the policy is freed.
+	gr_rcu_defer_flush();
+}
+
+// Called once all datapath workers have gone through a quiescent state.
+// The translated port may be allocated again to another connection only
+// when the previous one can no longer be matched by datapath workers.
+static void conn_free(void *c) {
+	struct conn *conn = c;
+	gr_conn_snat44_free_port(conn->nat.policy, conn->fwd_key.proto, conn->nat.tran_id);
+	rte_mempool_put(rte_mempool_from_obj(conn), conn);
+}
+
+static unsigned conn_used_count(void) {
+	struct conn_iter it = {0};
+	unsigned count = 0;
+	conn_flow_t flow;
+
+	while (conn_next(&it, &flow) != NULL) {
+		if (flow == CONN_FLOW_FWD)
+			count++;
+	}
+
+	return count;
 }
 
 void gr_conn_destroy(struct conn *conn) {
+	// Make sure that the connection is linked in the timer wheel, if it
+	// is still waiting in the ring, it would be referenced after free.
+	conn_wheel_drain();
+	if (conn->wheel_next.le_prev != NULL)
+		LIST_REMOVE(conn, wheel_next);
+
 	rte_hash_del_key(conn_hash, &conn->fwd_key);
 	rte_hash_del_key(conn_hash, &conn->rev_key);
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-	gr_conn_snat44_free_port(conn->nat.policy, conn->fwd_key.proto, conn->nat.tran_id);
-	rte_mempool_put(rte_mempool_from_obj(conn), conn);
+	if (conn_hash_old != NULL) {
+		rte_hash_del_key(conn_hash_old, &conn->fwd_key);
+		rte_hash_del_key(conn_hash_old, &conn->rev_key);
+	}
+	gr_rcu_defer(conn_free, conn);
+}
+
+static bool timeouts_lowered(const struct gr_conntrack_config *old) {
+	return conf.timeout_closed_sec < old->timeout_closed_sec
+		|| conf.timeout_new_sec < old->timeout_new_sec
+		|| conf.timeout_udp_established_sec < old->timeout_udp_established_sec
+		|| conf.timeout_tcp_established_sec < old->timeout_tcp_established_sec
+		|| conf.timeout_half_close_sec < old->timeout_half_close_sec
+		|| conf.timeout_time_wait_sec < old->timeout_time_wait_sec;
 }
 
 static int config_update(const struct gr_conntrack_config *new_conf) {
+	struct gr_conntrack_config old_conf = conf;
+
 	if ((new_conf->max_count != 0 && new_conf->max_count != conf.max_count)
 	    || conn_hash == NULL) {
-		uint32_t iter = 0;
-		const void *key;
+		struct rte_hash *pending = conn_hash_old;
 		char name[128];
-		void *data;
 
-		if (conn_hash != NULL && rte_hash_iterate(conn_hash, &key, &data, &iter) >= 0)
-			return errno_set(EBUSY);
+		if (conn_hash != NULL && new_conf->max_count < conn_used_count())
+			return errno_set(ENOSPC);
 
-		snprintf(name, sizeof(name), "conn-%u", new_conf->max_count);
+		if (pending != NULL) {
+			// A previous resize is still in progress. Complete it now,
+			// connections that do not fit in its table are destroyed.
+			migrate_iter = 0;
+			migrate_batch(pending, conn_hash, UINT32_MAX);
+			migrate_drop_remaining(pending, conn_hash);
+			migrate_done(pending);
+		}
+
+		snprintf(name, sizeof(name), "conn-%u-%u", new_conf->max_count, table_gen);
 
 		struct rte_mempool *p = rte_mempool_create(
 			name,
@@ -516,25 +924,51 @@ static int config_update(const struct gr_conntrack_config *new_conf) {
 			return errno_log(rte_errno, "rte_hash_create(conn)");
 		}
 
-		struct rte_hash_rcu_config ct_config = {
-			.v = gr_datapath_rcu(),
-			.mode = RTE_HASH_QSBR_MODE_SYNC,
-		};
-		if (rte_hash_rcu_qsbr_add(h, &ct_config) != 0) {
+		if (gr_rcu_hash_attach(h, NULL, NULL) < 0) {
 			rte_mempool_free(p);
 			rte_hash_free(h);
-			return errno_log(rte_errno, "rte_hash_rcu_qsbr_add(conn)");
+			return errno_log(errno, "gr_rcu_hash_attach(conn)");
+		}
+
+		snprintf(name, sizeof(name), "conn-new-%u-%u", new_conf->max_count, table_gen);
+		struct rte_ring *r = rte_ring_create(
+			name, new_conf->max_count, SOCKET_ID_ANY, RING_F_EXACT_SZ | RING_F_SC_DEQ
+		);
+		if (r == NULL) {
+			rte_mempool_free(p);
+			gr_rcu_hash_free(h);
+			return errno_log(rte_errno, "rte_ring_create(conn)");
 		}
 
 		struct rte_mempool *old_pool = conn_pool;
 		struct rte_hash *old_hash = conn_hash;
-		conn_pool = p;
+		struct rte_ring *old_ring = conn_ring;
+		table_gen++;
+		// Lookups load conn_hash before conn_hash_old. A worker that sees the
+		// new table is guaranteed to also see the previous one.
+		conn_hash_old = old_hash;
 		conn_hash = h;
+		conn_pool = p;
+		conn_ring = r;
 
-		// Wait until all datapath workers have done a round of main loop before freeing.
+		// Wait until all datapath workers have done a round of main loop.
 		rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-		rte_mempool_free(old_pool);
-		rte_hash_free(old_hash);
+		if (old_ring != NULL) {
+			conn_wheel_drain_ring(old_ring);
+			rte_ring_free(old_ring);
+		}
+		if (old_pool != NULL)
+			vec_add(retired_pools, old_pool);
+		retired_pools_gc();
+		if (old_hash != NULL) {
+			// Copy existing connections to the new table in the background.
+			migrate_iter = 0;
+			migrate_failures = 0;
+			migrate_backoff = false;
+			do_migrate(-1, 0, NULL);
+			if (conn_hash_old != NULL && !migrate_backoff)
+				migrate_schedule(false);
+		}
 
 		conf.max_count = new_conf->max_count;
 	}
@@ -557,20 +991,21 @@ static int config_update(const struct gr_conntrack_config *new_conf) {
 	if (new_conf->timeout_time_wait_sec != 0)
 		conf.timeout_time_wait_sec = new_conf->timeout_time_wait_sec;
 
+	if (conn_hash != NULL && timeouts_lowered(&old_conf))
+		conn_wheel_reschedule();
+
 	return 0;
 }
 
 static struct api_out conntrack_list(const void * /*request*/, struct api_ctx *ctx) {
+	struct conn_iter it = {0};
 	struct conn *conn;
-	uint32_t next = 0;
-	const void *key;
-	void *data;
+	conn_flow_t flow;
 
-	while (rte_hash_iterate(conn_hash, &key, &data, &next) >= 0) {
-		if (conn_flow(data) != CONN_FLOW_FWD)
+	while ((conn = conn_next(&it, &flow)) != NULL) {
+		if (flow != CONN_FLOW_FWD)
 			continue;
 
-		conn = conn_ptr(data);
 		struct gr_conntrack ct = {
 			.id = (uintptr_t)conn,
 			.iface_id = conn->fwd_key.iface_id,
@@ -598,15 +1033,12 @@ static struct api_out conntrack_list(const void * /*request*/, struct api_ctx *c
 }
 
 static struct api_out conntrack_flush(const void * /*request*/, struct api_ctx *) {
+	struct conn_iter it = {0};
 	struct conn *conn;
-	const void *key;
-	uint32_t iter;
-	void *data;
+	conn_flow_t flow;
 
-	iter = 0;
-	while (rte_hash_iterate(conn_hash, &key, &data, &iter) >= 0) {
-		conn = conn_ptr(data);
-		if (conn_flow(data) != CONN_FLOW_FWD)
+	while ((conn = conn_next(&it, &flow)) != NULL) {
+		if (flow != CONN_FLOW_FWD)
 			continue;
 		gr_conn_destroy(conn);
 	}
@@ -625,29 +1057,26 @@ static struct api_out config_set(const void *request, struct api_ctx *) {
 
 static struct api_out config_get(const void * /*request*/, struct api_ctx *) {
 	struct gr_conntrack_conf_get_resp *resp = malloc(sizeof(*resp));
-	const void *key;
-	uint32_t iter;
-	void *data;
 
 	if (resp == NULL)
 		return api_out(ENOMEM, 0, NULL);
 
 	resp->base = conf;
-	resp->used_count = 0;
-
-	iter = 0;
-	while (rte_hash_iterate(conn_hash, &key, &data, &iter) >= 0) {
-		if (conn_flow(data) == CONN_FLOW_FWD)
-			resp->used_count++;
-	}
+	resp->used_count = conn_used_count();
 
 	return api_out(0, sizeof(*resp), resp);
 }
 
 static void conntrack_init(struct event_base *ev_base) {
+	migrate_timer = event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, do_migrate, NULL);
+	if (migrate_timer == NULL)
+		ABORT("event_new() failed");
+
 	if (config_update(&conf) < 0)
 		ABORT("conntrack config_update");
 
+	wheel.current = gr_clock_us() / CLOCKS_PER_SEC;
+
 	ageing_timer = event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, do_ageing, NULL);
 	if (ageing_timer == NULL)
 		ABORT("event_new() failed");
@@ -659,13 +1088,54 @@ static void conntrack_init(struct event_base *ev_base) {
 static void conntrack_fini(struct event_base *) {
 	if (ageing_timer)
 		event_free(ageing_timer);
-	rte_hash_free(conn_hash);
+	if (migrate_timer)
+		event_free(migrate_timer);
+	gr_rcu_hash_free(conn_hash_old);
+	gr_rcu_hash_free(conn_hash);
+	gr_rcu_defer_flush();
 	rte_mempool_free(conn_pool);
+	rte_ring_free(conn_ring);
+	vec_foreach (struct rte_mempool *pool, retired_pools)
+		rte_mempool_free(pool);
+	vec_free(retired_pools);
 }
 
+METRIC_COUNTER(m_scanned, "conntrack_ageing_scanned", "Connections visited by the ageing timer.");
+METRIC_COUNTER(m_expired, "conntrack_expired", "Connections destroyed after their timeout.");
+METRIC_GAUGE(m_pending, "conntrack_ageing_pending", "New connections waiting to be scheduled.");
+METRIC_HISTOGRAM(
+	m_latency,
+	"conntrack_expiry_latency_seconds",
+	"Delay between connection timeout and destruction."
+);
+
+static const unsigned expiry_latency_buckets[] = {0, 1, 2, 4, 8};
+
+static void conntrack_metrics_collect(struct metrics_writer *w) {
+	struct metrics_ctx ctx;
+
+	metrics_ctx_init(&ctx, w, NULL);
+	metric_emit(&ctx, &m_scanned, ageing_stats.scanned);
+	metric_emit(&ctx, &m_expired, ageing_stats.expired);
+	metric_emit(&ctx, &m_pending, rte_ring_count(conn_ring));
+	metric_emit_histogram(
+		&ctx,
+		&m_latency,
+		ageing_stats.latency,
+		EXPIRY_LATENCY_SLOTS,
+		expiry_latency_buckets,
+		ARRAY_DIM(expiry_latency_buckets)
+	);
+}
+
+static struct metrics_collector conntrack_collector = {
+	.name = "conntrack",
+	.collect = conntrack_metrics_collect,
+};
+
 static struct module module = {
 	.name = "conntrack",
-	.depends_on = "rcu",
+	.depends_on = "rcu_defer",
 	.init = conntrack_init,
 	.fini = conntrack_fini,
 };
@@ -676,4 +1146,5 @@ RTE_INIT(_init) {
 	api_handler(GR_CONNTRACK_FLUSH, conntrack_flush);
 	api_handler(GR_CONNTRACK_CONF_SET, config_set);
 	api_handler(GR_CONNTRACK_CONF_GET, config_get);
+	metrics_register(&conntrack_collector);
 }
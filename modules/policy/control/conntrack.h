@@ -45,6 +45,8 @@ struct conn {
 	_Atomic(gr_conn_state_t) state;
 	_Atomic(clock_t) last_update;
 	struct nat44 nat;
+	// Expiry timer wheel linkage. Only used by the control plane.
+	LIST_ENTRY(conn) wheel_next;
 };
 
 bool gr_conn_parse_key(
@@ -54,6 +56,8 @@ bool gr_conn_parse_key(
 	struct conn_key *
 );
 struct conn *gr_conn_lookup(const struct conn_key *, conn_flow_t *);
+// Resolve n connections at once. conns[i] is set to NULL when keys[i] is unknown.
+void gr_conn_lookup_bulk(const struct conn_key **, struct conn **, conn_flow_t *, unsigned n);
 struct conn *gr_conn_insert(const struct conn_key *fwd, const struct conn_key *rev);
 void gr_conn_update(struct conn *, const conn_flow_t, const struct rte_tcp_hdr *);
 void gr_conn_destroy(struct conn *);
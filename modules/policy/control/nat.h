@@ -12,6 +12,7 @@
 #include <gr_net_types.h>
 
 #include <rte_byteorder.h>
+#include <rte_spinlock.h>
 
 int snat44_static_policy_add(struct iface *, ip4_addr_t match, ip4_addr_t replace);
 int snat44_static_policy_del(struct iface *, ip4_addr_t match);
@@ -21,11 +22,29 @@ int snat44_dynamic_policy_add(const struct gr_snat44_policy *);
 int snat44_dynamic_policy_del(const struct gr_snat44_policy *);
 vec struct gr_snat44_policy *snat44_dynamic_policy_export(void);
 
+// Block of ports/IDs reserved from a policy pool by a single datapath worker.
+// The lock is only contended when the control plane returns the ports of an
+// idle block to the shared pool.
+struct snat44_port_block {
+	rte_spinlock_t lock;
+	uint32_t first;
+	uint64_t free; // bit N set means (first + N) is available
+	uint64_t last_used; // TSC
+};
+
+struct snat44_lcore_ports {
+	struct snat44_port_block tcp;
+	struct snat44_port_block udp;
+	struct snat44_port_block icmp;
+} __rte_cache_aligned;
+
 struct snat44_policy {
 	BASE(gr_snat44_policy);
 	struct id_pool *tcp_ports;
 	struct id_pool *udp_ports;
 	struct id_pool *icmp_ids;
+	// Per-lcore port blocks to avoid contention on the shared pools.
+	struct snat44_lcore_ports *lcore_ports; // [RTE_MAX_LCORE]
 	STAILQ_ENTRY(snat44_policy) next;
 };
 
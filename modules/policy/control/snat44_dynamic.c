@@ -3,23 +3,104 @@
 
 #include "conntrack.h"
 #include "id_pool.h"
+#include "log.h"
+#include "module.h"
 #include "nat.h"
 #include "rcu.h"
 #include "vec.h"
 
+#include <event2/event.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
 #include <rte_malloc.h>
+#include <rte_random.h>
+#include <rte_rib.h>
 
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
 
 static STAILQ_HEAD(, snat44_policy) policies = STAILQ_HEAD_INITIALIZER(policies);
 
+// Per interface index of policies by source prefix.
+//
+// Each RIB is read by datapath workers without locking. It is never modified
+// in place: every policy change builds a new RIB for the interface which
+// replaces the previous one. The old RIB is freed after an RCU grace period.
+static _Atomic(struct rte_rib *) iface_ribs[GR_MAX_IFACES];
+static unsigned rib_gen;
+
+static void policy_free(struct snat44_policy *policy) {
+	if (policy == NULL)
+		return;
+	id_pool_destroy(policy->tcp_ports);
+	id_pool_destroy(policy->udp_ports);
+	id_pool_destroy(policy->icmp_ids);
+	rte_free(policy->lcore_ports);
+	rte_free(policy);
+}
+
+static int policy_rib_rebuild(uint16_t iface_id) {
+	struct rte_rib *rib, *old_rib;
+	struct snat44_policy *p;
+	struct rte_rib_node *rn;
+	char name[RTE_RIB_NAMESIZE];
+	unsigned count = 0;
+
+	STAILQ_FOREACH (p, &policies, next) {
+		if (p->iface_id == iface_id)
+			count++;
+	}
+
+	rib = NULL;
+	if (count > 0) {
+		snprintf(name, sizeof(name), "snat44-%u-%u", iface_id, rib_gen++);
+		rib = rte_rib_create(
+			name,
+			SOCKET_ID_ANY,
+			&(struct rte_rib_conf) {
+				// intermediate nodes included
+				.max_nodes = count * 2,
+			}
+		);
+		if (rib == NULL)
+			return errno_log(rte_errno, "rte_rib_create");
+
+		STAILQ_FOREACH (p, &policies, next) {
+			if (p->iface_id != iface_id)
+				continue;
+			rn = rte_rib_insert(rib, rte_be_to_cpu_32(p->net.ip), p->net.prefixlen);
+			if (rn == NULL) {
+				rte_rib_free(rib);
+				return errno_log(rte_errno, "rte_rib_insert");
+			}
+			rte_rib_set_nh(rn, (uintptr_t)p);
+		}
+	}
+
+	old_rib = atomic_exchange(&iface_ribs[iface_id], rib);
+	if (old_rib != NULL) {
+		rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
+		rte_rib_free(old_rib);
+	}
+
+	return 0;
+}
+
 int snat44_dynamic_policy_add(const struct gr_snat44_policy *p) {
 	struct iface *iface = iface_from_id(p->iface_id);
 	struct snat44_policy *policy;
+	struct rte_rib *rib;
+	int ret;
 
 	if (iface == NULL)
 		return -errno;
 
+	rib = atomic_load(&iface_ribs[iface->id]);
+	if (rib != NULL
+	    && rte_rib_lookup_exact(rib, rte_be_to_cpu_32(p->net.ip), p->net.prefixlen) != NULL)
+		return errno_set(EEXIST);
+
 	policy = rte_zmalloc(__func__, sizeof(*policy), RTE_CACHE_LINE_SIZE);
 	if (policy == NULL)
 		return errno_set(ENOMEM);
@@ -34,16 +115,25 @@ int snat44_dynamic_policy_add(const struct gr_snat44_policy *p) {
 	policy->icmp_ids = id_pool_create(1, 65535);
 	if (policy->icmp_ids == NULL)
 		goto err;
+	policy->lcore_ports = rte_zmalloc(
+		__func__, RTE_MAX_LCORE * sizeof(*policy->lcore_ports), RTE_CACHE_LINE_SIZE
+	);
+	if (policy->lcore_ports == NULL)
+		goto err;
 
 	STAILQ_INSERT_TAIL(&policies, policy, next);
+
+	if ((ret = policy_rib_rebuild(iface->id)) < 0) {
+		STAILQ_REMOVE(&policies, policy, snat44_policy, next);
+		policy_free(policy);
+		return ret;
+	}
+
 	iface->flags |= GR_IFACE_F_SNAT_DYNAMIC;
 
 	return 0;
 err:
-	id_pool_destroy(policy->tcp_ports);
-	id_pool_destroy(policy->udp_ports);
-	id_pool_destroy(policy->icmp_ids);
-	rte_free(policy);
+	policy_free(policy);
 	return errno_set(ENOMEM);
 }
 
@@ -51,6 +141,7 @@ int snat44_dynamic_policy_del(const struct gr_snat44_policy *policy) {
 	struct iface *iface = iface_from_id(policy->iface_id);
 	struct snat44_policy *p, *found;
 	unsigned iface_count;
+	int ret;
 
 	if (iface == NULL)
 		return -errno;
@@ -72,13 +163,15 @@ int snat44_dynamic_policy_del(const struct gr_snat44_policy *policy) {
 	if (iface_count == 0)
 		iface->flags &= ~GR_IFACE_F_SNAT_DYNAMIC;
 
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
+	// This waits for an RCU grace period if the policy was indexed.
+	if ((ret = policy_rib_rebuild(iface->id)) < 0) {
+		STAILQ_INSERT_TAIL(&policies, found, next);
+		iface->flags |= GR_IFACE_F_SNAT_DYNAMIC;
+		return ret;
+	}
 
 	gr_conn_snat44_purge(found);
-	id_pool_destroy(found->tcp_ports);
-	id_pool_destroy(found->udp_ports);
-	id_pool_destroy(found->icmp_ids);
-	rte_free(found);
+	policy_free(found);
 
 	return 0;
 }
@@ -94,16 +187,93 @@ vec struct gr_snat44_policy *snat44_dynamic_policy_export(void) {
 }
 
 static struct snat44_policy *snat44_dynamic_policy_lookup(const struct conn_key *key) {
-	struct snat44_policy *p;
+	struct rte_rib *rib = atomic_load(&iface_ribs[key->iface_id]);
+	struct rte_rib_node *rn;
+	uint64_t policy;
 
-	STAILQ_FOREACH (p, &policies, next) {
-		if (p->iface_id != key->iface_id)
-			continue;
-		if (ip4_addr_same_subnet(key->src, p->net.ip, p->net.prefixlen))
-			return p;
+	if (rib == NULL)
+		return NULL;
+
+	rn = rte_rib_lookup(rib, rte_be_to_cpu_32(key->src));
+	if (rn == NULL)
+		return NULL;
+
+	rte_rib_get_nh(rn, &policy);
+
+	return (struct snat44_policy *)(uintptr_t)policy;
+}
+
+// Get a random port from the calling worker block, refilling it from the
+// shared pool when empty. Ports are returned individually to the shared pool
+// on release.
+static uint16_t snat44_port_get(struct id_pool *pool, struct snat44_port_block *block) {
+	uint64_t free, rand;
+	uint16_t port;
+	unsigned bit;
+
+	rte_spinlock_lock(&block->lock);
+
+	if (block->free == 0) {
+		block->first = id_pool_get_block_random(pool, &block->free);
+		if (block->first == 0) {
+			rte_spinlock_unlock(&block->lock);
+			return 0;
+		}
+	}
+
+	// Translated ports must not be predictable. Pick the first available
+	// port starting from a random offset in the block.
+	rand = rte_rand_max(64);
+	free = block->free;
+	if (rand != 0)
+		free = (free >> rand) | (free << (64 - rand));
+	bit = (rand + rte_ctz64(free)) % 64;
+
+	block->free &= ~GR_BIT64(bit);
+	block->last_used = rte_rdtsc();
+	port = block->first + bit;
+
+	rte_spinlock_unlock(&block->lock);
+
+	return port;
+}
+
+static rte_be16_t snat44_port_alloc(struct snat44_policy *policy, uint8_t proto) {
+	struct snat44_lcore_ports *ports;
+	unsigned lcore_id = rte_lcore_id();
+	uint16_t port = 0;
+
+	if (lcore_id >= RTE_MAX_LCORE) {
+		// Not called from a datapath worker.
+		switch (proto) {
+		case IPPROTO_TCP:
+			port = id_pool_get_random(policy->tcp_ports);
+			break;
+		case IPPROTO_UDP:
+			port = id_pool_get_random(policy->udp_ports);
+			break;
+		case IPPROTO_ICMP:
+			port = id_pool_get_random(policy->icmp_ids);
+			break;
+		}
+		return rte_cpu_to_be_16(port);
+	}
+
+	ports = &policy->lcore_ports[lcore_id];
+
+	switch (proto) {
+	case IPPROTO_TCP:
+		port = snat44_port_get(policy->tcp_ports, &ports->tcp);
+		break;
+	case IPPROTO_UDP:
+		port = snat44_port_get(policy->udp_ports, &ports->udp);
+		break;
+	case IPPROTO_ICMP:
+		port = snat44_port_get(policy->icmp_ids, &ports->icmp);
+		break;
 	}
 
-	return NULL;
+	return rte_cpu_to_be_16(port);
 }
 
 struct conn *snat44_conntrack_create(const struct conn_key *fwd_key) {
@@ -122,19 +292,15 @@ struct conn *snat44_conntrack_create(const struct conn_key *fwd_key) {
 	rev_key.proto = fwd_key->proto;
 	rev_key.iface_id = fwd_key->iface_id;
 
+	trans_port = snat44_port_alloc(policy, fwd_key->proto);
+
 	switch (fwd_key->proto) {
 	case IPPROTO_TCP:
-		trans_port = rte_cpu_to_be_16(id_pool_get_random(policy->tcp_ports));
-		rev_key.src_id = fwd_key->dst_id;
-		rev_key.dst_id = trans_port;
-		break;
 	case IPPROTO_UDP:
-		trans_port = rte_cpu_to_be_16(id_pool_get_random(policy->udp_ports));
 		rev_key.src_id = fwd_key->dst_id;
 		rev_key.dst_id = trans_port;
 		break;
 	case IPPROTO_ICMP:
-		trans_port = rte_cpu_to_be_16(id_pool_get_random(policy->icmp_ids));
 		rev_key.src_id = trans_port;
 		rev_key.dst_id = trans_port;
 		break;
@@ -173,3 +339,69 @@ void gr_conn_snat44_free_port(struct snat44_policy *p, uint8_t proto, rte_be16_t
 		break;
 	}
 }
+
+#define SNAT44_BLOCK_IDLE_SEC 10
+
+// Return the unused ports of a worker block to the shared pool.
+static void snat44_port_block_release(struct id_pool *pool, struct snat44_port_block *block) {
+	uint64_t free = block->free;
+
+	while (free != 0) {
+		id_pool_put(pool, block->first + rte_ctz64(free));
+		free &= free - 1;
+	}
+	block->free = 0;
+}
+
+static void
+snat44_port_block_reclaim(struct id_pool *pool, struct snat44_port_block *block, uint64_t idle) {
+	if (!rte_spinlock_trylock(&block->lock))
+		return; // in use
+	if (block->free != 0 && rte_rdtsc() - block->last_used > idle)
+		snat44_port_block_release(pool, block);
+	rte_spinlock_unlock(&block->lock);
+}
+
+// Workers that stopped creating connections for a policy would otherwise keep
+// their reserved ports forever, draining the shared pools over time.
+static void do_block_reclaim(evutil_socket_t, short /*what*/, void * /*priv*/) {
+	uint64_t idle = SNAT44_BLOCK_IDLE_SEC * rte_get_tsc_hz();
+	struct snat44_lcore_ports *ports;
+	struct snat44_policy *p;
+
+	STAILQ_FOREACH (p, &policies, next) {
+		for (unsigned i = 0; i < RTE_MAX_LCORE; i++) {
+			ports = &p->lcore_ports[i];
+			snat44_port_block_reclaim(p->tcp_ports, &ports->tcp, idle);
+			snat44_port_block_reclaim(p->udp_ports, &ports->udp, idle);
+			snat44_port_block_reclaim(p->icmp_ids, &ports->icmp, idle);
+		}
+	}
+}
+
+static struct event *reclaim_timer;
+
+static void snat44_dynamic_init(struct event_base *ev_base) {
+	reclaim_timer = event_new(ev_base, -1, EV_PERSIST | EV_FINALIZE, do_block_reclaim, NULL);
+	if (reclaim_timer == NULL)
+		ABORT("event_new() failed");
+
+	if (event_add(reclaim_timer, &(struct timeval) {.tv_sec = 1}) < 0)
+		ABORT("event_add() failed");
+}
+
+static void snat44_dynamic_fini(struct event_base *) {
+	if (reclaim_timer)
+		event_free(reclaim_timer);
+	reclaim_timer = NULL;
+}
+
+static struct module module = {
+	.name = "snat44_dynamic",
+	.init = snat44_dynamic_init,
+	.fini = snat44_dynamic_fini,
+};
+
+RTE_INIT(_init) {
+	module_register(&module);
+}
@@ -25,6 +25,7 @@ static uint16_t dnat44_dynamic_process(
 	uint16_t nb_objs
 ) {
 	const struct nexthop_info_l3 *l3;
+	struct gr_node_batch batch;
 	struct conn_mbuf_data *c;
 	struct rte_ipv4_hdr *ip;
 	struct l3_mbuf_data *o;
@@ -33,6 +34,7 @@ static uint16_t dnat44_dynamic_process(
 	rte_edge_t edge;
 	uint16_t i;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		m = objs[i];
 
@@ -109,9 +111,11 @@ static uint16_t dnat44_dynamic_process(
 			struct rte_ipv4_hdr *t = gr_mbuf_trace_add(m, node, sizeof(*t));
 			*t = *ip;
 		}
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -25,12 +25,14 @@ static uint16_t dnat44_static_process(
 ) {
 	const struct nexthop_info_dnat *dnat;
 	const struct nexthop_info_l3 *l3;
+	struct gr_node_batch batch;
 	struct rte_ipv4_hdr *ip;
 	struct l3_mbuf_data *d;
 	struct rte_mbuf *mbuf;
 	uint16_t i, frag;
 	rte_edge_t edge;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (i = 0; i < nb_objs; i++) {
 		mbuf = objs[i];
 
@@ -92,9 +94,11 @@ static uint16_t dnat44_static_process(
 			struct rte_ipv4_hdr *t = gr_mbuf_trace_add(mbuf, node, sizeof(*t));
 			*t = *ip;
 		}
-		rte_node_enqueue_x1(graph, node, edge, mbuf);
+		gr_node_batch_enqueue(&batch, edge, mbuf);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -9,6 +9,7 @@
 #include <gr_nat.h>
 #include <gr_net_types.h>
 
+#include <rte_graph.h>
 #include <rte_ip.h>
 
 GR_NH_TYPE_INFO(GR_NH_T_DNAT, nexthop_info_dnat, {
@@ -52,16 +53,50 @@ typedef enum {
 } nat_verdict_t;
 
 nat_verdict_t snat44_static_process(const struct iface *, struct rte_mbuf *);
-nat_verdict_t snat44_dynamic_process(const struct iface *, struct rte_mbuf *);
-
-static inline nat_verdict_t snat44_process(const struct iface *iface, struct rte_mbuf *mbuf) {
-	nat_verdict_t verdict = NAT_VERDICT_CONTINUE;
-
-	if (iface->flags & GR_IFACE_F_SNAT_STATIC)
-		verdict = snat44_static_process(iface, mbuf);
-
-	if (verdict == NAT_VERDICT_CONTINUE && iface->flags & GR_IFACE_F_SNAT_DYNAMIC)
-		verdict = snat44_dynamic_process(iface, mbuf);
-
-	return verdict;
+void snat44_dynamic_process_bulk(
+	const struct iface **,
+	struct rte_mbuf **,
+	nat_verdict_t *,
+	uint16_t n
+);
+
+// Apply source NAT to n packets, at most RTE_GRAPH_BURST_SIZE.
+//
+// Static translations are applied first. Packets that did not match any static
+// rule are then resolved against the connection tracking table in one bulk
+// lookup if their output interface has dynamic source NAT enabled.
+static inline void snat44_process_bulk(
+	const struct iface **ifaces,
+	struct rte_mbuf **mbufs,
+	nat_verdict_t *verdicts,
+	uint16_t n
+) {
+	const struct iface *dyn_ifaces[RTE_GRAPH_BURST_SIZE];
+	struct rte_mbuf *dyn_mbufs[RTE_GRAPH_BURST_SIZE];
+	nat_verdict_t dyn_verdicts[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	uint16_t i, n_dyn = 0;
+
+	for (i = 0; i < n; i++) {
+		verdicts[i] = NAT_VERDICT_CONTINUE;
+
+		if (ifaces[i]->flags & GR_IFACE_F_SNAT_STATIC)
+			verdicts[i] = snat44_static_process(ifaces[i], mbufs[i]);
+
+		if (verdicts[i] == NAT_VERDICT_CONTINUE
+		    && ifaces[i]->flags & GR_IFACE_F_SNAT_DYNAMIC) {
+			dyn_ifaces[n_dyn] = ifaces[i];
+			dyn_mbufs[n_dyn] = mbufs[i];
+			idx[n_dyn] = i;
+			n_dyn++;
+		}
+	}
+
+	if (n_dyn == 0)
+		return;
+
+	snat44_dynamic_process_bulk(dyn_ifaces, dyn_mbufs, dyn_verdicts, n_dyn);
+
+	for (i = 0; i < n_dyn; i++)
+		verdicts[idx[i]] = dyn_verdicts[i];
 }
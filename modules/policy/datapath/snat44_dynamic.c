@@ -6,29 +6,15 @@
 
 #include <gr_net_types.h>
 
+#include <rte_graph.h>
 #include <rte_icmp.h>
 #include <rte_ip4.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
 
-nat_verdict_t snat44_dynamic_process(const struct iface *iface, struct rte_mbuf *m) {
+static void snat44_dynamic_translate(struct rte_mbuf *m, struct conn *conn, conn_flow_t flow) {
 	struct rte_ipv4_hdr *ip;
-	struct conn_key fwd_key;
 	struct nat44 *nat;
-	struct conn *conn;
-	conn_flow_t flow;
-
-	// Initialize conntrack key from the IP and L4 layers.
-	if (!gr_conn_parse_key(iface, GR_AF_IP4, m, &fwd_key))
-		return NAT_VERDICT_DROP; // cannot NAT this type of traffic
-
-	conn = gr_conn_lookup(&fwd_key, &flow);
-	if (conn == NULL) {
-		conn = snat44_conntrack_create(&fwd_key);
-		if (conn == NULL)
-			return NAT_VERDICT_DROP;
-		flow = CONN_FLOW_FWD;
-	}
 
 	// Perform source NAT.
 	nat = &conn->nat;
@@ -86,6 +72,53 @@ nat_verdict_t snat44_dynamic_process(const struct iface *iface, struct rte_mbuf
 		flow,
 		rte_pktmbuf_mtod_offset(m, const struct rte_tcp_hdr *, rte_ipv4_hdr_len(ip))
 	);
+}
 
-	return NAT_VERDICT_FINAL;
+void snat44_dynamic_process_bulk(
+	const struct iface **ifaces,
+	struct rte_mbuf **mbufs,
+	nat_verdict_t *verdicts,
+	uint16_t n
+) {
+	const struct conn_key *key_ptrs[RTE_GRAPH_BURST_SIZE];
+	struct conn_key keys[RTE_GRAPH_BURST_SIZE];
+	conn_flow_t flows[RTE_GRAPH_BURST_SIZE];
+	struct conn *conns[RTE_GRAPH_BURST_SIZE];
+	uint16_t idx[RTE_GRAPH_BURST_SIZE];
+	uint16_t i, j, n_keys;
+
+	// Initialize conntrack keys from the IP and L4 layers.
+	n_keys = 0;
+	for (i = 0; i < n; i++) {
+		if (gr_conn_parse_key(ifaces[i], GR_AF_IP4, mbufs[i], &keys[n_keys])) {
+			key_ptrs[n_keys] = &keys[n_keys];
+			idx[n_keys] = i;
+			n_keys++;
+		} else {
+			verdicts[i] = NAT_VERDICT_DROP; // cannot NAT this type of traffic
+		}
+	}
+
+	if (n_keys == 0)
+		return;
+
+	gr_conn_lookup_bulk(key_ptrs, conns, flows, n_keys);
+
+	for (j = 0; j < n_keys; j++) {
+		i = idx[j];
+		if (conns[j] == NULL) {
+			// An earlier packet of the same burst may have created it.
+			conns[j] = gr_conn_lookup(&keys[j], &flows[j]);
+			if (conns[j] == NULL) {
+				conns[j] = snat44_conntrack_create(&keys[j]);
+				if (conns[j] == NULL) {
+					verdicts[i] = NAT_VERDICT_DROP;
+					continue;
+				}
+				flows[j] = CONN_FLOW_FWD;
+			}
+		}
+		snat44_dynamic_translate(mbufs[i], conns[j], flows[j]);
+		verdicts[i] = NAT_VERDICT_FINAL;
+	}
 }
@@ -43,8 +43,8 @@ static int srv6_output_nh_import_info(struct nexthop *nh, const void *info) {
 	priv->n_seglist = pub->n_seglist;
 	tmp = priv->seglist;
 	priv->seglist = seglist;
-	rte_rcu_qsbr_synchronize(gr_datapath_rcu(), RTE_QSBR_THRID_INVALID);
-	rte_free(tmp);
+	if (tmp != NULL)
+		gr_rcu_defer(rte_free, tmp);
 
 	return 0;
 }
@@ -408,12 +408,14 @@ static inline rte_edge_t srv6_local_process_pkt(
 static uint16_t
 srv6_local_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
 	struct nexthop_info_srv6_local *sr_d;
+	struct gr_node_batch batch;
 	struct trace_srv6_data *t;
 	struct ip6_info ip6_info;
 	struct rte_mbuf *m;
 	rte_edge_t edge;
 	int ret;
 
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
 	for (uint16_t i = 0; i < nb_objs; i++) {
 		m = objs[i];
 		ret = ip6_fill_infos(m, &ip6_info);
@@ -435,9 +437,11 @@ srv6_local_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 		edge = srv6_local_process_pkt(m, sr_d, &ip6_info);
 
 next:
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(&batch, edge, m);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
@@ -38,9 +38,10 @@ static int trace_srv6_format(char *buf, size_t len, const void *data, size_t /*d
 		return snprintf(buf, len, "match=" IP4_NET_F, &t->dest4);
 }
 
-// called from 'ip6_output' or 'ip_output' node
-static uint16_t
-srv6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+// Pseudo edge for packets that were encapsulated and need a FIB lookup.
+#define FIB_LOOKUP ((rte_edge_t)EDGE_COUNT)
+
+static inline rte_edge_t srv6_encap(struct rte_mbuf *m, struct rte_node *node) {
 	const struct nexthop_info_srv6_output *d;
 	const struct nexthop_info_l3 *l3;
 	struct trace_srv6_data *t = NULL;
@@ -48,110 +49,165 @@ srv6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs,
 	struct rte_ipv6_hdr *outer_ip6;
 	const struct nexthop *nh;
 	uint32_t optlen, plen;
-	struct rte_mbuf *m;
 	uint8_t proto, reduc;
-	rte_edge_t edge;
 
-	for (uint16_t i = 0; i < nb_objs; i++) {
-		m = objs[i];
+	if (gr_mbuf_is_traced(m))
+		t = gr_mbuf_trace_add(m, node, sizeof(*t));
 
-		if (gr_mbuf_is_traced(m))
-			t = gr_mbuf_trace_add(m, node, sizeof(*t));
-
-		if (m->packet_type & RTE_PTYPE_L3_IPV4) {
-			struct rte_ipv4_hdr *inner_ip4;
-
-			nh = l3_mbuf_data(m)->nh;
-			if (t != NULL && nh->type == GR_NH_T_L3) {
-				l3 = nexthop_info_l3(nh);
-				t->dest4.ip = l3->ipv4;
-				t->dest4.prefixlen = l3->prefixlen;
-				t->is_dest6 = false;
-			}
-			inner_ip4 = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
-			plen = rte_be_to_cpu_16(inner_ip4->total_length);
-			proto = IPPROTO_IPIP;
-
-		} else if (m->packet_type & RTE_PTYPE_L3_IPV6) {
-			struct rte_ipv6_hdr *inner_ip6;
-
-			nh = l3_mbuf_data(m)->nh;
-			if (t != NULL && nh->type == GR_NH_T_L3) {
-				l3 = nexthop_info_l3(nh);
-				t->dest6.ip = l3->ipv6;
-				t->dest6.prefixlen = l3->prefixlen;
-				t->is_dest6 = true;
-			}
-			inner_ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
-			plen = rte_be_to_cpu_16(inner_ip6->payload_len);
-			proto = IPPROTO_IPV6;
-
-		} else {
-			edge = INVALID;
-			goto next;
-		}
+	if (m->packet_type & RTE_PTYPE_L3_IPV4) {
+		struct rte_ipv4_hdr *inner_ip4;
 
-		d = nexthop_info_srv6_output(nh);
-		if (d == NULL) {
-			edge = INVALID;
-			goto next;
+		nh = l3_mbuf_data(m)->nh;
+		if (t != NULL && nh->type == GR_NH_T_L3) {
+			l3 = nexthop_info_l3(nh);
+			t->dest4.ip = l3->ipv4;
+			t->dest4.prefixlen = l3->prefixlen;
+			t->is_dest6 = false;
 		}
+		inner_ip4 = rte_pktmbuf_mtod(m, struct rte_ipv4_hdr *);
+		plen = rte_be_to_cpu_16(inner_ip4->total_length);
+		proto = IPPROTO_IPIP;
+
+	} else if (m->packet_type & RTE_PTYPE_L3_IPV6) {
+		struct rte_ipv6_hdr *inner_ip6;
+
+		nh = l3_mbuf_data(m)->nh;
+		if (t != NULL && nh->type == GR_NH_T_L3) {
+			l3 = nexthop_info_l3(nh);
+			t->dest6.ip = l3->ipv6;
+			t->dest6.prefixlen = l3->prefixlen;
+			t->is_dest6 = true;
+		}
+		inner_ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
+		plen = rte_be_to_cpu_16(inner_ip6->payload_len);
+		proto = IPPROTO_IPV6;
 
-		// Encapsulate with another IPv6 header
-		optlen = 0;
-		reduc = d->encap == SR_H_ENCAPS_RED ? 1 : 0;
-		if (d->n_seglist > reduc)
-			optlen += sizeof(*srh) + (d->n_seglist * sizeof(d->seglist[0]));
+	} else {
+		return INVALID;
+	}
 
-		outer_ip6 = gr_mbuf_prepend(m, outer_ip6, optlen);
-		if (unlikely(outer_ip6 == NULL)) {
-			edge = NO_HEADROOM;
-			goto next;
-		}
+	d = nexthop_info_srv6_output(nh);
+	if (d == NULL)
+		return INVALID;
+
+	// Encapsulate with another IPv6 header
+	optlen = 0;
+	reduc = d->encap == SR_H_ENCAPS_RED ? 1 : 0;
+	if (d->n_seglist > reduc)
+		optlen += sizeof(*srh) + (d->n_seglist * sizeof(d->seglist[0]));
+
+	outer_ip6 = gr_mbuf_prepend(m, outer_ip6, optlen);
+	if (unlikely(outer_ip6 == NULL))
+		return NO_HEADROOM;
+
+	if (d->n_seglist > reduc) {
+		struct rte_ipv6_addr *segments;
+		uint16_t k;
+
+		srh = (struct rte_ipv6_routing_ext *)(outer_ip6 + 1);
+		srh->next_hdr = proto;
+		srh->hdr_len = optlen / 8 - 1;
+		srh->type = RTE_IPV6_SRCRT_TYPE_4;
+		srh->segments_left = d->n_seglist - 1;
+		srh->last_entry = d->n_seglist - 1;
+		srh->flags = 0;
+		srh->tag = 0;
+
+		segments = (struct rte_ipv6_addr *)(srh + 1);
+		for (k = reduc; k < d->n_seglist; k++)
+			segments[d->n_seglist - k - 1] = d->seglist[k];
+		proto = IPPROTO_ROUTING;
+		plen += optlen;
+	}
+
+	// The source address depends on the output interface. It is filled
+	// after the encapsulated packet nexthop has been resolved.
+	ip6_set_fields(
+		outer_ip6, plen, proto, &(struct rte_ipv6_addr)RTE_IPV6_ADDR_UNSPEC, &d->seglist[0]
+	);
+
+	return FIB_LOOKUP;
+}
+
+static void srv6_output_burst(
+	struct rte_node *node,
+	struct gr_node_batch *batch,
+	void **objs,
+	uint16_t nb_objs
+) {
+	const struct nexthop *nhs[RTE_GRAPH_BURST_SIZE];
+	struct rte_ipv6_addr dsts[RTE_GRAPH_BURST_SIZE];
+	uint16_t iface_ids[RTE_GRAPH_BURST_SIZE];
+	uint16_t vrf_ids[RTE_GRAPH_BURST_SIZE];
+	rte_edge_t edges[RTE_GRAPH_BURST_SIZE];
+	struct rte_ipv6_hdr *outer_ip6;
+	const struct nexthop *nh;
+	uint16_t i, n_lookup;
+	struct rte_mbuf *m;
+	rte_edge_t edge;
 
-		if (d->n_seglist > reduc) {
-			struct rte_ipv6_addr *segments;
-			uint16_t k;
-
-			srh = (struct rte_ipv6_routing_ext *)(outer_ip6 + 1);
-			srh->next_hdr = proto;
-			srh->hdr_len = optlen / 8 - 1;
-			srh->type = RTE_IPV6_SRCRT_TYPE_4;
-			srh->segments_left = d->n_seglist - 1;
-			srh->last_entry = d->n_seglist - 1;
-			srh->flags = 0;
-			srh->tag = 0;
-
-			segments = (struct rte_ipv6_addr *)(srh + 1);
-			for (k = reduc; k < d->n_seglist; k++)
-				segments[d->n_seglist - k - 1] = d->seglist[k];
-			proto = IPPROTO_ROUTING;
-			plen += optlen;
+	// Encapsulation pass: push the outer headers and collect the first
+	// segment of all packets.
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		edges[i] = srv6_encap(m, node);
+		if (edges[i] == FIB_LOOKUP) {
+			outer_ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
+			vrf_ids[n_lookup] = l3_mbuf_data(m)->nh->vrf_id;
+			iface_ids[n_lookup] = GR_IFACE_ID_UNDEF;
+			dsts[n_lookup] = outer_ip6->dst_addr;
+			n_lookup++;
 		}
+	}
 
-		// Resolve nexthop for the encapsulated packet.
-		nh = fib6_lookup(nh->vrf_id, GR_IFACE_ID_UNDEF, d->seglist);
+	// Lookup pass: resolve nexthops for all encapsulated packets at once.
+	if (n_lookup > 0)
+		ip6_fib_lookup_burst(n_lookup, vrf_ids, iface_ids, dsts, nhs);
+
+	n_lookup = 0;
+	for (i = 0; i < nb_objs; i++) {
+		m = objs[i];
+		edge = edges[i];
+		if (edge != FIB_LOOKUP)
+			goto next;
+
+		nh = nhs[n_lookup++];
 		if (nh == NULL) {
 			edge = NO_ROUTE;
 			goto next;
 		}
 		l3_mbuf_data(m)->nh = nh;
 
-		nh = sr_tunsrc_get(nh->iface_id, &d->seglist[0]);
+		outer_ip6 = rte_pktmbuf_mtod(m, struct rte_ipv6_hdr *);
+		nh = sr_tunsrc_get(nh->iface_id, &outer_ip6->dst_addr);
 		if (nh == NULL) {
 			// cannot output packet on interface that does not have ip6 addr
 			edge = NO_ROUTE;
 			goto next;
 		}
-		l3 = nexthop_info_l3(nh);
-
-		ip6_set_fields(outer_ip6, plen, proto, &l3->ipv6, &d->seglist[0]);
+		outer_ip6->src_addr = nexthop_info_l3(nh)->ipv6;
 		edge = IP6_OUTPUT;
-
 next:
-		rte_node_enqueue_x1(graph, node, edge, m);
+		gr_node_batch_enqueue(batch, edge, m);
+	}
+}
+
+// called from 'ip6_output' or 'ip_output' node
+static uint16_t
+srv6_output_process(struct rte_graph *graph, struct rte_node *node, void **objs, uint16_t nb_objs) {
+	struct gr_node_batch batch;
+	uint16_t i, n;
+
+	gr_node_batch_init(&batch, graph, node, objs, nb_objs);
+
+	for (i = 0; i < nb_objs; i += n) {
+		n = RTE_MIN(nb_objs - i, RTE_GRAPH_BURST_SIZE);
+		srv6_output_burst(node, &batch, &objs[i], n);
 	}
 
+	gr_node_batch_flush(&batch);
+
 	return nb_objs;
 }
 
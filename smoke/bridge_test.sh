@@ -32,17 +32,137 @@ for n in 0 1 2; do
 	grcli -j fdb show iface p$n learn | jq -e --arg mac "$mac" '.[] | select(.mac == $mac)'
 done
 
+fdb_learned() {
+	grcli -j fdb show iface $1 learn | jq -e --arg mac "$2" '.[] | select(.mac == $mac)' >/dev/null
+}
+
+# deleted addresses must be learned again by the next frame, not only when
+# the per-lcore learn cache period has elapsed
+fdb_relearn() {
+	local mac=$(ip netns exec n1 cat /sys/class/net/x-p1/address)
+	ip netns exec n1 ping -i0.01 -c50 -n 172.16.0.12 >/dev/null &
+	local pid=$!
+	sleep 0.2
+	grcli fdb del bridge br0 "$mac"
+	sleep 0.05
+	fdb_learned p1 "$mac" || fail "$mac was not learned again after deletion $1"
+	wait $pid
+}
+fdb_relearn
+
+# move the address of n0 to another port and back
+mac=$(ip netns exec n0 cat /sys/class/net/x-p0/address)
+mac2=$(ip netns exec n2 cat /sys/class/net/x-p2/address)
+ip -n n0 link set x-p0 down
+ip -n n2 link set x-p2 address "$mac"
+ip -n n1 neigh flush all
+ip -n n2 neigh flush all
+ip netns exec n2 ping -i0.01 -c3 -W1 -n 172.16.0.11 || fail "L2 ping after move failed"
+fdb_learned p2 "$mac" || fail "$mac should have moved to p2"
+ip -n n2 link set x-p2 address "$mac2"
+ip -n n0 link set x-p0 up
+ip -n n1 neigh flush all
+ip -n n2 neigh flush all
+ip netns exec n0 ping -i0.01 -c3 -W1 -n 172.16.0.11 || fail "L2 ping after move back failed"
+fdb_learned p0 "$mac" || fail "$mac should have moved back to p0"
+
 # overwrite dynamic learned fdb entry with static one
 mac=$(ip netns exec n0 cat /sys/class/net/x-p0/address)
 grcli fdb add "$mac" iface p0
 grcli -j fdb show iface p0 static | jq -e --arg mac "$mac" '.[] | select(.mac == $mac)'
 
+# resizing the fdb must preserve existing entries
+grcli fdb config set max 8192
+grcli -j fdb config show | jq -e '.max == 8192 and .used >= 3'
+grcli -j fdb show iface p0 static | jq -e --arg mac "$mac" '.[] | select(.mac == $mac)'
+fdb_relearn "(after resize)"
+
+# resizing back to a previous size must work and addresses deleted right after
+# the resize must not be restored from the replaced table
+mac=$(ip netns exec n2 cat /sys/class/net/x-p2/address)
+fdb_learned p2 "$mac" || fail "$mac was not learned"
+grcli fdb config set max 4096
+grcli fdb del bridge br0 "$mac"
+sleep 0.5
+fdb_learned p2 "$mac" && fail "$mac was restored after deletion"
+grcli -j fdb config show | jq -e '.max == 4096'
+
 grcli ping 172.16.0.10 count 3 delay 10
 
 ip netns exec n0 ping -i0.01 -c3 -W1 -n 172.16.0.1 || fail "L3 ping n0->bridge failed"
 ip netns exec n1 ping -i0.01 -c3 -W1 -n 172.16.0.1 || fail "L3 ping n1->bridge failed"
 ip netns exec n2 ping -i0.01 -c3 -W1 -n 172.16.0.1 || fail "L3 ping n2->bridge failed"
 
+grcli interface set bridge br0 mcast_snooping
+grcli -j interface show name br0 | jq -e '.bridge_flags | index("mcast_snooping")'
+ip netns exec n0 ping -i0.01 -c3 -W1 -n 172.16.0.1 || fail "L3 ping with snooping failed"
+grcli mdb show
+
+mdb_member() {
+	grcli -j mdb show | jq -e --arg g "$1" --arg i "$2" \
+		'.[] | select(.group == $g and .iface == $i)'
+}
+
+# n1 joins a group, frames sent by n2 must only be forwarded to n1
+ip netns exec n1 socat -u UDP4-RECV:5000,ip-add-membership=239.1.1.1:x-p1 \
+	OPEN:$tmp/mcast,creat,append &
+receiver=$!
+SECONDS=0
+while ! mdb_member 239.1.1.1 p1 >/dev/null; do
+	[ "$SECONDS" -gt 5 ] && fail "p1 did not join 239.1.1.1"
+	sleep 0.2
+done
+
+# memberships age out unless refreshed
+sleep 2
+expires=$(mdb_member 239.1.1.1 p1 | jq .expires)
+[ "$expires" -gt 0 ] && [ "$expires" -le 260 ] || fail "bad membership expiry: $expires"
+sleep 2
+[ "$(mdb_member 239.1.1.1 p1 | jq .expires)" -lt "$expires" ] \
+	|| fail "membership expiry is not decreasing"
+
+ip netns exec n0 tcpdump -ni x-p0 -w $tmp/n0.pcap udp port 5000 &
+capture=$!
+sleep 1
+for i in 1 2 3; do
+	echo mcast$i | ip netns exec n2 socat -u - \
+		UDP4-DATAGRAM:239.1.1.1:5000,ip-multicast-if=172.16.0.12
+done
+sleep 0.5
+kill $capture
+wait $capture || :
+grep -q mcast $tmp/mcast || fail "group member did not receive multicast"
+[ "$(tcpdump -nr $tmp/n0.pcap 2>/dev/null | wc -l)" -eq 0 ] \
+	|| fail "multicast forwarded to a port that is not a group member"
+
+# closing the socket sends a leave, the membership expires after the last
+# member query time since other listeners may remain behind the same port
+kill $receiver
+wait $receiver || :
+sleep 0.5
+expires=$(mdb_member 239.1.1.1 p1 | jq .expires) || fail "p1 was removed before expiry"
+[ "$expires" -le 2 ] || fail "membership was not shortened after leave: $expires"
+SECONDS=0
+while mdb_member 239.1.1.1 p1 >/dev/null; do
+	[ "$SECONDS" -gt 5 ] && fail "p1 did not leave 239.1.1.1"
+	sleep 0.2
+done
+
+# with fast leave, the membership is removed immediately
+grcli interface set bridge br0 mcast_fast_leave
+grcli -j interface show name br0 | jq -e '.bridge_flags | index("mcast_fast_leave")'
+ip netns exec n1 socat -u UDP4-RECV:5000,ip-add-membership=239.1.1.1:x-p1 /dev/null &
+receiver=$!
+SECONDS=0
+while ! mdb_member 239.1.1.1 p1 >/dev/null; do
+	[ "$SECONDS" -gt 5 ] && fail "p1 did not join 239.1.1.1"
+	sleep 0.2
+done
+kill $receiver
+wait $receiver || :
+sleep 0.5
+mdb_member 239.1.1.1 p1 >/dev/null && fail "p1 was not removed on leave with fast leave"
+
 grcli interface set port p1 vrf main
 if [ "$(grcli -j fdb show iface p1 | jq length)" -gt 0 ]; then
 	fail "fdb still contains entries for removed interface"
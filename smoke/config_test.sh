@@ -43,6 +43,10 @@ grcli route add 2521:112::/64 via id 45
 grcli route add 2521:113::/64 via id 47
 grcli graph config set vector-max 256 rx-burst-max 64
 grcli -j graph config show | jq -e 'select(.vector_max == 256 and .rx_burst_max == 64)'
+grcli graph config set fastpath on
+grcli -j graph config show | jq -e 'select(.fastpath == "on" and .vector_max == 256)'
+grcli interface set port p2 symmetric-rss on
+grcli -j interface show name p2 | jq -e '.symmetric_rss == true' || fail "symmetric rss should be enabled"
 grcli interface set port p0 rxqs 2
 grcli interface set port p1 rxqs 2
 grcli interface set port p2 description "peering link"
@@ -0,0 +1,69 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2026 Robin Jarry
+
+#
+#                  p0 (.0.2)     |               |
+# 192.200.0.2  lo             n0 | --- grout --- | n1  p2  172.16.2.2
+#                  p1 (.1.2)     |               |
+#
+. $(dirname $0)/_init.sh
+
+port_add p0
+port_add p1
+port_add p2
+
+netns_add n0
+move_to_netns x-p0 n0
+move_to_netns x-p1 n0
+ip -n n0 addr add 192.200.0.2/24 dev lo
+ip -n n0 addr add 172.16.0.2/24 dev x-p0
+ip -n n0 addr add 172.16.1.2/24 dev x-p1
+ip -n n0 route add 172.16.2.0/24 via 172.16.1.1
+
+netns_add n1
+move_to_netns x-p2 n1
+ip -n n1 addr add 172.16.2.2/24 dev x-p2
+ip -n n1 route add default via 172.16.2.1
+
+grcli address add 172.16.0.1/24 iface p0
+grcli address add 172.16.1.1/24 iface p1
+grcli address add 172.16.2.1/24 iface p2
+
+# Primary path through p0 protected by a pre-installed backup through p1.
+grcli nexthop add l3 iface p1 address 172.16.1.2 id 101
+grcli nexthop add l3 iface p0 address 172.16.0.2 id 100 backup 101
+grcli route add 192.200.0.0/24 via id 100
+grcli -j nexthop show type l3 | jq -e '.[] | select(.id == 100 and .backup == 101)' \
+	|| fail "nexthop 100 should have backup 101"
+
+ip netns exec n1 ping -i0.01 -c3 -n 192.200.0.2
+
+# The route is not modified, the datapath switches to the backup.
+grcli interface set port p0 down
+ip netns exec n1 ping -i0.01 -c3 -n 192.200.0.2
+grcli interface set port p0 up
+
+# Same thing with a group backup.
+grcli nexthop add l3 iface p0 address 172.16.0.2 id 100
+grcli nexthop add group id 10 backup 101 member 100
+grcli route add 192.201.0.0/24 via id 10
+ip -n n0 addr add 192.201.0.2/24 dev lo
+
+ip netns exec n1 ping -i0.01 -c3 -n 192.201.0.2
+grcli interface set port p0 down
+ip netns exec n1 ping -i0.01 -c3 -n 192.201.0.2
+grcli interface set port p0 up
+
+# Backups must have the same VRF and address family as the nexthops they protect.
+grcli nexthop add l3 iface p1 address fd00:1::2 id 102
+grcli nexthop add l3 iface p0 address 172.16.0.3 id 103 backup 102 \
+	&& fail "ipv6 backup should be rejected for an ipv4 nexthop"
+grcli nexthop add group id 11 backup 102 member 100 \
+	&& fail "ipv6 backup should be rejected for a group of ipv4 nexthops"
+grcli nexthop del 102
+
+# Deleting the backup removes it from the nexthops that reference it.
+grcli nexthop del 101
+grcli -j nexthop show type group | jq -e '.[] | select(.id == 10 and .backup == null)' \
+	|| fail "group 10 should have no backup"
@@ -0,0 +1,40 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2026 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+grcli graph config set fastpath on
+
+port_add p0
+# smaller MTU on p1 to exercise fragmentation
+port_add p1 mtu 1280
+grcli address add 172.16.0.1/24 iface p0
+grcli address add 172.16.1.1/24 iface p1
+grcli route add 16.0.0.0/16 via 172.16.0.2
+grcli route add 16.1.0.0/16 via 172.16.1.2
+
+for n in 0 1; do
+	p=x-p$n
+	ns=n$n
+	netns_add $ns
+	ip link set $p mtu 1500
+	move_to_netns $p $ns
+	ip -n $ns addr add 172.16.$n.2/24 dev $p
+	ip -n $ns addr add 16.$n.0.1/16 dev lo
+	ip -n $ns route add default via 172.16.$n.1
+done
+
+# first packets are held until nexthops are resolved
+ip netns exec n0 ping -i0.01 -c3 -n 16.1.0.1
+ip netns exec n1 ping -i0.01 -c3 -n 16.0.0.1
+# IP options and TTL expiry are handled by the regular nodes
+ip netns exec n0 ping -i0.01 -c3 -n -R 16.1.0.1
+ip netns exec n0 traceroute -N1 -n 16.1.0.1
+# local delivery
+ip netns exec n0 ping -i0.01 -c3 -n 172.16.0.1
+# fragmentation
+ip netns exec n0 ping -i0.01 -c3 -s 1260 -M dont -n 16.1.0.1
+
+grcli graph config set fastpath off
+ip netns exec n0 ping -i0.01 -c3 -n 16.1.0.1
@@ -0,0 +1,40 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2026 Robin Jarry
+
+. $(dirname $0)/_init.sh
+
+port_add p0
+port_add p1
+grcli address add 172.16.0.1/24 iface p0
+grcli address add 172.16.1.1/24 iface p1
+
+for n in 0 1; do
+	p=x-p$n
+	ns=n$n
+	netns_add $ns
+	move_to_netns $p $ns
+	ip -n $ns addr add 172.16.$n.2/24 dev $p
+	ip -n $ns route add default via 172.16.$n.1
+done
+
+# resolve n0 only, 172.16.1.2 is still unknown to grout
+ip netns exec n0 ping -i0.01 -c3 -n 172.16.0.1
+
+# send a burst of packets to the unresolved nexthop: the first one triggers
+# address resolution, the following ones are held in the datapath and must
+# all be released once the neighbour has replied
+ip netns exec n0 ping -l 8 -c 8 -W1 -n 172.16.1.2 ||
+	fail "held packets were not forwarded after resolution"
+
+grcli -j stats show software brief pattern nh_hold_flush |
+	jq -e '.nh_hold_flush > 0' ||
+	fail "no packets were released from the hold queue"
+
+# destroying the nexthop invalidates its hold queue entries, packets held
+# for the new nexthop allocated for the same address must still be released
+id=$(grcli -j nexthop show type l3 | jq -r '.[] | select(.addr == "172.16.1.2") | .id')
+[ -n "$id" ] || fail "nexthop 172.16.1.2 was not created"
+grcli nexthop del $id
+ip netns exec n0 ping -l 8 -c 8 -W1 -n 172.16.1.2 ||
+	fail "held packets were not forwarded after nexthop deletion"
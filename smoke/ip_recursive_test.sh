@@ -0,0 +1,61 @@
+#!/bin/bash
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (c) 2026 Robin Jarry
+
+#
+#                  p0 (.0.2)     |               |
+# 192.200.0.2  lo             n0 | --- grout --- | n1  p2  172.16.2.2
+#                  p1 (.1.2)     |               |
+#
+. $(dirname $0)/_init.sh
+
+port_add p0
+port_add p1
+port_add p2
+
+netns_add n0
+move_to_netns x-p0 n0
+move_to_netns x-p1 n0
+ip -n n0 addr add 192.200.0.2/24 dev lo
+ip -n n0 addr add 172.16.0.2/24 dev x-p0
+ip -n n0 addr add 172.16.1.2/24 dev x-p1
+ip -n n0 route add 172.16.2.0/24 via 172.16.0.1
+
+netns_add n1
+move_to_netns x-p2 n1
+ip -n n1 addr add 172.16.2.2/24 dev x-p2
+ip -n n1 route add default via 172.16.2.1
+
+grcli address add 172.16.0.1/24 iface p0
+grcli address add 172.16.1.1/24 iface p1
+grcli address add 172.16.2.1/24 iface p2
+
+# Several prefixes share the same recursive nexthop.
+grcli nexthop add l3 iface p0 address 172.16.0.2 id 100
+grcli nexthop add l3 iface p1 address 172.16.1.2 id 101
+grcli nexthop add recursive id 10 via 100
+grcli route add 192.200.0.0/24 via id 10
+grcli route add 192.201.0.0/24 via id 10
+grcli -j nexthop show type recursive | jq -e '.[] | select(.id == 10 and .via == 100)' \
+	|| fail "recursive nexthop 10 should resolve to 100"
+
+ip netns exec n1 ping -i0.01 -c3 -n 192.200.0.2
+
+# Repoint the recursive nexthop, routes must follow without being reinstalled.
+grcli nexthop add recursive id 10 via 101
+grcli -j nexthop show type recursive | jq -e '.[] | select(.id == 10 and .via == 101)' \
+	|| fail "recursive nexthop 10 should resolve to 101"
+ip -n n0 route replace 172.16.2.0/24 via 172.16.1.1
+ip netns exec n1 ping -i0.01 -c3 -n 192.200.0.2
+
+# Deleting the resolved nexthop leaves the recursive one unresolved.
+grcli nexthop del 101
+grcli -j nexthop show type recursive | jq -e '.[] | select(.id == 10 and .via == null)' \
+	|| fail "recursive nexthop 10 should be unresolved"
+ip netns exec n1 ping -i0.01 -c3 -W1 -n 192.200.0.2 \
+	&& fail "ping should fail through an unresolved recursive nexthop"
+
+# Resolve it again.
+grcli nexthop add recursive id 10 via 100
+ip -n n0 route replace 172.16.2.0/24 via 172.16.0.1
+ip netns exec n1 ping -i0.01 -c3 -n 192.200.0.2
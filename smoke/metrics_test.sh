@@ -34,7 +34,13 @@ route add ::/0 via 2345::2 vrf gr-vrf1
 route add 2521:111::4/37 via id 1047 vrf gr-vrf1
 route add 2521:112::/64 via id 45 vrf gr-vrf2
 route add 2521:113::/64 via id 47 vrf gr-vrf1
+nexthop del 666
 EOF
 
 # dump all metrics
-curl --fail --noproxy '*' http://localhost:9111/metrics
+metrics=$(curl --fail --noproxy '*' http://localhost:9111/metrics)
+echo "$metrics"
+
+# deleted objects are reclaimed asynchronously
+grep -q '^grout_rcu_defer_pending{queue="objects"}' <<< "$metrics" \
+	|| fail "rcu defer queue depth is not reported"
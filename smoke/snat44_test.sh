@@ -36,6 +36,23 @@ sleep 0.2
 echo foobar | ip netns exec n1 socat - UDP4:172.16.0.2:1234,shut-down > $tmp/response
 [ "$(cat $tmp/response)" = raboof ] || fail "bad UDP response from server"
 
+# resizing the table must preserve existing connections
+grcli conntrack config set max 2048
+grcli -j conntrack config show | jq -e '.max == 2048 and .used > 0' \
+	|| fail "connections should survive table resize"
+
+# shrink then grow again, the second resize supersedes the first one
+grcli conntrack config set max 64
+grcli conntrack config set max 4096
+grcli -j conntrack config show | jq -e '.max == 4096 and .used > 0' \
+	|| fail "connections should survive shrink and grow"
+used=$(grcli -j conntrack config show | jq '.used')
+if [ "$used" -gt 1 ]; then
+	grcli conntrack config set max 1 \
+		&& fail "shrinking below the number of connections should fail"
+fi
+grcli conntrack config set max 2048
+
 grcli conntrack show
 grcli conntrack config show
 
@@ -44,5 +61,15 @@ sleep 3
 grcli conntrack show
 grcli conntrack config show
 
+# lowering timeouts must also apply to connections that are already tracked
+grcli conntrack config set established-udp-timeout 1 established-tcp-timeout 1 \
+	new-timeout 1 half-close-timeout 1 time-wait-timeout 1
+sleep 3
+grcli -j conntrack config show | jq -e '.used == 0' \
+	|| fail "idle connections should have expired after lowering timeouts"
+expired=$(curl --fail --noproxy '*' http://localhost:9111/metrics |
+	awk '/^grout_conntrack_expired/ {print $2}')
+[ "${expired:-0}" -gt 0 ] || fail "conntrack_expired metric was not incremented"
+
 grcli conntrack flush
 grcli conntrack show
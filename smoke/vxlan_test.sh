@@ -29,3 +29,24 @@ bridge -n n1 fdb add 00:00:00:00:00:00 dev vxlan100 self vni 100 dst 10.0.0.1
 ip netns exec n1 ping -i0.01 -c3 -W1 192.168.100.1
 
 grcli fdb show
+
+# Restrict the UDP source port range and check connectivity again
+grcli interface set vxlan vxlan100 src_ports 50000 50015
+grcli -j interface show name vxlan100 | jq -e '.src_port_min == 50000 and .src_port_max == 50015'
+ip netns exec n1 ping -i0.01 -c3 -W1 192.168.100.1
+
+# Flood frames larger than the underlay MTU to an unreachable VTEP and to n1.
+# Replicas share the inner frame and must be fragmented correctly.
+port_add p1 domain br100
+netns_add n2
+move_to_netns x-p1 n2
+ip -n n2 addr add 192.168.100.3/24 dev x-p1
+grcli flood vtep add 10.99.0.2 vni 100
+ip netns exec n1 sysctl -qw net.ipv4.icmp_echo_ignore_broadcasts=0
+ip netns exec n1 ip neigh flush all
+ip netns exec n2 ping -b -i0.01 -c3 -W1 -s 1440 -M dont -n 192.168.100.255 > $tmp/ping || :
+cat $tmp/ping
+grep -q "from 192.168.100.2:" $tmp/ping || fail "fragmented flooded frames were not received by n1"
+grcli -j stats show software brief pattern vxlan_output_no_route |
+	jq -e '.vxlan_output_no_route > 0' ||
+	fail "flooded frames to an unreachable vtep were not counted"